@@ -0,0 +1,150 @@
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "coroutine_framework/framework.hpp"
+using namespace ToE;
+
+// usage: bench_rpc [--rpcs N] [--concurrency C] [--workers N] [--io-threads N] [--port P] [--sqpoll 0|1] [--rtc 0|1]
+// client and server frameworks in one process talk over loopback, net backend is chosen at build time
+// (xmake f --io_uring=y), so both backends are compared by running the same binary built twice.
+// --rtc 1 lets scheduler workers poll sockets themselves (io_uring backend), --io-threads is ignored then.
+// every case prints one json object per line to stdout, so runs can be diffed or loaded by scripts
+
+#ifdef TOE_NET_IO_URING
+constexpr const char *NET_BACKEND = "io_uring";
+#else
+constexpr const char *NET_BACKEND = "asio";
+#endif
+
+struct JsonLine {
+  JsonLine(const char *bench) : line_{std::string{"{\"bench\":\""} + bench + "\""} {}
+  JsonLine &add(const char *key, const uint64_t value) {
+    line_ += std::string{",\""} + key + "\":" + std::to_string(value);
+    return *this;
+  }
+  JsonLine &add(const char *key, const char *value) {
+    line_ += std::string{",\""} + key + "\":\"" + value + "\"";
+    return *this;
+  }
+  void emit() {
+    std::printf("%s}\n", line_.c_str());
+    std::fflush(stdout);
+  }
+  std::string line_;
+};
+
+uint64_t cpu_time_ns() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1_s + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1_us;
+}
+
+void emit_percentiles(JsonLine &line, std::vector<uint64_t> &latency) {
+  std::sort(latency.begin(), latency.end());
+  auto percentile = [&latency](const uint64_t per_mille) {
+    return latency.empty() ? 0 : latency[std::min(latency.size() - 1, latency.size() * per_mille / 1000)];
+  };
+  line.add("samples", latency.size())
+      .add("p50_ns", percentile(500))
+      .add("p90_ns", percentile(900))
+      .add("p99_ns", percentile(990))
+      .add("p999_ns", percentile(999))
+      .add("max_ns", latency.empty() ? 0 : latency.back())
+      .emit();
+}
+
+// one closed loop client: next rpc is sent once previous one returns, latency of each is recorded
+CoroTask<uint64_t> rpc_loop(EndPoint peer, int64_t response_size, uint64_t *latency, uint64_t rpc_cnt) {
+  uint64_t failed_cnt = 0;
+  for (uint64_t idx = 0; idx < rpc_cnt; ++idx) {
+    uint64_t start_ts = FastClockTime::now();
+    bool ok = false;
+    if (response_size == 0) {
+      auto ret = co_await co_rpc<example_add_point>().with_args(Point{1, 1}, Point{2, 2}).on(peer).timeout(10_s);
+      ok = ret.has_value();
+    } else {
+      auto ret = co_await co_rpc<example_repeat>().with_args('x', response_size).on(peer).timeout(10_s);
+      ok = ret.has_value() && ret->size() == static_cast<std::size_t>(response_size);
+    }
+    latency[idx] = FastClockTime::now() - start_ts;
+    failed_cnt += ok ? 0 : 1;
+  }
+  co_return failed_cnt;
+}
+
+void bench_rpc(CoroFrameWork &client, const EndPoint &server, const int64_t response_size,
+               const uint64_t rpc_cnt, const uint32_t concurrency, const char *mode) {
+  const uint64_t rpc_per_loop = std::max<uint64_t>(rpc_cnt / concurrency, 1);
+  std::vector<uint64_t> latency(rpc_per_loop * concurrency, 0);
+  std::vector<CoroTask<uint64_t>> loops;
+  loops.reserve(concurrency);
+  uint64_t start_cpu = cpu_time_ns();
+  uint64_t start_ts = FastClockTime::now();
+  for (uint32_t idx = 0; idx < concurrency; ++idx) {
+    loops.push_back(rpc_loop(server, response_size, latency.data() + idx * rpc_per_loop, rpc_per_loop));
+    client.commit(loops.back());
+  }
+  uint64_t failed_cnt = 0;
+  for (auto &loop : loops) {
+    loop.wait();
+    failed_cnt += loop.get_result();
+  }
+  uint64_t wall = std::max<uint64_t>(FastClockTime::now() - start_ts, 1);
+  uint64_t cpu = cpu_time_ns() - start_cpu;
+  emit_percentiles(JsonLine{"rpc"}.add("backend", NET_BACKEND)
+                                  .add("mode", mode)
+                                  .add("response_bytes", static_cast<uint64_t>(response_size))
+                                  .add("concurrency", concurrency)
+                                  .add("qps", latency.size() * 1_s / wall)
+                                  .add("cpu_ns_per_rpc", cpu / std::max<uint64_t>(latency.size(), 1)) // both sides
+                                  .add("failed", failed_cnt),
+                   latency);
+}
+
+int main(int argc, char **argv) {
+  uint64_t rpc_cnt = 200'000;
+  uint32_t concurrency = 64;
+  uint32_t worker_num = 1;
+  uint32_t io_thread_num = 1;
+  uint16_t port = 18960;
+  bool sqpoll = false;
+  bool run_to_completion = false;
+  for (int idx = 1; idx + 1 < argc; idx += 2) {
+    if (0 == std::strcmp(argv[idx], "--rpcs")) {
+      rpc_cnt = std::stoull(argv[idx + 1]);
+    } else if (0 == std::strcmp(argv[idx], "--concurrency")) {
+      concurrency = std::max<uint32_t>(static_cast<uint32_t>(std::stoul(argv[idx + 1])), 1);
+    } else if (0 == std::strcmp(argv[idx], "--workers")) {
+      worker_num = static_cast<uint32_t>(std::stoul(argv[idx + 1]));
+    } else if (0 == std::strcmp(argv[idx], "--io-threads")) {
+      io_thread_num = static_cast<uint32_t>(std::stoul(argv[idx + 1]));
+    } else if (0 == std::strcmp(argv[idx], "--port")) {
+      port = static_cast<uint16_t>(std::stoul(argv[idx + 1]));
+    } else if (0 == std::strcmp(argv[idx], "--sqpoll")) {
+      sqpoll = std::stoul(argv[idx + 1]) != 0;
+    } else if (0 == std::strcmp(argv[idx], "--rtc")) {
+      run_to_completion = std::stoul(argv[idx + 1]) != 0;
+    }
+  }
+  GlobalInit(LogLevel::warn); // keep stdout for results
+  JsonLine{"environment"}
+      .add("backend", NET_BACKEND)
+      .add("hardware_threads", std::thread::hardware_concurrency())
+      .add("io_threads", io_thread_num)
+      .add("sqpoll", static_cast<uint64_t>(sqpoll)) // io_uring backend only
+      .add("run_to_completion", static_cast<uint64_t>(run_to_completion && UsedNetModule::WORKER_POLL_SUPPORTED))
+      .emit();
+  NetConfig net_config{.io_thread_num_ = io_thread_num, .uring_sqpoll_ = sqpoll, .run_to_completion_ = run_to_completion};
+  CoroFrameWork server{worker_num, port, TimeConfig{}, net_config};
+  CoroFrameWork client{worker_num, static_cast<uint16_t>(port + 1), TimeConfig{}, net_config};
+  const EndPoint server_endpoint{{127, 0, 0, 1}, port};
+  bench_rpc(client, server_endpoint, 0, std::min<uint64_t>(rpc_cnt, 1'000), 1, "warm_up");
+  bench_rpc(client, server_endpoint, 0, rpc_cnt / 10, 1, "serial");
+  bench_rpc(client, server_endpoint, 0, rpc_cnt, concurrency, "small");
+  bench_rpc(client, server_endpoint, 4 * 1024, rpc_cnt, concurrency, "payload_4k");
+  bench_rpc(client, server_endpoint, 64 * 1024, rpc_cnt / 10, concurrency, "payload_64k");
+  return 0;
+}
@@ -0,0 +1,246 @@
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "coroutine_framework/framework.hpp"
+#include "coroutine_framework/time_module/timing_wheel.h"
+using namespace ToE;
+
+// usage: bench_timer [--max-timers N] [--e2e-timers N] [--workers N] [--port P]
+// every case prints one json object per line to stdout, so runs can be diffed or loaded by scripts
+
+struct JsonLine {
+  JsonLine(const char *bench) : line_{std::string{"{\"bench\":\""} + bench + "\""} {}
+  JsonLine &add(const char *key, const uint64_t value) {
+    line_ += std::string{",\""} + key + "\":" + std::to_string(value);
+    return *this;
+  }
+  JsonLine &add(const char *key, const char *value) {
+    line_ += std::string{",\""} + key + "\":\"" + value + "\"";
+    return *this;
+  }
+  void emit() {
+    std::printf("%s}\n", line_.c_str());
+    std::fflush(stdout);
+  }
+  std::string line_;
+};
+
+enum class DurationMix : uint8_t {
+  SHORT = 0, // 1ms ~ 100ms, request timeouts, retries
+  LONG = 1, // 1s ~ 1h, idle and session timeouts
+  MIXED = 2, // 90% short, 10% long
+};
+
+const char *mix_name(const DurationMix mix) {
+  static const char *NAMES[] = {"short", "long", "mixed"};
+  return NAMES[static_cast<uint8_t>(mix)];
+}
+
+uint64_t random_duration(std::mt19937_64 &rng, const DurationMix mix) {
+  bool is_long = mix == DurationMix::LONG || (mix == DurationMix::MIXED && rng() % 10 == 0);
+  return is_long ? 1_s + rng() % (3600_s - 1_s) : 1_ms + rng() % (100_ms - 1_ms);
+}
+
+uint64_t cpu_time_ns() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1_s + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1_us;
+}
+
+void emit_percentiles(JsonLine &line, std::vector<uint64_t> &lateness) {
+  std::sort(lateness.begin(), lateness.end());
+  auto percentile = [&lateness](const uint64_t per_mille) {
+    return lateness.empty() ? 0 : lateness[std::min(lateness.size() - 1, lateness.size() * per_mille / 1000)];
+  };
+  line.add("samples", lateness.size())
+      .add("p50_ns", percentile(500))
+      .add("p90_ns", percentile(900))
+      .add("p99_ns", percentile(990))
+      .add("p999_ns", percentile(999))
+      .add("max_ns", lateness.empty() ? 0 : lateness.back())
+      .emit();
+}
+
+// raw wheel cost without threads: arm N, cancel every 4th, expire the rest tick by tick as a driver would
+void bench_wheel_throughput(const uint64_t timer_cnt, const DurationMix mix) {
+  constexpr uint64_t PRECISION = 1_ms;
+  constexpr uint64_t START_TICK = 1'000'003;
+  constexpr uint64_t ADVANCE_STEP = 10; // ticks per driver loop
+  std::mt19937_64 rng{timer_cnt};
+  std::vector<TimerNode> nodes(timer_cnt);
+  std::vector<uint64_t> expire_ticks(timer_cnt);
+  uint64_t max_tick = START_TICK;
+  for (uint64_t idx = 0; idx < timer_cnt; ++idx) {
+    expire_ticks[idx] = START_TICK + random_duration(rng, mix) / PRECISION;
+    max_tick = std::max(max_tick, expire_ticks[idx]);
+  }
+  TimingWheel wheel;
+  wheel.reset(START_TICK);
+  uint64_t start_ts = FastClockTime::now();
+  for (uint64_t idx = 0; idx < timer_cnt; ++idx) {
+    nodes[idx].expire_tick_ = expire_ticks[idx];
+    wheel.insert(&nodes[idx]);
+  }
+  uint64_t arm_ts = FastClockTime::now();
+  uint64_t cancel_cnt = 0;
+  for (uint64_t idx = 0; idx < timer_cnt; idx += 4) {
+    cancel_cnt += wheel.remove(&nodes[idx]);
+  }
+  uint64_t cancel_ts = FastClockTime::now();
+  uint64_t expired_cnt = 0;
+  uint64_t wakeup_cnt = 0;
+  for (uint64_t tick = START_TICK; tick < max_tick;) {
+    tick = std::min(std::max(tick + ADVANCE_STEP, wheel.next_expire_tick()), max_tick); // tickless driver
+    ExpiredTimers expired;
+    wheel.advance(tick, expired);
+    while (!expired.empty()) {
+      expired.pop();
+      expired_cnt++;
+    }
+    wakeup_cnt++;
+  }
+  uint64_t expire_ts = FastClockTime::now();
+  JsonLine{"wheel_throughput"}
+      .add("mix", mix_name(mix))
+      .add("timers", timer_cnt)
+      .add("arm_ns_per_op", (arm_ts - start_ts) / std::max<uint64_t>(timer_cnt, 1))
+      .add("cancel_ns_per_op", (cancel_ts - arm_ts) / std::max<uint64_t>(cancel_cnt, 1))
+      .add("expire_ns_per_op", (expire_ts - cancel_ts) / std::max<uint64_t>(expired_cnt, 1))
+      .add("expired", expired_cnt)
+      .add("driver_wakeups", wakeup_cnt)
+      .emit();
+}
+
+CoroTask<void> sleep_and_record(const uint64_t sleep_ts, uint64_t &lateness) {
+  uint64_t deadline = FastClockTime::now() + sleep_ts;
+  co_await co_sleep(sleep_ts);
+  lateness = FastClockTime::now() - deadline;
+  co_return;
+}
+
+struct LatenessCallBack : public TimerCallBack {
+  virtual void on_timer(const bool cancelled) noexcept override {
+    if (!cancelled) {
+      *lateness_ = FastClockTime::now() - deadline_;
+    }
+    done_cnt_->fetch_add(1, std::memory_order_release);
+  }
+  uint64_t deadline_ = 0;
+  uint64_t *lateness_ = nullptr;
+  std::atomic<uint64_t> *done_cnt_ = nullptr;
+};
+
+// lateness against requested deadline through the whole path: wheel, driver wake up, commit, resume
+void bench_lateness(const uint64_t timer_cnt, const uint32_t worker_num, const uint16_t port,
+                    const TimeConfig &config, const char *mode) {
+  std::mt19937_64 rng{timer_cnt};
+  CoroFrameWork framework{worker_num, port, config};
+  { // co_sleep on scheduler workers
+    std::vector<uint64_t> lateness(timer_cnt, 0);
+    std::vector<CoroTask<void>> tasks;
+    tasks.reserve(timer_cnt);
+    uint64_t start_ts = FastClockTime::now();
+    for (uint64_t idx = 0; idx < timer_cnt; ++idx) {
+      tasks.push_back(sleep_and_record(random_duration(rng, DurationMix::SHORT), lateness[idx]));
+      framework.commit(tasks.back());
+    }
+    uint64_t commit_ts = FastClockTime::now();
+    wait_all(tasks);
+    emit_percentiles(JsonLine{"lateness"}.add("mode", mode).add("path", "worker_co_sleep").add("workers", worker_num)
+                                         .add("commit_ns_per_op", (commit_ts - start_ts) / std::max<uint64_t>(timer_cnt, 1)),
+                     lateness);
+  }
+  { // TimerHandle driven by TimeService thread
+    uint64_t handle_cnt = std::min<uint64_t>(timer_cnt, 100'000);
+    std::vector<uint64_t> lateness(handle_cnt, 0);
+    std::atomic<uint64_t> done_cnt{0};
+    std::vector<LatenessCallBack> callbacks(handle_cnt);
+    std::vector<std::unique_ptr<TimerHandle>> handles;
+    handles.reserve(handle_cnt);
+    for (uint64_t idx = 0; idx < handle_cnt; ++idx) {
+      callbacks[idx].lateness_ = &lateness[idx];
+      callbacks[idx].done_cnt_ = &done_cnt;
+      handles.push_back(std::make_unique<TimerHandle>(framework.get_time_module(), &callbacks[idx]));
+    }
+    for (uint64_t idx = 0; idx < handle_cnt; ++idx) {
+      callbacks[idx].deadline_ = FastClockTime::now() + random_duration(rng, DurationMix::SHORT);
+      handles[idx]->arm(callbacks[idx].deadline_);
+    }
+    while (done_cnt.load(std::memory_order_acquire) < handle_cnt) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    emit_percentiles(JsonLine{"lateness"}.add("mode", mode).add("path", "time_service_handle").add("workers", worker_num),
+                     lateness);
+  }
+}
+
+struct NoopCallBack : public TimerCallBack {
+  virtual void on_timer(const bool) noexcept override {}
+};
+
+// cpu burnt by worker and time service threads while nothing is due, with long timers pending or none
+void bench_idle_cpu(const uint64_t pending_cnt, const uint32_t worker_num, const uint16_t port,
+                    const TimeConfig &config, const char *mode) {
+  constexpr uint64_t IDLE_WINDOW = 2_s;
+  CoroFrameWork framework{worker_num, port, config};
+  NoopCallBack callback;
+  std::vector<std::unique_ptr<TimerHandle>> handles;
+  handles.reserve(pending_cnt);
+  for (uint64_t idx = 0; idx < pending_cnt; ++idx) {
+    handles.push_back(std::make_unique<TimerHandle>(framework.get_time_module(), &callback));
+    handles.back()->arm_after(1_hour + idx * 1_ms);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100)); // let threads settle
+  uint64_t start_cpu = cpu_time_ns();
+  uint64_t start_ts = FastClockTime::now();
+  std::this_thread::sleep_for(std::chrono::nanoseconds(IDLE_WINDOW));
+  uint64_t cpu = cpu_time_ns() - start_cpu;
+  uint64_t wall = FastClockTime::now() - start_ts;
+  JsonLine{"idle_cpu"}
+      .add("mode", mode)
+      .add("workers", worker_num)
+      .add("pending_timers", pending_cnt)
+      .add("cpu_ns_per_s", cpu * 1_s / wall)
+      .emit();
+}
+
+int main(int argc, char **argv) {
+  uint64_t max_timers = 1'000'000; // 10'000'000 needs about 1GB
+  uint64_t e2e_timers = 100'000;
+  uint32_t worker_num = 1;
+  uint16_t port = 18950;
+  for (int idx = 1; idx + 1 < argc; idx += 2) {
+    if (0 == std::strcmp(argv[idx], "--max-timers")) {
+      max_timers = std::stoull(argv[idx + 1]);
+    } else if (0 == std::strcmp(argv[idx], "--e2e-timers")) {
+      e2e_timers = std::stoull(argv[idx + 1]);
+    } else if (0 == std::strcmp(argv[idx], "--workers")) {
+      worker_num = static_cast<uint32_t>(std::stoul(argv[idx + 1]));
+    } else if (0 == std::strcmp(argv[idx], "--port")) {
+      port = static_cast<uint16_t>(std::stoul(argv[idx + 1]));
+    }
+  }
+  GlobalInit(LogLevel::warn); // keep stdout for results
+  JsonLine{"environment"}
+      .add("tsc_clock", static_cast<uint64_t>(FastClockTime::tsc_enabled()))
+      .add("hardware_threads", std::thread::hardware_concurrency())
+      .emit();
+  for (uint64_t timer_cnt = 1'000; timer_cnt <= max_timers; timer_cnt *= 10) {
+    for (DurationMix mix : {DurationMix::SHORT, DurationMix::LONG, DurationMix::MIXED}) {
+      bench_wheel_throughput(timer_cnt, mix);
+    }
+  }
+  const TimeConfig default_config{};
+  const TimeConfig high_resolution_config{50_us, true, 20_us};
+  bench_lateness(e2e_timers, worker_num, port++, default_config, "default");
+  bench_lateness(e2e_timers, worker_num, port++, high_resolution_config, "high_resolution");
+  for (uint64_t pending_cnt : {0ULL, 100'000ULL}) {
+    bench_idle_cpu(pending_cnt, worker_num, port++, default_config, "default");
+    bench_idle_cpu(pending_cnt, worker_num, port++, high_resolution_config, "high_resolution");
+  }
+  return 0;
+}
@@ -19,9 +19,7 @@ int main() {
     auto ret = framework.commit(v_futures.back());
     assert(ret);
   }
-  for (auto &future : v_futures) {
-    future.wait();
-  }
+  wait_all(v_futures);
   INFO_LOG("end");
   return 0;
 }
\ No newline at end of file
@@ -2,14 +2,15 @@
 using namespace ToE;
 
 CoroTask<void> multi_rpc_call(std::vector<EndPoint> endpoints) {
+  co_interval probe_interval{1_s}; // 每1s进行一次echo探测, 绝对时间对齐不漂移
   while (true) {
-    uint64_t before_call_ts = SteadyClockTime::now();
+    uint64_t before_call_ts = FastClockTime::now();
     auto results = co_await co_rpc<example_echo>().with_args() // 函数调用参数
                                                   .on(endpoints) // 广播rpc的目的端列表
                                                   .when_all() // 等待所有结果收集完毕
                                                   .timeout(500_ms) // 若超过500_ms未收集到所有结果，直接恢复协程
                                                   .on_each_result( // 每次都到rpc响应时触发回调
-      [&before_call_ts](const EndPoint &, int64_t &result, bool &) { result = SteadyClockTime::now() - before_call_ts; } // 记录针对每台server的rpc调用延迟
+      [&before_call_ts](const EndPoint &, int64_t &result, bool &) { result = FastClockTime::now() - before_call_ts; } // 记录针对每台server的rpc调用延迟
     );
     INFO_LOG("=======================");
     for (auto &result : results) {
@@ -19,7 +20,7 @@ CoroTask<void> multi_rpc_call(std::vector<EndPoint> endpoints) {
         INFO_LOG("\033[0;31mfrom:[{}], err:{}\033[0m", result.first, result.second);
       }
     }
-    co_await co_sleep(before_call_ts + 1_s - SteadyClockTime::now()); // 每1s进行一次echo探测
+    co_await probe_interval.tick();
   }
 }
 
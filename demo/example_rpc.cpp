@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "coroutine_framework/framework.hpp"
 #include "point.h"
 
@@ -16,6 +17,24 @@ CoroTask<Point> example_add_point(Point a, Point b) {
   co_return a + b;
 }
 
+CoroTask<std::string> example_repeat(char c, int64_t count) {
+  co_return std::string(count, c);
+}
+
+CoroTask<int64_t> example_count(std::string data, char c) {
+  co_return std::count(data.begin(), data.end(), c);
+}
+
+std::atomic<int64_t> EXAMPLE_WAIT_CANCELED_CNT{0};
+
+CoroTask<int64_t> example_wait(uint64_t wait_ms) {
+  auto ret = co_await co_sleep(wait_ms * 1_ms);
+  if (!ret && ret.error() == Error{Error::CANCELED}) {
+    EXAMPLE_WAIT_CANCELED_CNT++;
+  }
+  co_return 0;
+}
+
 CoroTask<int64_t> example_echo() {
   RandomGenerator random{0, 100};
   auto rand = random.gen();
@@ -0,0 +1,116 @@
+#include "admission.h"
+
+namespace ToE
+{
+
+namespace
+{
+std::atomic<FrameByteCounter *> FRAME_BYTE_COUNTERS{nullptr};
+std::atomic<int64_t> ORPHAN_FRAME_BYTES{0};
+}
+
+thread_local ThreadFrameBytes TLS_FRAME_BYTES;
+
+ThreadFrameBytes::ThreadFrameBytes() : counter_{nullptr} {
+  for (FrameByteCounter *iter = FRAME_BYTE_COUNTERS.load(std::memory_order_acquire); iter; iter = iter->next_) {
+    bool expected = false;
+    if (iter->in_use_.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      counter_ = iter;
+      return;
+    }
+  }
+  counter_ = new FrameByteCounter{}; // never freed, bytes_ stays in the sum
+  counter_->in_use_.store(true, std::memory_order_relaxed);
+  counter_->next_ = FRAME_BYTE_COUNTERS.load(std::memory_order_relaxed);
+  while (!FRAME_BYTE_COUNTERS.compare_exchange_weak(counter_->next_, counter_, std::memory_order_release, std::memory_order_relaxed));
+}
+
+ThreadFrameBytes::~ThreadFrameBytes() {
+  FrameByteCounter *counter = counter_;
+  counter_ = nullptr;
+  counter->in_use_.store(false, std::memory_order_release); // next owner continues from our bytes_
+}
+
+void ThreadFrameBytes::add_orphan(const int64_t bytes) noexcept {
+  ORPHAN_FRAME_BYTES.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+uint64_t FrameByteCounter::total() noexcept {
+  int64_t sum = ORPHAN_FRAME_BYTES.load(std::memory_order_relaxed);
+  for (FrameByteCounter *iter = FRAME_BYTE_COUNTERS.load(std::memory_order_acquire); iter; iter = iter->next_) {
+    sum += iter->bytes_.load(std::memory_order_relaxed);
+  }
+  return sum > 0 ? static_cast<uint64_t>(sum) : 0; // counters are read at different moments
+}
+
+void AdmissionControl::set_config(const AdmissionConfig &config) noexcept {
+  max_running_root_cnt_.store(config.max_running_root_cnt_, std::memory_order_relaxed);
+  max_frame_bytes_.store(config.max_frame_bytes_, std::memory_order_relaxed);
+  if (waiting_cnt_.load(std::memory_order_seq_cst) != 0) { // limits may be raised
+    wake_waiters_();
+  }
+}
+
+bool AdmissionControl::try_acquire() noexcept {
+  bool ret = false;
+  if (waiting_cnt_.load(std::memory_order_acquire) == 0) [[likely]] { // FIFO, do not overtake queued spawners
+    ret = try_acquire_slot_();
+  }
+  return ret;
+}
+
+bool AdmissionControl::acquire_or_wait(LinkedCoroutine *waiter) noexcept {
+  bool ret = false;
+  std::lock_guard<std::mutex> lg(lock_);
+  waiting_cnt_.fetch_add(1, std::memory_order_seq_cst); // pairs with release(), one of us must see the other
+  if (waiting_queue_.empty() && try_acquire_slot_()) {
+    waiting_cnt_.fetch_sub(1, std::memory_order_relaxed);
+    ret = true;
+  } else {
+    waiting_queue_.append_to_tail(waiter);
+  }
+  return ret;
+}
+
+void AdmissionControl::release() noexcept {
+  running_cnt_.fetch_sub(1, std::memory_order_seq_cst);
+  if (waiting_cnt_.load(std::memory_order_seq_cst) != 0) [[unlikely]] {
+    wake_waiters_();
+  }
+}
+
+bool AdmissionControl::try_acquire_slot_() noexcept {
+  bool ret = true;
+  uint64_t max_frame_bytes = max_frame_bytes_.load(std::memory_order_relaxed);
+  uint64_t max_running_root_cnt = max_running_root_cnt_.load(std::memory_order_relaxed);
+  if (max_frame_bytes != 0 && FrameByteCounter::total() >= max_frame_bytes) {
+    ret = false;
+  } else if (max_running_root_cnt == 0) {
+    running_cnt_.fetch_add(1, std::memory_order_seq_cst);
+  } else {
+    uint64_t current = running_cnt_.load(std::memory_order_relaxed);
+    do {
+      if (current >= max_running_root_cnt) {
+        ret = false;
+        break;
+      }
+    } while (!running_cnt_.compare_exchange_weak(current, current + 1, std::memory_order_seq_cst, std::memory_order_relaxed));
+  }
+  return ret;
+}
+
+void AdmissionControl::wake_waiters_() noexcept {
+  CoroutineQueue admitted_queue;
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+    while (!waiting_queue_.empty() && try_acquire_slot_()) { // slot is handed over to waiter directly
+      admitted_queue.append_to_tail(waiting_queue_.pop_from_head());
+      waiting_cnt_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  while (!admitted_queue.empty()) {
+    scheduler_->commit(admitted_queue.pop_from_head());
+  }
+}
+
+}
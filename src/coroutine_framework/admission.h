@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "queue.h"
+#include "common_execute_module.h"
+
+namespace ToE
+{
+
+struct AdmissionConfig { // 0 means unlimited
+  uint64_t max_running_root_cnt_ = 0; // root coroutines committed but not finished
+  uint64_t max_frame_bytes_ = 0; // bytes of all live coroutine frames in process, see FrameByteCounter
+};
+
+/**
+ * @brief AdmissionControl bounds live root coroutines of a scheduler.
+ * 1. try_acquire() is the fail-fast path used by commit() and rpc request dispatching(shed with Error::BUSY).
+ * 2. acquire_or_wait() is used by spawn(), caller frame is queued FIFO and resumed with a slot handed over
+ *    when some root frame finishes, so queued spawners are never overtaken by later fail-fast commits.
+ * 3. a root which spawns while holding it's own slot needs a second one, max_running_root_cnt_ should be greater
+ *    than the number of concurrent spawners.
+ */
+struct AdmissionControl {
+  AdmissionControl(CommonExecuteModule *scheduler)
+  : scheduler_{scheduler},
+  max_running_root_cnt_{0},
+  max_frame_bytes_{0},
+  running_cnt_{0},
+  waiting_cnt_{0},
+  lock_{},
+  waiting_queue_{} {}
+  AdmissionControl(const AdmissionControl &) = delete;
+  AdmissionControl &operator=(const AdmissionControl &) = delete;
+  void set_config(const AdmissionConfig &config) noexcept;
+  bool try_acquire() noexcept;
+  bool acquire_or_wait(LinkedCoroutine *waiter) noexcept; // return false if waiter is queued and should suspend
+  void release() noexcept; // called when a root frame finished
+  uint64_t running_cnt() const noexcept { return running_cnt_.load(std::memory_order_acquire); }
+private:
+  bool try_acquire_slot_() noexcept;
+  void wake_waiters_() noexcept;
+  CommonExecuteModule *scheduler_;
+  std::atomic<uint64_t> max_running_root_cnt_;
+  std::atomic<uint64_t> max_frame_bytes_;
+  std::atomic<uint64_t> running_cnt_;
+  std::atomic<uint64_t> waiting_cnt_;
+  std::mutex lock_;
+  CoroutineQueue waiting_queue_;
+};
+
+}
@@ -5,71 +5,14 @@
 #include "coroutine_framework/net_module/rpc_mapper.h"
 #include <utility>
 #include "coroutine_framework/common_execute_module.h"
+#include "coroutine_framework/cancellation.h"
+#include "coroutine_framework/time_module/timing_wheel.h"
 
 namespace ToE
 {
 
-// namespace combine
-// {
-
-// enum class Operator {
-//   OR = 1,
-//   AND = 2,
-// };
-
-// struct IAsyncCallBack {
-//   IAsyncCallBack() : is_finished_{false}, concurrent_controlloer_{nullptr} {}
-//   constexpr bool await_ready() const noexcept { return false; }
-//   virtual void acquire_lock() const {
-//     if (concurrent_controlloer_) { // if not null, means there is a combined async operations
-//       combined_async_operations_->async_start();
-//     }
-//   }
-//   virtual void async_finish() {
-//     is_finished_ = true;
-//   }
-//   virtual void cancel() const = 0;
-//   bool is_finished() const { return is_finished_; }
-//   bool is_finished_;
-//   ConCurrentController *concurrent_controlloer_;
-// };
-
-// template <Operator OPERATOR, typename T, typename U>
-// struct AsyncOperations;
-
-// template <typename T>
-// struct AsyncSingleOperation_CRTP : public IAsyncCallBack {
-//   AsyncSingleOperation_CRTP() : IAsyncCallBack{} {}
-//   template <typename U>
-//   AsyncOperations<Operator::OR, T, U> operator||(AsyncSingleOperation_CRTP<U> &&rhs) {
-//     return {std::move(*((T *)this)), std::move(rhs)};
-//   }
-//   template <typename U>
-//   AsyncOperations<Operator::AND, T, U> operator&&(AsyncSingleOperation_CRTP<U> &&rhs) {
-//     return {std::move(static_cast<T&&>(*this)), std::move(static_cast<U&&>(rhs))};
-//   }
-// };
-
-// template <Operator OPERATOR, typename T, typename U>
-// struct AsyncOperations {
-//   using tuple_types = std::tuple<T, U>;
-//   AsyncOperations(T &&arg1, U &&arg2)
-//   : async_pair_{std::move(arg1), std::move(arg2)} {}
-//   bool is_finished() const noexcept {
-//     bool ret = false;
-//     if constexpr (OPERATOR == Operator::OR) {
-//       ret = async_pair_.first.is_finished() || async_pair_.second.is_finished();
-//     } else if constexpr (OPERATOR == Operator::AND) {
-//       ret = async_pair_.first.is_finished() && async_pair_.second.is_finished();
-//     } else {
-//       static_assert(false, "not support");
-//     }
-//     return ret;
-//   }
-//   std::pair<T, U> async_pair_;
-// };
-
-// }
+struct TimeService;
+struct NetServiceBase;
 
 struct co_suspend {
   constexpr bool await_ready() noexcept { return false; }
@@ -78,22 +21,111 @@ struct co_suspend {
   constexpr void await_resume() noexcept {}
 };
 
-struct co_sleep {
-  co_sleep(const uint64_t sleep_ts) : sleep_ts_{sleep_ts} {}
-  constexpr bool await_ready() noexcept { return false; }
+class TimerHandle;
+struct WorkerTimers;
+
+/**
+ * @brief co_sleep suspends current coroutine until timeout, aborted with Error::CANCELED by cancellation token.
+ * on a scheduler worker it arms WorkerTimers of the worker, and is resumed by the same worker without lock.
+ * slack allows waking up to slack late, sleeps with overlapping windows are coalesced into one wake up,
+ * use it for heartbeats, refreshes and other "roughly N" sleeps.
+ * bind(handle) arms the sleep through a caller owned TimerHandle, then any one holding the handle can race with it:
+ * handle.cancel() wakes sleeper at once with Error::CANCELED, handle.reschedule() moves the wake up time, both O(1).
+ */
+struct co_sleep : public CancelCallBack, public TimerCallBack {
+  co_sleep(const uint64_t sleep_ts, const uint64_t slack = 0)
+  : CancelCallBack{},
+  TimerCallBack{},
+  sleep_ts_{sleep_ts},
+  slack_{slack},
+  timer_node_{},
+  scheduler_{nullptr},
+  time_module_{nullptr},
+  cancel_state_{nullptr},
+  handle_{nullptr},
+  prev_callback_{nullptr},
+  worker_timers_{nullptr},
+  timer_cancelled_{false},
+  handle_busy_{false},
+  deadline_{0} {}
+  co_sleep &&bind(TimerHandle &handle) && noexcept { handle_ = &handle; return std::move(*this); }
+  bool await_ready() noexcept { return cancel_state_ && cancel_state_->is_cancelled(); }
   template <typename Promise>
-  void await_suspend(std::coroutine_handle<Promise> handle);
-  void await_resume() {}
+  bool await_suspend(std::coroutine_handle<Promise> handle);
+  Expected<void> await_resume() noexcept;
+  void bind_cancel_state(CancelState *cancel_state) noexcept { cancel_state_ = cancel_state; }
+  virtual void on_cancel() noexcept override;
+  virtual void on_timer(const bool cancelled) noexcept override; // only for sleep bound to TimerHandle
 private:
   const uint64_t sleep_ts_;
+  const uint64_t slack_;
+  TimerNode timer_node_;
+  CommonExecuteModule *scheduler_;
+  TimeService *time_module_;
+  CancelState *cancel_state_;
+  TimerHandle *handle_;
+  TimerCallBack *prev_callback_; // callback of bound handle, given back before frame is resumed
+  WorkerTimers *worker_timers_;
+  bool timer_cancelled_;
+  bool handle_busy_; // bound handle is armed by others
+protected:
+  uint64_t deadline_; // absolute deadline if not 0, else now + sleep_ts_
+};
+
+enum class MissedTickPolicy : uint8_t {
+  BURST = 1, // resume at once for each missed deadline until caught up
+  SKIP = 2, // drop missed deadlines, wait for next one on the grid
+};
+
+struct co_interval_tick;
+
+/**
+ * @brief co_interval is a periodic timer on absolute deadlines start + N * period, it never drifts
+ * no matter how long the loop body takes, and re-arms the wheel directly with the next deadline each round.
+ * co_await interval.tick() returns number of deadlines consumed, 1 unless SKIP dropped some,
+ * aborted with Error::CANCELED by cancellation token, deadline is not consumed then.
+ * it's owned by one coroutine, only one tick() can be pending at a time.
+ */
+struct co_interval {
+  co_interval(const uint64_t period, const MissedTickPolicy policy = MissedTickPolicy::SKIP, const uint64_t slack = 0);
+  co_interval(const co_interval &) = delete;
+  co_interval &operator=(const co_interval &) = delete;
+  co_interval_tick tick() noexcept;
+  void reset() noexcept; // restart the grid from now
+  uint64_t period() const noexcept { return period_; }
+  uint64_t next_deadline() const noexcept { return next_deadline_; }
+private:
+  friend struct co_interval_tick;
+  uint64_t consume_(const uint64_t now) noexcept; // return deadlines consumed
+  const uint64_t period_;
+  const uint64_t slack_;
+  const MissedTickPolicy policy_;
+  uint64_t next_deadline_;
+};
+
+struct co_interval_tick : public co_sleep { // sleep until next deadline of interval
+  co_interval_tick(co_interval &interval) : co_sleep{0, interval.slack_}, interval_{&interval} { deadline_ = interval.next_deadline_; }
+  bool await_ready() noexcept;
+  Expected<uint64_t> await_resume() noexcept;
+private:
+  co_interval *interval_;
+};
+
+struct co_cancel_token { // fetch cancellation token of current coroutine chain, never suspend
+  co_cancel_token() : cancel_state_{nullptr} {}
+  constexpr bool await_ready() const noexcept { return true; }
+  constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+  CancellationToken await_resume() const { return CancellationToken{cancel_state_}; }
+  void bind_cancel_state(CancelState *cancel_state) noexcept { cancel_state_ = cancel_state; }
+private:
+  CancelState *cancel_state_;
 };
 
 template <auto FUNC_PTR>
-struct RpcBase : public CoRpcCallBack {
+struct RpcBase : public CoRpcCallBack, public CancelCallBack {
   static constexpr size_t RPC_ID = FunctionToID<FUNC_PTR>::value;
   using CORO_RET = FunctionToID<FUNC_PTR>::FunctionTraits::return_type;
   using RET = CORO_RET::return_type;
-  static constexpr uint64_t LOCAL_BUFFER_SIZE = 1_KiB;
   RpcBase()
   : endpoints_{},
   finish_condition_{FinishCondition::WHEN_ALL},
@@ -103,9 +135,16 @@ struct RpcBase : public CoRpcCallBack {
   total_serialize_size_{0},
   received_results_{},
   on_each_function_{},
-  coroutine_{nullptr} {}
+  coroutine_{nullptr},
+  rpc_id_{0},
+  scheduler_{nullptr},
+  net_module_{nullptr},
+  cancel_state_{nullptr},
+  posted_{false} {}
   RpcBase(RpcBase<FUNC_PTR> &&rhs)
-  : endpoints_{std::move(rhs.endpoints_)},
+  : CoRpcCallBack{},
+  CancelCallBack{},
+  endpoints_{std::move(rhs.endpoints_)},
   finish_condition_{rhs.finish_condition_},
   timeout_{rhs.timeout_},
   func_id_{rhs.func_id_},
@@ -113,7 +152,12 @@ struct RpcBase : public CoRpcCallBack {
   total_serialize_size_{rhs.total_serialize_size_},
   received_results_{std::move(rhs.received_results_)},
   on_each_function_{std::move(rhs.on_each_function_)},
-  coroutine_{rhs.coroutine_} {}
+  coroutine_{rhs.coroutine_},
+  rpc_id_{rhs.rpc_id_},
+  scheduler_{rhs.scheduler_},
+  net_module_{rhs.net_module_},
+  cancel_state_{rhs.cancel_state_},
+  posted_{rhs.posted_} {}
   void timeout(const uint64_t timeout) { timeout_ = timeout; }
   template <std::ranges::range RANGE>
   void on(const RANGE &endpoints);
@@ -122,12 +166,24 @@ struct RpcBase : public CoRpcCallBack {
   void on_each_result(FUNC &&func) { on_each_function_ = func; }
   template <typename ...Args>
   void with_args(Args &&...args);
+  bool cancel_before_suspend() noexcept;
   template <typename Promise>
-  void await_suspend(std::coroutine_handle<Promise> handle);
+  bool await_suspend(std::coroutine_handle<Promise> handle);
+  void after_resume() noexcept;
   virtual void process_buffer_cb(const EndPoint peer_endpoint,
                                  const NetBuffer &net_buffer,
                                  LinkedCoroutine *&coroutine) override;
+  virtual void process_error_cb(const EndPoint peer_endpoint,
+                                const int32_t error,
+                                LinkedCoroutine *&coroutine) override;
   virtual void timeout_cb() override;
+  virtual void cancel_cb() override;
+  virtual void abort_cb() override;
+  virtual void on_cancel() noexcept override;
+  void on_result_received_(const EndPoint &peer_endpoint,
+                           Expected<RET> &&rpc_ret,
+                           LinkedCoroutine *&coroutine);
+  void fill_unreceived_results_(const int32_t error) noexcept;
   std::vector<std::pair<EndPoint, bool/*receive flag*/>> endpoints_;
   FinishCondition finish_condition_;
   uint64_t timeout_;
@@ -139,16 +195,23 @@ struct RpcBase : public CoRpcCallBack {
                      RET &,/*response result*/
                      bool &/*need_resume*/)> on_each_function_;
   LinkedCoroutine *coroutine_;
+  uint64_t rpc_id_; // slot of pending rpc table, see PendingRpcTable
+  CommonExecuteModule *scheduler_;
+  NetServiceBase *net_module_; // not null means request has been claimed
+  CancelState *cancel_state_;
+  bool posted_; // request sent to endpoints, unanswered ones get CANCEL in after_resume()
 };
 
 template <auto FUNC_PTR, bool MULTI_RPC = false>
 struct co_rpc {
   co_rpc() : rpc_base_{} {}
   co_rpc(RpcBase<FUNC_PTR> &&rhs) : rpc_base_{std::move(rhs)} {}
-  constexpr bool await_ready() const noexcept { return false; }
+  bool await_ready() noexcept { return rpc_base_.cancel_before_suspend(); }
   template <typename Promise>
-  void await_suspend(std::coroutine_handle<Promise> handle) { return rpc_base_.await_suspend(handle); }
+  bool await_suspend(std::coroutine_handle<Promise> handle) { return rpc_base_.await_suspend(handle); }
+  void bind_cancel_state(CancelState *cancel_state) noexcept { rpc_base_.cancel_state_ = cancel_state; }
   auto await_resume() {
+    rpc_base_.after_resume();
     if constexpr (MULTI_RPC) {
       return std::move(rpc_base_.received_results_);
     } else {
@@ -4,6 +4,7 @@
 #include "mechanism/serialization.hpp"
 #include "coroutine_framework/utils.h"
 #include "coroutine_framework/time_module/time_service.h"
+#include "coroutine_framework/time_module/worker_timers.h"
 #include "coroutine_framework/scheduler.h"
 #include "coroutine_framework/net_module/net_service.h"
 #ifndef SRC_COROUTINE_FRAMEWORK_ASYNC_ACTION_H_IPP
@@ -15,12 +16,119 @@ namespace ToE
 {
 
 template <typename Promise>
-void co_sleep::await_suspend(std::coroutine_handle<Promise> handle) {
+bool co_sleep::await_suspend(std::coroutine_handle<Promise> handle) {
   auto& promise = handle.promise();
-  promise.coro_local_var_->wake_up_ts_ = SteadyClockTime::now() + sleep_ts_;
-  promise.sync_release();
-  auto &time_module = TLS_FRAMEWORK->get_time_module();
-  time_module.register_frame(&promise);
+  bool ret = true;
+  uint64_t deadline = deadline_ != 0 ? deadline_ : FastClockTime::now() + sleep_ts_;
+  timer_node_.frame_ = &promise;
+  scheduler_ = TLS_SCHEDULER;
+  time_module_ = &TLS_FRAMEWORK->get_time_module();
+  if (handle_) {
+    if (handle_->armed()) [[unlikely]] {
+      handle_busy_ = true;
+      ret = false;
+    } else {
+      prev_callback_ = handle_->node_.callback_;
+      handle_->set_callback(this);
+      if (cancel_state_) {
+        cancel_state_->register_callback(this); // if cancelled just now, arm_() will see it and call on_timer()
+      }
+      promise.sync_release();
+      handle_->arm_(deadline, slack_, cancel_state_); // frame may be resumed in other thread, this can not be accessed after
+    }
+  } else if (TLS_WORKER_TIMERS) [[likely]] {
+    timer_node_.deadline_ = deadline;
+    worker_timers_ = TLS_WORKER_TIMERS; // before on_cancel() could read it
+    if (cancel_state_ && !cancel_state_->register_callback(this)) [[unlikely]] {
+      ret = false; // cancelled just now
+    } else {
+      ret = worker_timers_->arm(&timer_node_, slack_); // resumed by this worker, no release needed
+    }
+  } else {
+    timer_node_.deadline_ = deadline;
+    timer_node_.shard_ = time_module_->pick_shard(); // before on_cancel() could read it
+    if (cancel_state_) {
+      cancel_state_->register_callback(this); // if cancelled just now, register_timer() will see it and awake frame
+    }
+    promise.sync_release();
+    time_module_->register_timer(&timer_node_, slack_); // frame may be resumed in other thread, this can not be accessed after
+  }
+  return ret;
+}
+
+inline Expected<void> co_sleep::await_resume() noexcept {
+  Expected<void> ret = {};
+  if (handle_busy_) [[unlikely]] {
+    ret = UnExpected{Error::TIMER_BUSY};
+  } else {
+    if (cancel_state_) {
+      cancel_state_->deregister_callback(this);
+      if (cancel_state_->is_cancelled()) [[unlikely]] {
+        ret = UnExpected{Error::CANCELED};
+      }
+    }
+    if (timer_cancelled_) {
+      ret = UnExpected{Error::CANCELED};
+    }
+  }
+  return ret;
+}
+
+inline void co_sleep::on_cancel() noexcept {
+  if (handle_) {
+    handle_->cancel(); // on_timer(true) is called if removed, else awaken by timer, or not armed yet
+  } else if (worker_timers_) {
+    worker_timers_->cancel(&timer_node_); // owner worker resumes it, or arm() sees it
+  } else if (time_module_->unregister_timer(&timer_node_)) { // else awaken by timer, or not registered yet
+    scheduler_->commit(timer_node_.frame_);
+  }
+}
+
+inline void co_sleep::on_timer(const bool cancelled) noexcept {
+  timer_cancelled_ = cancelled;
+  handle_->set_callback(prev_callback_); // handle is disarmed and may be re-armed once frame is resumed
+  timer_node_.frame_->sync_acquire();
+  scheduler_->commit(timer_node_.frame_);
+}
+
+inline co_interval::co_interval(const uint64_t period, const MissedTickPolicy policy, const uint64_t slack)
+: period_{period},
+slack_{slack},
+policy_{policy},
+next_deadline_{FastClockTime::now() + period} {
+  assert(period != 0);
+}
+
+inline co_interval_tick co_interval::tick() noexcept {
+  return co_interval_tick{*this};
+}
+
+inline void co_interval::reset() noexcept {
+  next_deadline_ = FastClockTime::now() + period_;
+}
+
+inline uint64_t co_interval::consume_(const uint64_t now) noexcept {
+  uint64_t ret = 1;
+  if (policy_ == MissedTickPolicy::SKIP && now >= next_deadline_ + period_) {
+    ret += (now - next_deadline_) / period_;
+  }
+  next_deadline_ += ret * period_;
+  return ret;
+}
+
+inline bool co_interval_tick::await_ready() noexcept {
+  return co_sleep::await_ready() || FastClockTime::now() >= deadline_; // missed deadline in BURST is consumed at once
+}
+
+inline Expected<uint64_t> co_interval_tick::await_resume() noexcept {
+  Expected<uint64_t> ret = 0;
+  Expected<void> slept = co_sleep::await_resume();
+  if (slept) [[likely]] {
+    ret = interval_->consume_(FastClockTime::now());
+  } else {
+    ret = UnExpected{slept.error()};
+  }
+  return ret;
 }
 
 template <auto FUNC_PTR>
@@ -45,49 +153,75 @@ template <typename ...Args>
 void RpcBase<FUNC_PTR>::with_args(Args &&...args) {
   using ArgsTuple = FunctionToID<FUNC_PTR>::FunctionTraits::args_tuple;
   ArgsTuple args_tuple{std::forward<Args>(args)...};
-  PackageHeader header_placeholder{1, func_id_, 0, 0, 0}; // placeholder
-  uint64_t header_serialize_size = Serializer<PackageHeader>::get_serialize_size(header_placeholder);
-  total_serialize_size_ = header_serialize_size;
+  total_serialize_size_ = 0; // payload only, header is serialized by net module
   for_each_tuple([this](const auto &arg) {
     total_serialize_size_ += Serializer<DECAY_T(arg)>::get_serialize_size(arg);
   }, args_tuple);
-  assert(total_serialize_size_ <= LOCAL_BUFFER_SIZE); // FIXME: use dynamic buffer if too large
-  new (&send_buffer_) NetBuffer{total_serialize_size_};
-  int64_t pos = header_serialize_size;
+  send_buffer_ = NetBuffer{total_serialize_size_};
+  int64_t pos = 0;
   for_each_tuple([this, &pos](const auto &arg) {
     Serializer<DECAY_T(arg)>::serialize(arg, send_buffer_.buffer_, send_buffer_.buffer_len_, pos);
   }, args_tuple);
   assert(pos == total_serialize_size_);
 }
 
+template <auto FUNC_PTR>
+bool RpcBase<FUNC_PTR>::cancel_before_suspend() noexcept {
+  bool ret = false;
+  if (cancel_state_ && cancel_state_->is_cancelled()) [[unlikely]] {
+    cancel_cb();
+    ret = true;
+  }
+  return ret;
+}
+
 template <auto FUNC_PTR>
 template <typename Promise>
-void RpcBase<FUNC_PTR>::await_suspend(std::coroutine_handle<Promise> handle) {
+bool RpcBase<FUNC_PTR>::await_suspend(std::coroutine_handle<Promise> handle) {
   auto &net_module = TLS_FRAMEWORK->get_net_module();
   Promise *promise = &handle.promise();
   coroutine_ = promise;
-  uint64_t coro_id = promise->coro_local_var_->coro_id_;
-  PackageHeader header{1, func_id_, coro_id, net_module.get_listen_port(), 0};
+  scheduler_ = TLS_SCHEDULER;
+  rpc_id_ = net_module.claim_request(promise, this);
+  if (rpc_id_ == PendingRpcTable::INVALID_RPC_ID) [[unlikely]] { // too many pending rpcs, nothing sent
+    fill_unreceived_results_(Error::BUSY);
+    return false;
+  }
+  net_module_ = &net_module;
+  posted_ = true; // cleared by abort_cb() if canceled before posted
+  if (cancel_state_) {
+    cancel_state_->register_callback(this); // if cancelled just now, commit_send_request_task() will see it
+  }
+  PackageHeader header{1, func_id_, rpc_id_, net_module.get_listen_port(), total_serialize_size_};
   header.set_message_type(PackageHeader::MessageType::REQUEST);
-  uint64_t header_serialize_size = Serializer<PackageHeader>::get_serialize_size(header);
-  header.payload_len_ = total_serialize_size_ - header_serialize_size;
-  int64_t pos = 0;
-  Serializer<PackageHeader>::serialize(header, send_buffer_.buffer_, send_buffer_.buffer_len_, pos);
-  assert(pos == header_serialize_size);
   promise->sync_release();
-  net_module.commit_send_request_task(coro_id,
+  net_module.commit_send_request_task(rpc_id_,
                                       endpoints_,
-                                      NetBufferView{send_buffer_},
+                                      OutgoingFrame{header, std::move(send_buffer_)},
                                       timeout_,
                                       promise,
                                       this);
+  return true;
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::after_resume() noexcept {
+  if (cancel_state_) {
+    cancel_state_->deregister_callback(this);
+  }
+  if (posted_) { // servers not responded are still running handler(when_any/when_majority/timeout/canceled)
+    for (auto &endpoint_with_flag : endpoints_) {
+      if (!endpoint_with_flag.second) {
+        net_module_->commit_send_cancel_task(endpoint_with_flag.first, rpc_id_, func_id_);
+      }
+    }
+  }
 }
 
 template <auto FUNC_PTR>
 void RpcBase<FUNC_PTR>::process_buffer_cb(const EndPoint peer_endpoint,
                                           const NetBuffer &net_buffer,
                                           LinkedCoroutine *&coroutine) {
-  auto total = endpoints_.size();
   Expected<RET> rpc_ret;
   RET &return_value = rpc_ret.value();
   bool need_awaken = false;
@@ -95,7 +229,23 @@ void RpcBase<FUNC_PTR>::process_buffer_cb(const EndPoint peer_endpoint,
   if (on_each_function_) {
     on_each_function_(peer_endpoint, return_value, need_awaken);
   }
-  received_results_.push_back({peer_endpoint, Expected<RET>{std::move(rpc_ret)}});
+  on_result_received_(peer_endpoint, std::move(rpc_ret), coroutine);
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::process_error_cb(const EndPoint peer_endpoint,
+                                         const int32_t error,
+                                         LinkedCoroutine *&coroutine) {
+  on_result_received_(peer_endpoint, UnExpected{Error{error}}, coroutine);
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::on_result_received_(const EndPoint &peer_endpoint,
+                                            Expected<RET> &&rpc_ret,
+                                            LinkedCoroutine *&coroutine) {
+  auto total = endpoints_.size();
+  bool need_awaken = false;
+  received_results_.push_back({peer_endpoint, std::move(rpc_ret)});
   for (auto &endpoint_with_flag : endpoints_) {
     if (endpoint_with_flag.first == peer_endpoint) {
       endpoint_with_flag.second = true;
@@ -123,9 +273,33 @@ void RpcBase<FUNC_PTR>::process_buffer_cb(const EndPoint peer_endpoint,
 
 template <auto FUNC_PTR>
 void RpcBase<FUNC_PTR>::timeout_cb() {
+  fill_unreceived_results_(Error::RPC_TIMEOUT);
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::cancel_cb() {
+  fill_unreceived_results_(Error::CANCELED);
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::abort_cb() {
+  posted_ = false; // on_cancel() may still be running on canceller thread, net_module_ is kept
+  fill_unreceived_results_(Error::CANCELED);
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::on_cancel() noexcept {
+  LinkedCoroutine *coroutine = net_module_->cancel_request(rpc_id_);
+  if (coroutine) { // else response/timeout has awaken it, or request not committed yet
+    scheduler_->commit(coroutine);
+  }
+}
+
+template <auto FUNC_PTR>
+void RpcBase<FUNC_PTR>::fill_unreceived_results_(const int32_t error) noexcept {
   for (auto &endpoint_with_flag : endpoints_) {
     if (!endpoint_with_flag.second) {
-      received_results_.push_back({endpoint_with_flag.first, UnExpected{Error::RPC_TIMEOUT}});
+      received_results_.push_back({endpoint_with_flag.first, UnExpected{Error{error}}});
     }
   }
   assert(received_results_.size() == endpoints_.size());
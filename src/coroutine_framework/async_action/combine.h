@@ -0,0 +1,176 @@
+#ifndef SRC_COROUTINE_FRAMEWORK_COMBINE_H
+#define SRC_COROUTINE_FRAMEWORK_COMBINE_H
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "coroutine_framework/task.h"
+#include "coroutine_framework/cancellation.h"
+#include "async_action.h"
+
+namespace ToE
+{
+
+namespace combine
+{
+
+enum class Operator {
+  OR = 1, // first finished wins, the others are canceled
+  AND = 2, // wait for all
+};
+
+template <Operator OPERATOR, typename ...ASYNCS>
+struct AsyncOperations;
+
+template <typename ASYNC>
+struct TimeoutOperation;
+
+template <typename T>
+struct IsCombinable : std::false_type {};
+template <>
+struct IsCombinable<co_sleep> : std::true_type {};
+template <>
+struct IsCombinable<co_interval_tick> : std::true_type {};
+template <auto FUNC_PTR, bool MULTI_RPC>
+struct IsCombinable<co_rpc<FUNC_PTR, MULTI_RPC>> : std::true_type {};
+template <typename Ret>
+struct IsCombinable<CoroTask<Ret>> : std::true_type {};
+template <Operator OPERATOR, typename ...ASYNCS>
+struct IsCombinable<AsyncOperations<OPERATOR, ASYNCS...>> : std::true_type {};
+template <typename ASYNC>
+struct IsCombinable<TimeoutOperation<ASYNC>> : std::true_type {};
+
+// awaitables accepted by combinators and operator||/operator&&, moved into the combined awaitable
+template <typename T>
+concept Combinable = IsCombinable<std::remove_cvref_t<T>>::value;
+
+template <typename ASYNC>
+struct AwaitResult {
+  using type = std::remove_cvref_t<decltype(std::declval<ASYNC &>().await_resume())>;
+};
+template <typename Ret>
+struct AwaitResult<CoroTask<Ret>> {
+  using type = Ret;
+};
+
+// result of one branch, void is stored as std::monostate
+template <typename ASYNC>
+using BranchResult = std::conditional_t<std::is_void_v<typename AwaitResult<ASYNC>::type>,
+                                        std::monostate,
+                                        typename AwaitResult<ASYNC>::type>;
+
+template <typename T>
+struct IsExpected : std::false_type {};
+template <typename T>
+struct IsExpected<Expected<T>> : std::true_type {};
+
+/**
+ * @brief AsyncOperations awaits several awaitables of any kind concurrently.
+ * 1. each awaitable runs in it's own branch frame, so several co_rpc/co_sleep are suspended at the same time,
+ *    bound to a cancel state owned by the operation, which follows caller's cancellation token.
+ * 2. OR resumes with std::variant holding the first finished result, index() tells which one,
+ *    the losing branches are canceled at once when the first one finishes.
+ * 3. AND resumes with std::tuple of all results.
+ * 4. branches are started inline in await_suspend, caller is resumed exactly once after every branch has finished,
+ *    so awaitables may refer to caller's locals, and caller does not suspend if all branches finished inline.
+ *    a canceled loser of OR delays caller until it returns, which is at once for co_sleep/co_rpc, but a CoroTask
+ *    branch only stops at it's next cancel aware await(see transform_awaitable()), never while computing.
+ */
+template <Operator OPERATOR, typename ...ASYNCS>
+struct AsyncOperations : public CancelCallBack {
+  static constexpr std::size_t BRANCH_NUM = sizeof...(ASYNCS);
+  static constexpr std::size_t NO_WINNER = BRANCH_NUM;
+  using result_type = std::conditional_t<OPERATOR == Operator::OR,
+                                         std::variant<BranchResult<ASYNCS>...>,
+                                         std::tuple<BranchResult<ASYNCS>...>>;
+  AsyncOperations(std::tuple<ASYNCS...> &&asyncs)
+  : CancelCallBack{},
+  asyncs_{std::move(asyncs)},
+  results_{},
+  remaining_{0},
+  winner_{NO_WINNER},
+  frame_{nullptr},
+  scheduler_{nullptr},
+  cancel_state_{nullptr},
+  parent_cancel_state_{nullptr} {}
+  AsyncOperations(AsyncOperations &&rhs) // only moved before awaited
+  : AsyncOperations{std::move(rhs.asyncs_)} { parent_cancel_state_ = rhs.parent_cancel_state_; }
+  AsyncOperations &operator=(AsyncOperations &&) = delete;
+  ~AsyncOperations() { if (cancel_state_) { cancel_state_->dec_ref(); } }
+  constexpr bool await_ready() const noexcept { return false; }
+  template <typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> handle);
+  result_type await_resume();
+  void bind_cancel_state(CancelState *cancel_state) noexcept { parent_cancel_state_ = cancel_state; }
+  virtual void on_cancel() noexcept override { cancel_state_->cancel(); } // caller canceled, abort all branches
+  std::tuple<ASYNCS...> asyncs_;
+private:
+  template <std::size_t IDX, Operator OP, typename ...AS>
+  friend CoroTask<void> run_branch(AsyncOperations<OP, AS...> *operations);
+  template <std::size_t ...IDX>
+  void start_branches_(std::index_sequence<IDX...>);
+  void start_branch_(CoroTask<void> &&branch);
+  void finish_branch_(const std::size_t idx) noexcept; // last access of branch frame to this
+  template <std::size_t IDX>
+  result_type take_winner_();
+  std::tuple<std::optional<BranchResult<ASYNCS>>...> results_;
+  std::atomic<int64_t> remaining_; // unfinished branches, plus one held by await_suspend
+  std::atomic<std::size_t> winner_; // OR only
+  LinkedCoroutine *frame_;
+  CommonExecuteModule *scheduler_;
+  CancelState *cancel_state_; // shared by all branches
+  CancelState *parent_cancel_state_;
+};
+
+/**
+ * @brief TimeoutOperation races an awaitable with co_sleep(timeout),
+ * resumes with the awaitable's result(wrapped in Expected if it's not), or Error::TIMEOUT.
+ * awaitable is canceled at the deadline but not detached, caller resumes once it returns, see AsyncOperations 4.
+ */
+template <typename ASYNC>
+struct TimeoutOperation {
+  using inner_type = typename AwaitResult<ASYNC>::type;
+  using result_type = std::conditional_t<IsExpected<inner_type>::value, inner_type, Expected<inner_type>>;
+  TimeoutOperation(ASYNC &&async, const uint64_t timeout)
+  : operations_{std::tuple<ASYNC, co_sleep>{std::move(async), co_sleep{timeout}}} {}
+  constexpr bool await_ready() const noexcept { return false; }
+  template <typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> handle) { return operations_.await_suspend(handle); }
+  result_type await_resume();
+  void bind_cancel_state(CancelState *cancel_state) noexcept { operations_.bind_cancel_state(cancel_state); }
+private:
+  AsyncOperations<Operator::OR, ASYNC, co_sleep> operations_;
+};
+
+}
+
+// co_await when_any(co_sleep(1_s), co_rpc<...>()...), resumes with std::variant of the first finished result
+template <combine::Combinable ...ASYNCS>
+auto when_any(ASYNCS &&...asyncs);
+
+// co_await when_all(co_sleep(1_s), co_rpc<...>()...), resumes with std::tuple of all results
+template <combine::Combinable ...ASYNCS>
+auto when_all(ASYNCS &&...asyncs);
+
+// co_await with_timeout(awaitable, 100_ms), resumes with Expected result, Error::TIMEOUT if timeout fires first,
+// not before the canceled awaitable has returned, a CoroTask busy computing overruns the timeout
+template <combine::Combinable ASYNC>
+auto with_timeout(ASYNC &&async, const uint64_t timeout);
+
+// a || b is when_any(a, b), a && b is when_all(a, b), chained same operator is flattened
+template <combine::Combinable T, combine::Combinable U>
+auto operator||(T &&lhs, U &&rhs);
+
+template <combine::Combinable T, combine::Combinable U>
+auto operator&&(T &&lhs, U &&rhs);
+
+}
+
+#ifndef SRC_COROUTINE_FRAMEWORK_COMBINE_H_IPP
+#define SRC_COROUTINE_FRAMEWORK_COMBINE_H_IPP
+#include "combine.ipp"
+#endif
+#endif
@@ -0,0 +1,168 @@
+#ifndef SRC_COROUTINE_FRAMEWORK_COMBINE_IPP
+#define SRC_COROUTINE_FRAMEWORK_COMBINE_IPP
+#include "coroutine_framework/common_execute_module.h"
+#ifndef SRC_COROUTINE_FRAMEWORK_COMBINE_H_IPP
+#define SRC_COROUTINE_FRAMEWORK_COMBINE_H_IPP
+#include "combine.h"
+#endif
+
+namespace ToE
+{
+
+namespace combine
+{
+
+template <std::size_t IDX, Operator OPERATOR, typename ...ASYNCS>
+CoroTask<void> run_branch(AsyncOperations<OPERATOR, ASYNCS...> *operations) {
+  using ASYNC = std::tuple_element_t<IDX, std::tuple<ASYNCS...>>;
+  if constexpr (std::is_void_v<typename AwaitResult<ASYNC>::type>) {
+    co_await std::move(std::get<IDX>(operations->asyncs_));
+    std::get<IDX>(operations->results_).emplace();
+  } else {
+    std::get<IDX>(operations->results_).emplace(co_await std::move(std::get<IDX>(operations->asyncs_)));
+  }
+  operations->finish_branch_(IDX); // caller may be resumed and destroy operations after it
+  co_return;
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+template <typename Promise>
+bool AsyncOperations<OPERATOR, ASYNCS...>::await_suspend(std::coroutine_handle<Promise> handle) {
+  frame_ = &handle.promise();
+  scheduler_ = TLS_SCHEDULER;
+  cancel_state_ = new CancelState{};
+  remaining_.store(BRANCH_NUM + 1, std::memory_order_relaxed); // branches finished inline never resume caller
+  if (parent_cancel_state_ && !parent_cancel_state_->register_callback(this)) [[unlikely]] {
+    cancel_state_->cancel(); // canceled already, branches abort at once
+  }
+  start_branches_(std::index_sequence_for<ASYNCS...>{});
+  frame_->sync_release();
+  return remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1; // once released, caller may be resumed in other thread
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+typename AsyncOperations<OPERATOR, ASYNCS...>::result_type AsyncOperations<OPERATOR, ASYNCS...>::await_resume() {
+  if (parent_cancel_state_) {
+    parent_cancel_state_->deregister_callback(this);
+  }
+  if constexpr (OPERATOR == Operator::OR) {
+    return take_winner_<0>();
+  } else {
+    return std::apply([](auto &...results) { return result_type{std::move(*results)...}; }, results_);
+  }
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+template <std::size_t ...IDX>
+void AsyncOperations<OPERATOR, ASYNCS...>::start_branches_(std::index_sequence<IDX...>) {
+  (start_branch_(run_branch<IDX>(this)), ...);
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+void AsyncOperations<OPERATOR, ASYNCS...>::start_branch_(CoroTask<void> &&branch) {
+  branch.bind_cancellation(CancellationToken{cancel_state_});
+  LinkedCoroutine *frame = branch.promise_;
+  branch.reset(); // ref is owned by branch frame itself, released when it finishes
+  frame->handle_.resume(); // run until first suspension
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+void AsyncOperations<OPERATOR, ASYNCS...>::finish_branch_(const std::size_t idx) noexcept {
+  if constexpr (OPERATOR == Operator::OR) {
+    std::size_t expected = NO_WINNER;
+    if (winner_.compare_exchange_strong(expected, idx, std::memory_order_acq_rel)) {
+      cancel_state_->cancel(); // losers are resumed with Error::CANCELED and finish soon
+    }
+  }
+  LinkedCoroutine *frame = frame_;
+  CommonExecuteModule *scheduler = scheduler_;
+  if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    frame->sync_acquire();
+    scheduler->commit(frame);
+  }
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+template <std::size_t IDX>
+typename AsyncOperations<OPERATOR, ASYNCS...>::result_type AsyncOperations<OPERATOR, ASYNCS...>::take_winner_() {
+  if constexpr (IDX + 1 < BRANCH_NUM) {
+    if (winner_.load(std::memory_order_relaxed) != IDX) {
+      return take_winner_<IDX + 1>();
+    }
+  }
+  return result_type{std::in_place_index<IDX>, std::move(*std::get<IDX>(results_))};
+}
+
+template <typename ASYNC>
+typename TimeoutOperation<ASYNC>::result_type TimeoutOperation<ASYNC>::await_resume() {
+  auto result = operations_.await_resume();
+  if (result.index() == 0) [[likely]] {
+    if constexpr (std::is_void_v<inner_type>) {
+      return {};
+    } else {
+      return std::move(std::get<0>(result));
+    }
+  } else if (!std::get<1>(result)) { // sleep was canceled, caller's token canceled
+    return UnExpected{Error::CANCELED};
+  }
+  return UnExpected{Error::TIMEOUT};
+}
+
+template <Operator OPERATOR, typename T>
+struct IsSameOperations : std::false_type {};
+template <Operator OPERATOR, typename ...ASYNCS>
+struct IsSameOperations<OPERATOR, AsyncOperations<OPERATOR, ASYNCS...>> : std::true_type {};
+
+template <Operator OPERATOR, typename T>
+auto as_branches(T &&async) { // flatten same operator chain, a || b || c has three branches
+  using ASYNC = std::remove_cvref_t<T>;
+  if constexpr (IsSameOperations<OPERATOR, ASYNC>::value && std::is_rvalue_reference_v<T &&>) {
+    return std::move(async.asyncs_);
+  } else {
+    return std::tuple<ASYNC>{std::forward<T>(async)};
+  }
+}
+
+template <Operator OPERATOR, typename ...ASYNCS>
+auto make_operations(std::tuple<ASYNCS...> &&asyncs) {
+  return AsyncOperations<OPERATOR, ASYNCS...>{std::move(asyncs)};
+}
+
+}
+
+template <combine::Combinable ...ASYNCS>
+auto when_any(ASYNCS &&...asyncs) {
+  static_assert(sizeof...(ASYNCS) > 0);
+  return combine::AsyncOperations<combine::Operator::OR, std::remove_cvref_t<ASYNCS>...>{
+    std::tuple<std::remove_cvref_t<ASYNCS>...>{std::forward<ASYNCS>(asyncs)...}};
+}
+
+template <combine::Combinable ...ASYNCS>
+auto when_all(ASYNCS &&...asyncs) {
+  static_assert(sizeof...(ASYNCS) > 0);
+  return combine::AsyncOperations<combine::Operator::AND, std::remove_cvref_t<ASYNCS>...>{
+    std::tuple<std::remove_cvref_t<ASYNCS>...>{std::forward<ASYNCS>(asyncs)...}};
+}
+
+template <combine::Combinable ASYNC>
+auto with_timeout(ASYNC &&async, const uint64_t timeout) {
+  return combine::TimeoutOperation<std::remove_cvref_t<ASYNC>>{std::remove_cvref_t<ASYNC>{std::forward<ASYNC>(async)}, timeout};
+}
+
+template <combine::Combinable T, combine::Combinable U>
+auto operator||(T &&lhs, U &&rhs) {
+  return combine::make_operations<combine::Operator::OR>(
+    std::tuple_cat(combine::as_branches<combine::Operator::OR>(std::forward<T>(lhs)),
+                   combine::as_branches<combine::Operator::OR>(std::forward<U>(rhs))));
+}
+
+template <combine::Combinable T, combine::Combinable U>
+auto operator&&(T &&lhs, U &&rhs) {
+  return combine::make_operations<combine::Operator::AND>(
+    std::tuple_cat(combine::as_branches<combine::Operator::AND>(std::forward<T>(lhs)),
+                   combine::as_branches<combine::Operator::AND>(std::forward<U>(rhs))));
+}
+
+}
+
+#endif
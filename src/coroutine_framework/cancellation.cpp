@@ -0,0 +1,83 @@
+#include "cancellation.h"
+
+namespace ToE
+{
+
+bool CancelState::cancel() noexcept {
+  std::lock_guard<std::mutex> lg(lock_);
+  bool ret = false;
+  if (!cancelled_.load(std::memory_order_relaxed)) {
+    cancelled_.store(true, std::memory_order_release);
+    CancelCallBack *iter = callbacks_;
+    while (iter) {
+      CancelCallBack *tmp_next = iter->next_; // owner of iter may be resumed in on_cancel(), but blocked on lock_ to deregister
+      iter->on_cancel();
+      iter = tmp_next;
+    }
+    ret = true;
+  }
+  return ret;
+}
+
+bool CancelState::register_callback(CancelCallBack *callback) noexcept {
+  std::lock_guard<std::mutex> lg(lock_);
+  bool ret = false;
+  if (!cancelled_.load(std::memory_order_relaxed)) [[likely]] {
+    assert(!callback->registered_);
+    callback->prev_ = nullptr;
+    callback->next_ = callbacks_;
+    if (callbacks_) {
+      callbacks_->prev_ = callback;
+    }
+    callbacks_ = callback;
+    callback->registered_ = true;
+    ret = true;
+  }
+  return ret;
+}
+
+void CancelState::deregister_callback(CancelCallBack *callback) noexcept {
+  std::lock_guard<std::mutex> lg(lock_);
+  if (callback->registered_) {
+    if (callback->prev_) {
+      callback->prev_->next_ = callback->next_;
+    } else {
+      callbacks_ = callback->next_;
+    }
+    if (callback->next_) {
+      callback->next_->prev_ = callback->prev_;
+    }
+    callback->prev_ = nullptr;
+    callback->next_ = nullptr;
+    callback->registered_ = false;
+  }
+}
+
+CancellationToken &CancellationToken::operator=(const CancellationToken &rhs) {
+  if (this != &rhs) [[likely]] {
+    reset();
+    state_ = rhs.state_;
+    if (state_) {
+      state_->inc_ref();
+    }
+  }
+  return *this;
+}
+
+CancellationToken &CancellationToken::operator=(CancellationToken &&rhs) {
+  if (this != &rhs) [[likely]] {
+    reset();
+    state_ = rhs.state_;
+    rhs.state_ = nullptr;
+  }
+  return *this;
+}
+
+void CancellationToken::reset() noexcept {
+  if (state_) {
+    state_->dec_ref();
+    state_ = nullptr;
+  }
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <assert.h>
+#include "utils.h"
+
+namespace ToE
+{
+
+/**
+ * @brief CancelCallBack is an intrusive registration on a CancelState.
+ * Pending async actions(co_sleep, co_rpc...) register themselves when suspended, and deregister when resumed,
+ * on_cancel() is called with CancelState's lock held, so it must not block or deregister itself.
+ */
+struct CancelCallBack {
+  CancelCallBack() : prev_{nullptr}, next_{nullptr}, registered_{false} {}
+  CancelCallBack(const CancelCallBack &) : CancelCallBack{} {} // registration is never copied
+  CancelCallBack &operator=(const CancelCallBack &) { return *this; }
+  virtual void on_cancel() noexcept = 0;
+  CancelCallBack *prev_;
+  CancelCallBack *next_;
+  bool registered_;
+};
+
+struct CancelState {
+  CancelState() : ref_cnt_{}, cancelled_{false}, lock_{}, callbacks_{nullptr} {}
+  CancelState(const CancelState &) = delete;
+  CancelState &operator=(const CancelState &) = delete;
+  bool is_cancelled() const noexcept { return cancelled_.load(std::memory_order_acquire); }
+  bool cancel() noexcept; // return true only for the first caller
+  bool register_callback(CancelCallBack *callback) noexcept; // return false if already cancelled
+  void deregister_callback(CancelCallBack *callback) noexcept;
+  void inc_ref() noexcept { ref_cnt_.inc(); }
+  void dec_ref() noexcept { if (ref_cnt_.dec() == 1) { delete this; } }
+private:
+  RefCount ref_cnt_;
+  std::atomic<bool> cancelled_;
+  std::mutex lock_;
+  CancelCallBack *callbacks_;
+};
+
+/**
+ * @brief CancellationToken is the observer side of a CancelState, has value sematics.
+ * A token bound to a root CoroTask is shared by the whole coroutine chain through CoroLocalVar,
+ * every cancel aware co_await in the chain checks it, and pending co_sleep/co_rpc are aborted when it is cancelled.
+ * Plain computation and co_await of a child CoroTask never check it, see transform_awaitable().
+ */
+struct CancellationToken {
+  CancellationToken() : state_{nullptr} {}
+  explicit CancellationToken(CancelState *state) : state_{state} { if (state_) { state_->inc_ref(); } }
+  CancellationToken(const CancellationToken &rhs) : CancellationToken{rhs.state_} {}
+  CancellationToken(CancellationToken &&rhs) : state_{rhs.state_} { rhs.state_ = nullptr; }
+  CancellationToken &operator=(const CancellationToken &rhs);
+  CancellationToken &operator=(CancellationToken &&rhs);
+  ~CancellationToken() { reset(); }
+  void reset() noexcept;
+  bool can_be_cancelled() const noexcept { return nullptr != state_; }
+  bool is_cancelled() const noexcept { return state_ && state_->is_cancelled(); }
+  CancelState *state_;
+};
+
+struct CancellationSource {
+  CancellationSource() : state_{new CancelState{}} {}
+  CancellationSource(const CancellationSource &rhs) : state_{rhs.state_} { state_->inc_ref(); }
+  CancellationSource(CancellationSource &&rhs) = delete;
+  CancellationSource &operator=(const CancellationSource &) = delete;
+  CancellationSource &operator=(CancellationSource &&) = delete;
+  ~CancellationSource() { state_->dec_ref(); }
+  CancellationToken token() const { return CancellationToken{state_}; }
+  bool cancel() noexcept { return state_->cancel(); }
+  bool is_cancelled() const noexcept { return state_->is_cancelled(); }
+  CancelState *state_;
+};
+
+// async action which could be aborted by CancellationToken, state is bound in CoroPromise::await_transform
+template <typename T>
+concept CancelAware = requires(T action, CancelState *state) {
+  action.bind_cancel_state(state);
+};
+
+}
@@ -6,22 +6,71 @@
 namespace ToE
 {
 
+struct CommonExecuteModule;
+
+struct LocalReadyQueue { // frames committed to owner by this thread go to queue instead of shared one
+  CommonExecuteModule *owner_ = nullptr;
+  CoroutineQueue *queue_ = nullptr;
+};
+
+// set by run to completion worker while it handles it's own io, so frames woken by io stay on that core
+extern thread_local LocalReadyQueue TLS_LOCAL_READY_QUEUE;
+
 struct CommonExecuteModule {
   CommonExecuteModule()
-  : lock_{}, cv_{}, coroutine_queue_{} {}
+  : lock_{}, cv_{}, coroutine_queue_{}, external_park_{false} {}
+  virtual ~CommonExecuteModule() = default;
   void commit(LinkedCoroutine *coro_frame) noexcept {
+    if (TLS_LOCAL_READY_QUEUE.owner_ == this) [[unlikely]] {
+      TLS_LOCAL_READY_QUEUE.queue_->append_to_tail(coro_frame);
+      return;
+    }
     {
       std::unique_lock lk(lock_);
       coroutine_queue_.append_to_tail(coro_frame);
     }
-    cv_.notify_one();
+    notify_(false);
+  }
+  void commit(CoroutineQueue &coro_frames) noexcept { // bulk commit, one lock for all
+    const uint64_t frame_cnt = coro_frames.size();
+    if (TLS_LOCAL_READY_QUEUE.owner_ == this) [[unlikely]] {
+      while (!coro_frames.empty()) {
+        TLS_LOCAL_READY_QUEUE.queue_->append_to_tail(coro_frames.pop_from_head());
+      }
+      return;
+    }
+    {
+      std::unique_lock lk(lock_);
+      while (!coro_frames.empty()) {
+        coroutine_queue_.append_to_tail(coro_frames.pop_from_head());
+      }
+    }
+    notify_(frame_cnt > 1);
+  }
+  void notify_all() noexcept { // wake parked workers to recheck their own state
+    {
+      std::unique_lock lk(lock_); // pairs with predicate check of parked worker, avoid lost wakeup
+    }
+    notify_(true);
   }
 protected:
+  void notify_(const bool all) noexcept {
+    if (external_park_) [[unlikely]] {
+      wake_external_(all);
+    } else if (all) {
+      cv_.notify_all();
+    } else {
+      cv_.notify_one();
+    }
+  }
+  // workers parked out of cv_ (in net poll), flag checked by worker under lock_ before it parks
+  virtual void wake_external_(const bool) noexcept {}
   mutable std::mutex lock_;
   std::condition_variable cv_;
   CoroutineQueue coroutine_queue_;
+  bool external_park_; // set before workers start
 };
 
 extern thread_local CommonExecuteModule *TLS_SCHEDULER;
 
-}
\ No newline at end of file
+}
@@ -1,3 +1,5 @@
 #include "coroutine_framework/scheduler.h"
+#include "coroutine_framework/generator.h"
 #include "coroutine_framework/async_action/async_action.h"
+#include "coroutine_framework/async_action/combine.h"
 #include "coroutine_framework/net_module/rpc_register.h"
\ No newline at end of file
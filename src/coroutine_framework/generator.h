@@ -0,0 +1,144 @@
+#ifndef SRC_COROUTINE_FRAMEWORK_GENERATOR_H
+#define SRC_COROUTINE_FRAMEWORK_GENERATOR_H
+
+#include <coroutine>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <stdlib.h>
+#include "coroutine_framework/task.h"
+
+namespace ToE {
+
+template <typename T>
+class CoroGeneratorPromise;
+
+template <typename T>
+class AsyncGeneratorPromise;
+
+/**
+ * @brief CoroGenerator is a synchronous generator, values are produced by co_yield and pulled by range-for.
+ * 1. generator body runs inline on the consumer's thread, co_await is not allowed in it.
+ * 2. yielded value is not copied, consumer gets a reference to the object which is alive until next resume.
+ * 3. CoroGenerator is move only, coroutine frame is destroyed with it.
+ *
+ * @tparam T - yielded value type
+ */
+template <typename T>
+struct CoroGenerator {
+  using value_type = std::remove_cvref_t<T>;
+  using promise_type = CoroGeneratorPromise<T>;
+  struct Iterator {
+    using value_type = std::remove_cvref_t<T>;
+    using difference_type = std::ptrdiff_t;
+    Iterator &operator++();
+    void operator++(int) { ++*this; }
+    value_type &operator*() const noexcept { return *handle_.promise().value_ptr_; }
+    value_type *operator->() const noexcept { return handle_.promise().value_ptr_; }
+    bool operator==(std::default_sentinel_t) const noexcept { return !handle_ || handle_.done(); }
+    std::coroutine_handle<promise_type> handle_;
+  };
+  CoroGenerator(std::coroutine_handle<promise_type> h) : handle_{h} {}
+  CoroGenerator(const CoroGenerator<T> &) = delete;
+  CoroGenerator<T> &operator=(const CoroGenerator<T> &) = delete;
+  CoroGenerator(CoroGenerator<T> &&rhs) noexcept : handle_{std::exchange(rhs.handle_, nullptr)} {}
+  CoroGenerator<T> &operator=(CoroGenerator<T> &&rhs) noexcept;
+  ~CoroGenerator() { if (handle_) { handle_.destroy(); } }
+  Iterator begin(); // 首次resume, 运行至第一个co_yield
+  std::default_sentinel_t end() const noexcept { return {}; }
+  std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+class CoroGeneratorPromise {
+public:
+  using value_type = typename CoroGenerator<T>::value_type;
+  CoroGeneratorPromise() : value_ptr_{nullptr} {}
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  std::suspend_always final_suspend() noexcept { return {}; }
+  void unhandled_exception() { std::abort(); }
+  auto get_return_object() { return CoroGenerator<T>{std::coroutine_handle<CoroGeneratorPromise<T>>::from_promise(*this)}; }
+  // co_yield的临时对象存活至下一次resume, 只记录地址
+  std::suspend_always yield_value(value_type &value) noexcept { value_ptr_ = std::addressof(value); return {}; }
+  std::suspend_always yield_value(value_type &&value) noexcept { value_ptr_ = std::addressof(value); return {}; }
+  std::suspend_always yield_value(const value_type &value);
+  template <typename U>
+  void await_transform(U &&) = delete; // 同步生成器不可挂起, 需要co_await请使用AsyncGenerator
+  void return_void() {}
+  value_type *value_ptr_;
+  std::optional<value_type> const_copy_; // 仅用于co_yield const左值
+};
+
+/**
+ * @brief AsyncGenerator is a generator which can co_await async actions(co_sleep, co_rpc, CoroTask...) between yields.
+ * 1. consumed in a coroutine by `while (auto item = co_await gen.next()) {...}`, next() returns std::optional<T>,
+ *    std::nullopt means generator body has reached co_return.
+ * 2. generator frame is linked into consumer's coroutine chain on every next(), and shares consumer's CoroLocalVar,
+ *    so it's suspended/resumed by scheduler as an ordinary frame, and aborted by consumer's CancellationToken.
+ * 3. control is transfered between consumer and generator symmetrically, no scheduler round trip per item.
+ * 4. AsyncGenerator is move only and must outlive every pending next().
+ *
+ * @tparam T - yielded value type
+ */
+template <typename T>
+struct AsyncGenerator {
+  using value_type = std::remove_cvref_t<T>;
+  using promise_type = AsyncGeneratorPromise<T>;
+  struct NextAwaitable {
+    bool await_ready() const noexcept { return promise_->handle_.done(); }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> consumer) noexcept;
+    std::optional<value_type> await_resume() noexcept;
+    promise_type *promise_;
+  };
+  AsyncGenerator(std::coroutine_handle<promise_type> h) : promise_{&h.promise()} {}
+  AsyncGenerator(const AsyncGenerator<T> &) = delete;
+  AsyncGenerator<T> &operator=(const AsyncGenerator<T> &) = delete;
+  AsyncGenerator(AsyncGenerator<T> &&rhs) noexcept : promise_{std::exchange(rhs.promise_, nullptr)} {}
+  AsyncGenerator<T> &operator=(AsyncGenerator<T> &&rhs) noexcept;
+  ~AsyncGenerator() { if (promise_) { promise_->handle_.destroy(); } }
+  NextAwaitable next() noexcept { return {promise_}; }
+  bool done() const noexcept { return promise_->handle_.done(); }
+  promise_type *promise_;
+};
+
+struct GeneratorYieldAwaitable { // co_yield及co_return时, 线程转移回consumer的挂起点
+  constexpr bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept;
+  constexpr void await_resume() const noexcept {}
+  LinkedCoroutine &promise_;
+};
+
+template <typename T>
+class AsyncGeneratorPromise : public LinkedCoroutine {
+public:
+  using value_type = typename AsyncGenerator<T>::value_type;
+  AsyncGeneratorPromise() : LinkedCoroutine{}, current_{} { handle_ = std::coroutine_handle<AsyncGeneratorPromise<T>>::from_promise(*this); }
+  AsyncGeneratorPromise(const AsyncGeneratorPromise<T> &) = delete; // disallow copy
+  AsyncGeneratorPromise<T> &operator=(const AsyncGeneratorPromise<T> &) = delete; // disallow copy
+  ~AsyncGeneratorPromise() { coro_local_var_ = nullptr; } // CoroLocalVar is owned by consumer's root frame
+  std::suspend_always initial_suspend() noexcept { return {}; } // 惰性启动, 由第一次next()驱动
+  GeneratorYieldAwaitable final_suspend() noexcept { return {*this}; }
+  void unhandled_exception() { std::abort(); }
+  auto get_return_object() { return AsyncGenerator<T>{std::coroutine_handle<AsyncGeneratorPromise<T>>::from_promise(*this)}; }
+  template <typename U = value_type>
+  GeneratorYieldAwaitable yield_value(U &&value) {
+    current_.emplace(std::forward<U>(value));
+    return {*this};
+  }
+  template <typename ASYNC>
+  auto await_transform(ASYNC &&task) { return transform_awaitable(*this, std::forward<ASYNC>(task)); }
+  void return_void() {}
+  std::optional<value_type> current_; // 最近一次co_yield的值, 由NextAwaitable移出
+};
+
+}
+
+#ifndef SRC_COROUTINE_FRAMEWORK_GENERATOR_H_IPP
+#define SRC_COROUTINE_FRAMEWORK_GENERATOR_H_IPP
+#include "generator.ipp"
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef SRC_COROUTINE_FRAMEWORK_GENERATOR_IPP
+#define SRC_COROUTINE_FRAMEWORK_GENERATOR_IPP
+
+#ifndef SRC_COROUTINE_FRAMEWORK_GENERATOR_H_IPP
+#define SRC_COROUTINE_FRAMEWORK_GENERATOR_H_IPP
+#include "generator.h"
+#endif
+
+namespace ToE
+{
+
+template <typename T>
+CoroGenerator<T> &CoroGenerator<T>::operator=(CoroGenerator<T> &&rhs) noexcept {
+  if (this != &rhs) [[likely]] {
+    if (handle_) {
+      handle_.destroy();
+    }
+    handle_ = std::exchange(rhs.handle_, nullptr);
+  }
+  return *this;
+}
+
+template <typename T>
+typename CoroGenerator<T>::Iterator CoroGenerator<T>::begin() {
+  if (handle_ && !handle_.done()) {
+    handle_.resume();
+  }
+  return Iterator{handle_};
+}
+
+template <typename T>
+typename CoroGenerator<T>::Iterator &CoroGenerator<T>::Iterator::operator++() {
+  handle_.resume();
+  return *this;
+}
+
+template <typename T>
+std::suspend_always CoroGeneratorPromise<T>::yield_value(const value_type &value) {
+  const_copy_.emplace(value);
+  value_ptr_ = std::addressof(*const_copy_);
+  return {};
+}
+
+template <typename T>
+AsyncGenerator<T> &AsyncGenerator<T>::operator=(AsyncGenerator<T> &&rhs) noexcept {
+  if (this != &rhs) [[likely]] {
+    if (promise_) {
+      promise_->handle_.destroy();
+    }
+    promise_ = std::exchange(rhs.promise_, nullptr);
+  }
+  return *this;
+}
+
+template <typename T>
+template <typename Promise>
+std::coroutine_handle<> AsyncGenerator<T>::NextAwaitable::await_suspend(std::coroutine_handle<Promise> consumer) noexcept {
+  LinkedCoroutine &consumer_frame = consumer.promise();
+  consumer_frame.link_next(*promise_); // 生成器作为consumer的子协程入链, 挂起/唤醒与普通协程一致
+  promise_->coro_local_var_ = consumer_frame.coro_local_var_;
+  promise_->current_.reset();
+  return promise_->handle_;
+}
+
+template <typename T>
+std::optional<typename AsyncGenerator<T>::value_type> AsyncGenerator<T>::NextAwaitable::await_resume() noexcept {
+  std::optional<value_type> ret;
+  if (!promise_->handle_.done() && promise_->current_) [[likely]] {
+    ret.emplace(std::move(*promise_->current_));
+    promise_->current_.reset();
+  }
+  return ret;
+}
+
+inline std::coroutine_handle<> GeneratorYieldAwaitable::await_suspend(std::coroutine_handle<>) const noexcept {
+  assert(!promise_.empty()); // 生成器只能经由next()驱动, 总是存在consumer
+  std::coroutine_handle<> ret = promise_.prev_->handle_;
+  promise_.remove_self();
+  return ret;
+}
+
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include "latch.h"
+
+namespace ToE
+{
+
+void LatchState::count_down(int64_t n) noexcept {
+  int64_t old = count_.fetch_sub(n, std::memory_order_acq_rel);
+  if (old > 0 && old - n <= 0) {
+    count_.notify_all();
+  }
+}
+
+void LatchState::wait() const noexcept {
+  int64_t current = count_.load(std::memory_order_acquire);
+  while (current > 0) {
+    count_.wait(current, std::memory_order_acquire);
+    current = count_.load(std::memory_order_acquire);
+  }
+}
+
+void notify_frame_latch(LinkedCoroutine *frame) noexcept {
+  LatchState *state = frame->done_latch_.exchange(FRAME_DONE_LATCH, std::memory_order_acq_rel);
+  if (state) {
+    state->count_down();
+    state->dec_ref(); // ref taken in watch_frame
+  }
+}
+
+bool watch_frame(LinkedCoroutine *frame, LatchState *state) noexcept {
+  bool ret = true;
+  LatchState *expected = nullptr;
+  state->inc_ref();
+  if (!frame->done_latch_.compare_exchange_strong(expected, state, std::memory_order_acq_rel, std::memory_order_acquire)) {
+    state->dec_ref();
+    if (FRAME_DONE_LATCH == expected) { // frame has finished before watch
+      state->count_down();
+    } else {
+      ret = false;
+    }
+  }
+  return ret;
+}
+
+bool unwatch_frame(LinkedCoroutine *frame, LatchState *state) noexcept {
+  bool ret = false;
+  if (frame->done_latch_.compare_exchange_strong(state, nullptr, std::memory_order_acq_rel, std::memory_order_acquire)) {
+    state->dec_ref();
+    ret = true;
+  }
+  return ret;
+}
+
+bool frame_finished(LinkedCoroutine *frame) noexcept {
+  return FRAME_DONE_LATCH == frame->done_latch_.load(std::memory_order_acquire);
+}
+
+}
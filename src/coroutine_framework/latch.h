@@ -0,0 +1,89 @@
+#ifndef SRC_COROUTINE_FRAMEWORK_LATCH_H
+#define SRC_COROUTINE_FRAMEWORK_LATCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "utils.h"
+#include "queue.h"
+
+namespace ToE
+{
+
+/**
+ * @brief LatchState is the shared counter behind CountdownLatch/TaskGroup.
+ * 1. waiter blocks on count_ itself(std::atomic::wait, a futex on linux), and is woken only when count_ drops to 0,
+ *    so joining N root frames costs one kernel sleep instead of N mutex/cv cycles.
+ * 2. every watched root frame holds a ref, so the state is safe to count down after the waiter has returned.
+ */
+struct LatchState {
+  explicit LatchState(int64_t expected) : ref_cnt_{}, count_{expected} {}
+  LatchState(const LatchState &) = delete;
+  LatchState &operator=(const LatchState &) = delete;
+  void count_down(int64_t n = 1) noexcept;
+  void add(int64_t n = 1) noexcept { count_.fetch_add(n, std::memory_order_relaxed); }
+  bool try_wait() const noexcept { return count_.load(std::memory_order_acquire) <= 0; }
+  void wait() const noexcept;
+  void inc_ref() noexcept { ref_cnt_.inc(); }
+  void dec_ref() noexcept { if (ref_cnt_.dec() == 1) { delete this; } }
+private:
+  RefCount ref_cnt_;
+  std::atomic<int64_t> count_;
+};
+
+// done_latch_ of a finished root frame, later watch() counts down immediately
+inline LatchState *const FRAME_DONE_LATCH = reinterpret_cast<LatchState *>(std::uintptr_t{1});
+
+// called by root frame's FinalAwaitable, count down the latch watching it(if any)
+void notify_frame_latch(LinkedCoroutine *frame) noexcept;
+// a root frame can be watched by one latch at a time, return false if it's watched by another latch
+bool watch_frame(LinkedCoroutine *frame, LatchState *state) noexcept;
+// stop watching a unfinished frame, return false if the frame has finished(and counted down) already
+bool unwatch_frame(LinkedCoroutine *frame, LatchState *state) noexcept;
+bool frame_finished(LinkedCoroutine *frame) noexcept;
+
+struct CountdownLatch {
+  explicit CountdownLatch(int64_t expected) : state_{new LatchState{expected}} {}
+  CountdownLatch(const CountdownLatch &) = delete;
+  CountdownLatch &operator=(const CountdownLatch &) = delete;
+  ~CountdownLatch() { state_->dec_ref(); }
+  void count_down(int64_t n = 1) noexcept { state_->count_down(n); }
+  bool try_wait() const noexcept { return state_->try_wait(); }
+  void wait() const noexcept { state_->wait(); }
+  template <typename Task>
+  bool watch(Task &task) noexcept { return watch_frame(task.promise_, state_); } // frame counts down once when done
+  LatchState *state_;
+};
+
+/**
+ * @brief TaskGroup joins a dynamic set of root CoroTasks, add() may be called before or after commit.
+ */
+struct TaskGroup {
+  TaskGroup() : latch_{0} {}
+  template <typename Task>
+  bool add(Task &task) noexcept;
+  void wait() const noexcept { latch_.wait(); }
+  bool try_wait() const noexcept { return latch_.try_wait(); }
+  CountdownLatch latch_;
+};
+
+inline constexpr std::size_t WAIT_ANY_NPOS = std::numeric_limits<std::size_t>::max();
+
+// block until every CoroTask in range has finished
+template <typename Range>
+void wait_all(Range &&tasks) noexcept;
+
+// block until any CoroTask in range has finished, return it's index,
+// or WAIT_ANY_NPOS if no task could be watched(empty range, or all watched by other latches)
+template <typename Range>
+std::size_t wait_any(Range &&tasks) noexcept;
+
+}
+
+#ifndef SRC_COROUTINE_FRAMEWORK_LATCH_H_IPP
+#define SRC_COROUTINE_FRAMEWORK_LATCH_H_IPP
+#include "latch.ipp"
+#endif
+
+#endif
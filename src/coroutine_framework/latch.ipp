@@ -0,0 +1,70 @@
+#ifndef SRC_COROUTINE_FRAMEWORK_LATCH_IPP
+#define SRC_COROUTINE_FRAMEWORK_LATCH_IPP
+
+#ifndef SRC_COROUTINE_FRAMEWORK_LATCH_H_IPP
+#define SRC_COROUTINE_FRAMEWORK_LATCH_H_IPP
+#include "latch.h"
+#endif
+
+namespace ToE
+{
+
+template <typename Task>
+bool TaskGroup::add(Task &task) noexcept {
+  latch_.state_->add();
+  bool ret = latch_.watch(task);
+  if (!ret) [[unlikely]] {
+    latch_.count_down();
+  }
+  return ret;
+}
+
+template <typename Range>
+void wait_all(Range &&tasks) noexcept {
+  CountdownLatch latch{1}; // 哨兵计数, 全部watch完成后释放, 避免中途归零
+  bool all_watched = true;
+  for (auto &task : tasks) {
+    latch.state_->add();
+    if (!latch.watch(task)) [[unlikely]] {
+      latch.count_down();
+      all_watched = false;
+    }
+  }
+  latch.count_down();
+  latch.wait();
+  if (!all_watched) [[unlikely]] { // 被其他latch观察的帧, 退化为逐个等待
+    for (auto &task : tasks) {
+      task.wait();
+    }
+  }
+}
+
+template <typename Range>
+std::size_t wait_any(Range &&tasks) noexcept {
+  CountdownLatch latch{1};
+  std::size_t watched_cnt = 0;
+  for (auto &task : tasks) {
+    if (latch.watch(task)) [[likely]] {
+      watched_cnt++;
+      if (latch.try_wait()) { // 已有完成的帧, 无需继续watch
+        break;
+      }
+    }
+  }
+  std::size_t ret = WAIT_ANY_NPOS;
+  if (watched_cnt > 0) [[likely]] {
+    latch.wait();
+    std::size_t idx = 0;
+    for (auto &task : tasks) {
+      if (!unwatch_frame(task.promise_, latch.state_) && WAIT_ANY_NPOS == ret && frame_finished(task.promise_)) {
+        ret = idx;
+      }
+      idx++;
+    }
+  }
+  return ret;
+}
+
+}
+
+#endif
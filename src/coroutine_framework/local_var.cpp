@@ -3,8 +3,6 @@
 namespace ToE
 {
 
-std::atomic<uint64_t> CoroLocalVar::ID = 0;
-
 CoroLocalVar::~CoroLocalVar() {
   if (response_info_) {
     delete response_info_;
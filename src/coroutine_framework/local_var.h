@@ -3,33 +3,35 @@
 #include <atomic>
 #include "coroutine_framework/net_module/net_define.h"
 #include "utils.h"
+#include "cancellation.h"
 
 namespace ToE
 {
 
 struct CommonExecuteModule;
+struct LinkedCoroutine;
 
 struct ResponseInfo {
-  ResponseInfo(const EndPoint &endpoint, uint64_t coro_id, uint16_t rpc_type)
+  // type-erased serializer of the root frame result, only instantiated for registered rpc functions
+  using ReplyFunc = void (*)(LinkedCoroutine *frame, const ResponseInfo &response_info);
+  ResponseInfo(const EndPoint &endpoint, uint64_t coro_id, uint16_t rpc_type, ReplyFunc reply)
   : response_to_end_point_{endpoint},
   response_to_coro_id_{coro_id},
-  response_rpc_type_{rpc_type} {}
+  response_rpc_type_{rpc_type},
+  reply_{reply} {}
   EndPoint response_to_end_point_;
   uint64_t response_to_coro_id_;
   uint16_t response_rpc_type_;
+  ReplyFunc reply_;
 };
 
 struct CoroLocalVar {
   CoroLocalVar(RefCount &ref_cnt)
-  : coro_id_{ID.fetch_add(1)},
-  wake_up_ts_{0},
-  response_info_{nullptr} {}
+  : response_info_{nullptr},
+  cancel_token_{} {}
   ~CoroLocalVar();
-  uint64_t coro_id_; // in-process uniq monotonic id
-  uint64_t wake_up_ts_; // for timer module
   ResponseInfo *response_info_;
-private:
-  static std::atomic<uint64_t> ID;
+  CancellationToken cancel_token_; // shared by the whole coroutine chain
 };
 
 }
\ No newline at end of file
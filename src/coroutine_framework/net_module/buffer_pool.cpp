@@ -0,0 +1,137 @@
+#include "buffer_pool.h"
+#include <algorithm>
+#include <bit>
+#include <new>
+
+namespace ToE
+{
+
+struct ThreadBufferCache {
+  ThreadBufferCache() : lists_{} {}
+  ~ThreadBufferCache();
+  static uint64_t limit(const uint32_t size_class) noexcept {
+    return std::max(BufferPool::THREAD_CACHE_BYTES / BufferPool::block_size(size_class),
+                    BufferPool::MIN_THREAD_CACHE_BLOCKS);
+  }
+  std::array<BufferPool::FreeList, BufferPool::SIZE_CLASS_NUM> lists_;
+};
+
+thread_local bool TLS_BUFFER_CACHE_DESTROYED = false; // buffers released during thread exit go to global lists
+thread_local ThreadBufferCache TLS_BUFFER_CACHE;
+
+ThreadBufferCache::~ThreadBufferCache() {
+  TLS_BUFFER_CACHE_DESTROYED = true;
+  for (uint32_t size_class = 0; size_class < BufferPool::SIZE_CLASS_NUM; size_class++) {
+    BufferPool::instance().push_global_(size_class, lists_[size_class], lists_[size_class].size_);
+  }
+}
+
+BufferPool &BufferPool::instance() noexcept {
+  static BufferPool *pool = new BufferPool{};
+  return *pool;
+}
+
+uint32_t BufferPool::size_class(const uint64_t size) noexcept {
+  if (size > MAX_BLOCK_SIZE) [[unlikely]] {
+    return BufferBlock::UNPOOLED;
+  }
+  if (size <= MIN_BLOCK_SIZE) {
+    return 0;
+  }
+  return static_cast<uint32_t>(std::bit_width(size - 1) - std::countr_zero(MIN_BLOCK_SIZE));
+}
+
+BufferBlock *BufferPool::allocate(const uint64_t size) {
+  const uint32_t size_class = BufferPool::size_class(size);
+  if (size_class == BufferBlock::UNPOOLED) [[unlikely]] {
+    return new_block_(size_class, size);
+  }
+  BufferBlock *block = nullptr;
+  if (!TLS_BUFFER_CACHE_DESTROYED) [[likely]] {
+    FreeList &list = TLS_BUFFER_CACHE.lists_[size_class];
+    if (list.head_ == nullptr) {
+      pop_global_(size_class, list, ThreadBufferCache::limit(size_class) / 2);
+    }
+    block = list.head_;
+    if (block) [[likely]] {
+      list.head_ = block->next_;
+      list.size_--;
+    }
+  }
+  if (block == nullptr) [[unlikely]] {
+    return new_block_(size_class, block_size(size_class));
+  }
+  block->ref_cnt_.store(1, std::memory_order_relaxed);
+  return block;
+}
+
+void BufferPool::release(BufferBlock *block) noexcept {
+  const uint32_t size_class = block->size_class_;
+  if (size_class == BufferBlock::UNPOOLED) [[unlikely]] {
+    block->~BufferBlock();
+    ::operator delete(block);
+    return;
+  }
+  if (TLS_BUFFER_CACHE_DESTROYED) [[unlikely]] {
+    block->next_ = nullptr;
+    FreeList list{block, 1};
+    push_global_(size_class, list, 1);
+    return;
+  }
+  FreeList &list = TLS_BUFFER_CACHE.lists_[size_class];
+  block->next_ = list.head_;
+  list.head_ = block;
+  list.size_++;
+  const uint64_t limit = ThreadBufferCache::limit(size_class);
+  if (list.size_ > limit) [[unlikely]] { // keep half, so next few allocations and releases stay local
+    push_global_(size_class, list, list.size_ - limit / 2);
+  }
+}
+
+BufferBlock *BufferPool::new_block_(const uint32_t size_class, const uint64_t size) {
+  void *memory = ::operator new(sizeof(BufferBlock) + size);
+  BufferBlock *block = new (memory) BufferBlock{{1}, size_class, nullptr};
+  if (size_class != BufferBlock::UNPOOLED) {
+    allocated_blocks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return block;
+}
+
+void BufferPool::push_global_(const uint32_t size_class, FreeList &list, const uint64_t count) noexcept {
+  if (count == 0) {
+    return;
+  }
+  BufferBlock *first = list.head_;
+  BufferBlock *last = first;
+  for (uint64_t idx = 1; idx < count; idx++) {
+    last = last->next_;
+  }
+  list.head_ = last->next_;
+  list.size_ -= count;
+  GlobalList &global = global_lists_[size_class];
+  std::lock_guard<std::mutex> lg(global.lock_);
+  last->next_ = global.list_.head_;
+  global.list_.head_ = first;
+  global.list_.size_ += count;
+}
+
+void BufferPool::pop_global_(const uint32_t size_class, FreeList &list, const uint64_t count) noexcept {
+  GlobalList &global = global_lists_[size_class];
+  std::lock_guard<std::mutex> lg(global.lock_);
+  const uint64_t taken = std::min(count, global.list_.size_);
+  if (taken == 0) {
+    return;
+  }
+  BufferBlock *first = global.list_.head_;
+  BufferBlock *last = first;
+  for (uint64_t idx = 1; idx < taken; idx++) {
+    last = last->next_;
+  }
+  global.list_.head_ = last->next_;
+  global.list_.size_ -= taken;
+  last->next_ = list.head_;
+  list.head_ = first;
+  list.size_ += taken;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "literal.h"
+
+namespace ToE
+{
+
+struct BufferBlock { // placed right before data of every pooled buffer
+  static constexpr uint32_t UNPOOLED = UINT32_MAX; // larger than max size class, freed at once
+  std::byte *data() noexcept { return reinterpret_cast<std::byte *>(this + 1); }
+  std::atomic<uint32_t> ref_cnt_; // slices alive
+  uint32_t size_class_;
+  BufferBlock *next_; // in free list
+};
+
+/**
+ * @brief BufferPool recycles memory of NetBuffer in power-of-two size classes.
+ * 1. each thread keeps a small free list per size class, allocate and release hit it without lock in steady state.
+ * 2. overflowing thread cache moves half of it to the global list of that class, empty one refills from there,
+ *    so blocks released by workers flow back to io threads which allocate them, malloc only happens below peak usage.
+ * 3. memory is never returned to system, blocks larger than MAX_BLOCK_SIZE are not pooled.
+ */
+struct BufferPool {
+  static constexpr uint64_t MIN_BLOCK_SIZE = 64_B;
+  static constexpr uint64_t MAX_BLOCK_SIZE = 1_MiB;
+  static constexpr uint32_t SIZE_CLASS_NUM = 15; // 64B .. 1MiB
+  static constexpr uint64_t THREAD_CACHE_BYTES = 256_KiB; // per class, at least MIN_THREAD_CACHE_BLOCKS blocks
+  static constexpr uint64_t MIN_THREAD_CACHE_BLOCKS = 2;
+  static_assert(MIN_BLOCK_SIZE << (SIZE_CLASS_NUM - 1) == MAX_BLOCK_SIZE);
+  static BufferPool &instance() noexcept; // never destroyed, buffers may be released during static destruction
+  static uint64_t block_size(const uint32_t size_class) noexcept { return MIN_BLOCK_SIZE << size_class; }
+  static uint32_t size_class(const uint64_t size) noexcept; // smallest class holds size, UNPOOLED if none
+  BufferBlock *allocate(const uint64_t size); // ref_cnt_ is 1, data() holds at least size bytes
+  void release(BufferBlock *block) noexcept; // by last reference
+  uint64_t allocated_blocks() const noexcept { return allocated_blocks_.load(std::memory_order_relaxed); }
+private:
+  struct FreeList {
+    BufferBlock *head_ = nullptr;
+    uint64_t size_ = 0;
+  };
+  struct GlobalList {
+    std::mutex lock_;
+    FreeList list_;
+  };
+  friend struct ThreadBufferCache;
+  BufferPool() = default;
+  BufferBlock *new_block_(const uint32_t size_class, const uint64_t size);
+  void push_global_(const uint32_t size_class, FreeList &list, const uint64_t count) noexcept;
+  void pop_global_(const uint32_t size_class, FreeList &list, const uint64_t count) noexcept;
+  std::array<GlobalList, SIZE_CLASS_NUM> global_lists_;
+  std::atomic<uint64_t> allocated_blocks_{0}; // from system, pooled ones only
+};
+
+}
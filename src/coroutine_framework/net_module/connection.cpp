@@ -0,0 +1,161 @@
+#include "connection.h"
+#include <algorithm>
+#include <vector>
+#include "net_service.h"
+#include "rpc_struct.h"
+#include "log/logger.h"
+
+using namespace boost;
+using namespace boost::asio;
+using namespace boost::asio::ip;
+
+namespace ToE
+{
+
+Connection::Connection(NetService *service, const uint32_t shard, io_context &io_ctx, const EndPoint &peer)
+: service_{service},
+shard_{shard},
+peer_{peer},
+remote_{peer.to_asio_endpoint()},
+socket_{io_ctx},
+writer_{},
+reader_{service->max_message_size(), service->reassembly_budget()},
+state_{State::IDLE},
+accepted_{false},
+writing_{false},
+epoch_{0},
+backoff_ns_{0},
+next_connect_ts_{} {}
+
+Connection::Connection(NetService *service, const uint32_t shard, tcp::socket &&socket)
+: service_{service},
+shard_{shard},
+peer_{},
+remote_{socket.remote_endpoint()},
+socket_{std::move(socket)},
+writer_{},
+reader_{service->max_message_size(), service->reassembly_budget()},
+state_{State::CONNECTED},
+accepted_{true},
+writing_{false},
+epoch_{0},
+backoff_ns_{0},
+next_connect_ts_{} {
+  socket_.set_option(tcp::no_delay{true});
+}
+
+Connection::~Connection() {
+  boost::system::error_code ec;
+  socket_.close(ec);
+}
+
+void Connection::send(OutgoingFrame &&frame) {
+  if (state_ == State::CONNECTED) [[likely]] {
+    writer_.push(std::move(frame));
+    start_writing_();
+  } else if (state_ == State::CONNECTING) {
+    writer_.push(std::move(frame)); // written once connected
+  } else if (state_ == State::IDLE && std::chrono::steady_clock::now() >= next_connect_ts_) {
+    writer_.push(std::move(frame));
+    state_ = State::CONNECTING;
+    co_spawn(socket_.get_executor(), connect_(shared_from_this()), detached);
+  } else { // backing off or closed, caller times out
+    DEBUG_LOG("drop message to:{}, state:{}", peer_, static_cast<uint8_t>(state_));
+  }
+}
+
+void Connection::start_reading() {
+  co_spawn(socket_.get_executor(), read_loop_(shared_from_this(), epoch_), detached);
+}
+
+awaitable<void> Connection::connect_(std::shared_ptr<Connection> self) {
+  steady_timer deadline{socket_.get_executor(), std::chrono::nanoseconds(service_->connect_timeout_ns())};
+  deadline.async_wait([this, self, epoch = epoch_](const boost::system::error_code &ec) {
+    if (!ec && epoch == epoch_ && state_ == State::CONNECTING) { // connect is aborted and backs off below
+      boost::system::error_code close_ec;
+      socket_.close(close_ec);
+    }
+  });
+  try {
+    co_await socket_.async_connect(remote_, use_awaitable); // socket is opened by connect
+    deadline.cancel();
+    socket_.set_option(tcp::no_delay{true});
+    state_ = State::CONNECTED;
+    backoff_ns_ = 0;
+    service_->connect_cnt_.fetch_add(1, std::memory_order_relaxed);
+    co_spawn(socket_.get_executor(), read_loop_(shared_from_this(), epoch_), detached);
+    start_writing_();
+  } catch (const std::exception &e) {
+    backoff_ns_ = std::clamp(backoff_ns_ * 2, MIN_BACKOFF, MAX_BACKOFF);
+    next_connect_ts_ = std::chrono::steady_clock::now() + std::chrono::nanoseconds(backoff_ns_);
+    DEBUG_LOG("connect to:{} failed:{}, back off {}ns", peer_, e.what(), backoff_ns_);
+    on_broken_(epoch_);
+  }
+}
+
+void Connection::start_writing_() {
+  if (!writing_ && !writer_.empty()) {
+    writing_ = true;
+    co_spawn(socket_.get_executor(), write_loop_(shared_from_this(), epoch_), detached);
+  }
+}
+
+awaitable<void> Connection::write_loop_(std::shared_ptr<Connection> self, const uint64_t epoch) {
+  std::vector<const_buffer> buffers;
+  try {
+    while (!writer_.empty() && epoch == epoch_) {
+      writer_.prepare(buffers);
+      if (!buffers.empty()) [[likely]] {
+        co_await async_write(socket_, buffers, use_awaitable);
+      }
+      if (epoch == epoch_) [[likely]] {
+        writer_.commit();
+      }
+    }
+  } catch (const std::exception &e) {
+    DEBUG_LOG("write to:{} failed:{}", peer_, e.what());
+    on_broken_(epoch);
+  }
+  if (epoch == epoch_) {
+    writing_ = false;
+  }
+}
+
+awaitable<void> Connection::read_loop_(std::shared_ptr<Connection> self, const uint64_t epoch) {
+  try {
+    while (epoch == epoch_) {
+      const std::size_t len = co_await socket_.async_read_some(buffer(reader_.tail(), reader_.space()), use_awaitable);
+      if (epoch != epoch_) [[unlikely]] { // completed before socket was closed, reader belongs to new socket
+        break;
+      }
+      reader_.produce(len);
+      reader_.parse([this, &self](const PackageHeader &header, NetBuffer &&payload) {
+        service_->dispatch(self, header, std::move(payload));
+      });
+    }
+  } catch (const std::exception &e) {
+    DEBUG_LOG("read from:{} failed:{}", peer_, e.what());
+    on_broken_(epoch);
+  }
+}
+
+void Connection::on_broken_(const uint64_t epoch) noexcept {
+  if (epoch == epoch_ && state_ != State::CLOSED) {
+    boost::system::error_code ec;
+    socket_.close(ec);
+    epoch_++;
+    writing_ = false;
+    writer_.clear(); // unsent requests time out at caller
+    reader_.clear();
+    if (accepted_) {
+      state_ = State::CLOSED;
+      if (peer_.is_valid()) {
+        service_->remove_connection(shared_from_this());
+      }
+    } else {
+      state_ = State::IDLE;
+    }
+  }
+}
+
+}
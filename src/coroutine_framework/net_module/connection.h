@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <boost/asio.hpp>
+#include "literal.h"
+#include "net_define.h"
+#include "frame_codec.h"
+#include "rpc_struct.h"
+
+namespace ToE
+{
+
+struct NetService;
+
+/**
+ * @brief Connection is a long-lived bidirectional tcp connection to one peer, only touched by it's own io thread.
+ * 1. outgoing connection connects lazily on first send, messages queued meanwhile are written in order by one writer.
+ * 2. both sides read messages in a loop and may send through it, a request and it's response share one connection.
+ * 3. broken outgoing connection reconnects on next send, connect failure drops queued messages(callers time out)
+ *    and backs off exponentially, sends during back off are dropped at once. connect not finished within
+ *    NetConfig::connect_timeout_ns_ counts as failure.
+ * 4. accepted connection has no peer until first message tells caller's listen port, it's closed for good when broken.
+ * 5. frames of any rpc are pipelined in both directions and correlated by rpc_id_, see FrameReader/FrameWriter.
+ * 6. writer starts by post, so frames queued in the same io loop iteration(e.g. responses of many handlers) are
+ *    gathered into one sendmsg.
+ */
+struct Connection : public std::enable_shared_from_this<Connection> {
+  enum class State : uint8_t {
+    IDLE = 0, // not connected, connect on next send
+    CONNECTING = 1,
+    CONNECTED = 2,
+    CLOSED = 3, // accepted connection broken, removed from pool
+  };
+  static constexpr uint64_t MIN_BACKOFF = 10_ms;
+  static constexpr uint64_t MAX_BACKOFF = 5_s;
+  Connection(NetService *service, const uint32_t shard, boost::asio::io_context &io_ctx, const EndPoint &peer); // outgoing
+  Connection(NetService *service, const uint32_t shard, boost::asio::ip::tcp::socket &&socket); // accepted
+  Connection(const Connection &) = delete;
+  Connection &operator=(const Connection &) = delete;
+  ~Connection();
+  void send(OutgoingFrame &&frame);
+  void start_reading(); // accepted connection only, outgoing one starts reading when connected
+  bool accepted() const noexcept { return accepted_; }
+  uint32_t shard() const noexcept { return shard_; } // io thread the socket belongs to
+  const EndPoint &peer() const noexcept { return peer_; }
+  void set_peer(const EndPoint &peer) noexcept { peer_ = peer; } // learned from first message of accepted connection
+  const ASIO_EndPoint &remote() const noexcept { return remote_; }
+  State state() const noexcept { return state_; }
+private:
+  // self keeps connection alive while coroutine is pending, coroutine body starts after co_spawn returns
+  boost::asio::awaitable<void> connect_(std::shared_ptr<Connection> self);
+  boost::asio::awaitable<void> write_loop_(std::shared_ptr<Connection> self, const uint64_t epoch);
+  boost::asio::awaitable<void> read_loop_(std::shared_ptr<Connection> self, const uint64_t epoch);
+  void start_writing_();
+  void on_broken_(const uint64_t epoch) noexcept; // ignored if socket has been replaced since epoch
+  NetService *service_;
+  const uint32_t shard_;
+  EndPoint peer_; // peer's listen endpoint, key in pool
+  ASIO_EndPoint remote_; // cached, never formatted per send
+  boost::asio::ip::tcp::socket socket_;
+  FrameWriter writer_;
+  FrameReader reader_;
+  State state_;
+  bool accepted_;
+  bool writing_;
+  uint64_t epoch_; // bumped when socket is closed, stale read/write loops exit quietly
+  uint64_t backoff_ns_;
+  std::chrono::steady_clock::time_point next_connect_ts_;
+};
+
+}
@@ -0,0 +1,141 @@
+#include "frame_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include "mechanism/serialization.hpp"
+
+namespace ToE
+{
+
+template <typename Members>
+struct FundamentalMembersSize;
+
+template <typename ...Members>
+struct FundamentalMembersSize<std::tuple<Members...>> {
+  static constexpr bool ALL_FUNDAMENTAL = (std::is_fundamental_v<std::remove_cvref_t<Members>> && ...);
+  static constexpr uint64_t VALUE = (sizeof(std::remove_cvref_t<Members>) + ...);
+};
+
+// serializer writes every fundamental member at its sizeof, so reflected fields must add up to header size
+using HeaderLayout = FundamentalMembersSize<REFLECT<PackageHeader>::MemberType>;
+static_assert(HeaderLayout::ALL_FUNDAMENTAL, "PackageHeader must only reflect fundamental members");
+static_assert(HeaderLayout::VALUE == PackageHeader::SERIALIZE_SIZE, "PackageHeader::SERIALIZE_SIZE mismatch reflected fields");
+
+OutgoingFrame::OutgoingFrame(const PackageHeader &header, NetBuffer &&payload)
+: header_{},
+payload_{std::move(payload)},
+streamed_{0} {
+  int64_t pos = 0;
+  Serializer<PackageHeader>::serialize(header, header_.data(), header_.size(), pos);
+  assert(pos == header_.size());
+  assert(header.payload_len_ == payload_.buffer_len_);
+}
+
+FrameWriter::FrameWriter()
+: queue_{},
+write_buffer_{WRITE_BUFFER_SIZE},
+payloads_{},
+frame_cnt_{0},
+active_streams_{0} {}
+
+void FrameWriter::commit() noexcept {
+  for (std::size_t idx = 0; idx < frame_cnt_; idx++) { // unfinished chunked messages go round robin
+    if (queue_[idx].streamed_ < queue_[idx].payload_.buffer_len_ && queue_[idx].payload_.buffer_len_ > MAX_FRAME_PAYLOAD) {
+      OutgoingFrame frame = std::move(queue_[idx]);
+      queue_.push_back(std::move(frame));
+    }
+  }
+  queue_.erase(queue_.begin(), queue_.begin() + frame_cnt_);
+  frame_cnt_ = 0;
+}
+
+void FrameWriter::clear() noexcept {
+  queue_.clear(); // payloads_ may still be written by the broken socket, released on next prepare()
+  frame_cnt_ = 0;
+  active_streams_ = 0;
+}
+
+FrameReader::FrameReader(const uint64_t max_message_size, const uint64_t reassembly_budget)
+: read_buffer_{READ_BUFFER_SIZE},
+begin_{0},
+end_{0},
+streams_{},
+max_message_size_{max_message_size},
+reassembly_budget_{reassembly_budget},
+reserved_bytes_{0},
+header_{} {}
+
+bool FrameReader::receive_chunk_(PackageHeader &header, std::byte *payload, NetBuffer &message) {
+  auto iter = std::find_if(streams_.begin(), streams_.end(), [&header](const IncomingStream &stream) {
+    return stream.rpc_id_ == header.rpc_id_ && stream.message_type_ == header.get_message_type();
+  });
+  uint64_t len = header.payload_len_;
+  if (header.flags_ & PackageHeader::FLAG_FIRST_CHUNK) {
+    uint64_t message_len = 0;
+    int64_t pos = 0;
+    if (iter != streams_.end() || streams_.size() == FrameWriter::MAX_STREAMS || len < sizeof(uint64_t)) [[unlikely]] {
+      throw std::runtime_error("unexpected first chunk");
+    }
+    Serializer<uint64_t>::deserialize(message_len, payload, len, pos);
+    if (message_len > max_message_size_) [[unlikely]] {
+      throw std::runtime_error("message too large");
+    }
+    if (reserved_bytes_ + message_len > reassembly_budget_) [[unlikely]] {
+      throw std::runtime_error("reassembly budget exceeded");
+    }
+    reserved_bytes_ += message_len;
+    iter = streams_.insert(streams_.end(), IncomingStream{header.rpc_id_, header.get_message_type(), message_len, 0, {}});
+    payload += pos;
+    len -= pos;
+  } else if (iter == streams_.end()) [[unlikely]] {
+    throw std::runtime_error("chunk of unknown message");
+  }
+  if (iter->received_ + len > iter->message_len_) [[unlikely]] {
+    throw std::runtime_error("chunk exceeds message");
+  }
+  if (len != 0) { // memory follows bytes really received, not declared length
+    NetBuffer chunk{len};
+    memcpy(chunk.buffer_, payload, len);
+    iter->chunks_.push_back(std::move(chunk));
+    iter->received_ += len;
+  }
+  if (iter->received_ < iter->message_len_) {
+    return false;
+  }
+  message = NetBuffer{iter->message_len_};
+  uint64_t offset = 0;
+  for (auto &chunk : iter->chunks_) {
+    memcpy(message.buffer_ + offset, chunk.buffer_, chunk.buffer_len_);
+    offset += chunk.buffer_len_;
+  }
+  reserved_bytes_ -= iter->message_len_;
+  streams_.erase(iter);
+  header.flags_ &= ~(PackageHeader::FLAG_CHUNK | PackageHeader::FLAG_FIRST_CHUNK);
+  header.payload_len_ = message.buffer_len_;
+  return true;
+}
+
+void FrameReader::compact_() {
+  if (!read_buffer_.unique()) [[unlikely]] { // dispatched slice is kept by someone, leave block to it
+    NetBuffer fresh_buffer{read_buffer_.buffer_len_};
+    memcpy(fresh_buffer.buffer_, read_buffer_.buffer_ + begin_, end_ - begin_);
+    read_buffer_ = std::move(fresh_buffer);
+    end_ -= begin_;
+    begin_ = 0;
+  } else if (begin_ != 0) { // keep partial frame at head, so it always fits
+    memmove(read_buffer_.buffer_, read_buffer_.buffer_ + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+}
+
+void FrameReader::clear() noexcept {
+  begin_ = 0;
+  end_ = 0;
+  streams_.clear();
+  reserved_bytes_ = 0;
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "literal.h"
+#include "net_define.h"
+#include "rpc_struct.h"
+
+namespace ToE
+{
+
+// one message waiting to be written, header is serialized inline and payload stays in it's own buffer
+struct OutgoingFrame {
+  OutgoingFrame(const PackageHeader &header, NetBuffer &&payload);
+  OutgoingFrame share() const noexcept { return OutgoingFrame{header_, payload_.share()}; }
+  std::array<std::byte, PackageHeader::SERIALIZE_SIZE> header_;
+  NetBuffer payload_; // may be shared by all peers of one rpc
+  uint64_t streamed_; // payload bytes written as chunks, see FrameWriter::MAX_FRAME_PAYLOAD
+private:
+  OutgoingFrame(const std::array<std::byte, PackageHeader::SERIALIZE_SIZE> &header, NetBuffer &&payload)
+  : header_{header}, payload_{std::move(payload)}, streamed_{0} {}
+};
+
+/**
+ * @brief FrameWriter turns frames queued on one connection into gathered writes, independent of net backend.
+ * 1. a batch takes frames queued so far, headers and small payloads are copied back to back into a write buffer,
+ *    larger payloads are written from their own buffers in place.
+ * 2. message larger than MAX_FRAME_PAYLOAD is written as chunks in place, one chunk per batch and round robin with
+ *    other frames, so small messages are not stuck behind it, at most MAX_STREAMS messages are chunked at the same
+ *    time, which bounds memory receiver spends on reassembling.
+ * 3. only one batch is in flight, buffers of it stay valid until next prepare() even if writer is cleared.
+ */
+struct FrameWriter {
+  static constexpr uint64_t WRITE_BUFFER_SIZE = 64_KiB;
+  static constexpr uint64_t COPY_PAYLOAD_LIMIT = 1_KiB; // larger payload is not copied into write buffer
+  static constexpr std::size_t MAX_GATHER_BUFFERS = 64; // asio passes at most 64 iovecs to one sendmsg
+  static constexpr uint64_t MAX_FRAME_PAYLOAD = 32_KiB; // larger payload is chunked
+  static constexpr std::size_t MAX_STREAMS = 4; // messages being chunked at the same time in one direction
+  FrameWriter();
+  FrameWriter(const FrameWriter &) = delete;
+  FrameWriter &operator=(const FrameWriter &) = delete;
+  void push(OutgoingFrame &&frame) { queue_.push_back(std::move(frame)); }
+  bool empty() const noexcept { return queue_.empty(); }
+  // stage next batch into buffers, Buffer is constructible from {pointer, length}(asio buffer, iovec)
+  template <typename Buffer>
+  void prepare(std::vector<Buffer> &buffers);
+  void commit() noexcept; // whole prepared batch has been written
+  void clear() noexcept; // connection broken, queued frames are dropped(callers time out)
+private:
+  bool stage_chunk_(OutgoingFrame &frame, uint64_t &staged, uint64_t &segment, auto &buffers);
+  std::deque<OutgoingFrame> queue_;
+  NetBuffer write_buffer_;
+  std::vector<NetBuffer> payloads_; // of prepared batch, written in place
+  std::size_t frame_cnt_; // frames of prepared batch at queue head
+  std::size_t active_streams_; // messages partly written
+};
+
+/**
+ * @brief FrameReader parses frames read from one connection into whole messages, independent of net backend.
+ * 1. bytes are read into a read-ahead buffer, back-to-back frames are parsed from it, every frame fits in it.
+ * 2. whole message in one frame is handed out as a slice of read buffer, nothing copied,
+ *    read buffer is replaced if any slice outlives parse().
+ * 3. chunks are copied into pooled chunk sized buffers as they arrive, and joined once message is complete,
+ *    at most FrameWriter::MAX_STREAMS messages at the same time.
+ * 4. limits are set by receiver: message longer than max_message_size is refused, and partly received messages of
+ *    one connection may not declare more than reassembly_budget bytes in total, checked on their first chunk.
+ * 5. peer breaking these rules fails parse() with exception, connection should be closed.
+ */
+struct FrameReader {
+  static constexpr uint64_t READ_BUFFER_SIZE = 64_KiB;
+  FrameReader(const uint64_t max_message_size, const uint64_t reassembly_budget);
+  FrameReader(const FrameReader &) = delete;
+  FrameReader &operator=(const FrameReader &) = delete;
+  std::byte *tail() noexcept { return read_buffer_.buffer_ + end_; } // read more bytes here
+  uint64_t space() const noexcept { return read_buffer_.buffer_len_ - end_; } // never 0 after parse()
+  void produce(const uint64_t len) noexcept { end_ += len; }
+  // call on_message(header, NetBuffer &&payload) for each whole message read so far
+  template <typename OnMessage>
+  void parse(OnMessage &&on_message);
+  template <typename OnMessage>
+  void append(const std::byte *data, uint64_t len, OnMessage &&on_message); // for bytes read elsewhere
+  void clear() noexcept; // connection broken, partial messages are dropped
+private:
+  struct IncomingStream { // chunked message being received
+    uint64_t rpc_id_;
+    PackageHeader::MessageType message_type_;
+    uint64_t message_len_; // declared by first chunk
+    uint64_t received_;
+    std::vector<NetBuffer> chunks_; // copied out of read buffer, every one is pooled
+  };
+  // copy one chunk out of read buffer, return true and set whole message if it's the last one
+  bool receive_chunk_(PackageHeader &header, std::byte *payload, NetBuffer &message);
+  void compact_(); // keep partial frame at head, so it always fits
+  NetBuffer read_buffer_;
+  uint64_t begin_; // first unparsed byte
+  uint64_t end_; // end of read bytes
+  std::vector<IncomingStream> streams_;
+  uint64_t max_message_size_;
+  uint64_t reassembly_budget_;
+  uint64_t reserved_bytes_; // declared length of messages in streams_
+  PackageHeader header_;
+};
+
+}
+
+#include "frame_codec.ipp"
@@ -0,0 +1,130 @@
+#pragma once
+#include "frame_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "mechanism/serialization.hpp"
+
+namespace ToE
+{
+
+template <typename Buffer>
+void FrameWriter::prepare(std::vector<Buffer> &buffers) {
+  buffers.clear();
+  payloads_.clear();
+  std::byte *data = write_buffer_.buffer_;
+  const uint64_t header_size = PackageHeader::SERIALIZE_SIZE;
+  uint64_t staged = 0; // bytes copied into write buffer
+  uint64_t segment = 0; // first staged byte not in buffers yet
+  for (frame_cnt_ = 0; frame_cnt_ < queue_.size(); frame_cnt_++) {
+    OutgoingFrame &frame = queue_[frame_cnt_];
+    const uint64_t payload_len = frame.payload_.buffer_len_;
+    if (payload_len > MAX_FRAME_PAYLOAD) [[unlikely]] { // one chunk per batch
+      if (frame.streamed_ == 0 && active_streams_ == MAX_STREAMS) {
+        continue; // moved to back, waits for a streaming message to finish
+      }
+      if (!stage_chunk_(frame, staged, segment, buffers)) {
+        break;
+      }
+      continue;
+    }
+    const bool copy_payload = payload_len <= COPY_PAYLOAD_LIMIT;
+    const uint64_t copy_len = header_size + (copy_payload ? payload_len : 0);
+    // first frame always fits, at most 2 buffers per frame plus the trailing segment
+    if (staged + copy_len > write_buffer_.buffer_len_ || buffers.size() + 3 > MAX_GATHER_BUFFERS) {
+      break;
+    }
+    memcpy(data + staged, frame.header_.data(), header_size);
+    staged += header_size;
+    if (copy_payload) {
+      if (payload_len != 0) {
+        memcpy(data + staged, frame.payload_.buffer_, payload_len);
+        staged += payload_len;
+      }
+    } else {
+      buffers.emplace_back(data + segment, staged - segment);
+      segment = staged;
+      buffers.emplace_back(frame.payload_.buffer_, payload_len);
+      payloads_.push_back(frame.payload_.share());
+    }
+  }
+  if (staged != segment) {
+    buffers.emplace_back(data + segment, staged - segment);
+  }
+}
+
+bool FrameWriter::stage_chunk_(OutgoingFrame &frame, uint64_t &staged, uint64_t &segment, auto &buffers) {
+  std::byte *data = write_buffer_.buffer_;
+  const uint64_t header_size = PackageHeader::SERIALIZE_SIZE;
+  const uint64_t payload_len = frame.payload_.buffer_len_;
+  const bool first = frame.streamed_ == 0;
+  const uint64_t chunk_len = std::min(MAX_FRAME_PAYLOAD, payload_len - frame.streamed_);
+  const uint64_t prefix_len = header_size + (first ? sizeof(uint64_t) : 0);
+  if (staged + prefix_len > write_buffer_.buffer_len_ || buffers.size() + 3 > MAX_GATHER_BUFFERS) {
+    return false;
+  }
+  PackageHeader header;
+  int64_t pos = 0;
+  Serializer<PackageHeader>::deserialize(header, frame.header_.data(), header_size, pos);
+  header.flags_ |= PackageHeader::FLAG_CHUNK | (first ? PackageHeader::FLAG_FIRST_CHUNK : 0);
+  header.payload_len_ = prefix_len - header_size + chunk_len;
+  pos = staged;
+  Serializer<PackageHeader>::serialize(header, data, write_buffer_.buffer_len_, pos);
+  if (first) {
+    Serializer<uint64_t>::serialize(payload_len, data, write_buffer_.buffer_len_, pos);
+    active_streams_++;
+  }
+  staged = pos;
+  buffers.emplace_back(data + segment, staged - segment);
+  segment = staged;
+  buffers.emplace_back(frame.payload_.buffer_ + frame.streamed_, chunk_len);
+  payloads_.push_back(frame.payload_.share());
+  frame.streamed_ += chunk_len;
+  if (frame.streamed_ == payload_len) {
+    active_streams_--;
+  }
+  return true;
+}
+
+template <typename OnMessage>
+void FrameReader::parse(OnMessage &&on_message) {
+  const uint64_t header_size = PackageHeader::SERIALIZE_SIZE;
+  while (end_ - begin_ >= header_size) { // parse back-to-back frames already read
+    int64_t pos = 0;
+    Serializer<PackageHeader>::deserialize(header_, read_buffer_.buffer_ + begin_, header_size, pos);
+    if (header_.checksum_ != PackageHeader::MAGIC_NUMBER ||
+        header_size + header_.payload_len_ > read_buffer_.buffer_len_) [[unlikely]] {
+      throw std::runtime_error("malformed frame"); // larger message is chunked by sender
+    }
+    if (end_ - begin_ < header_size + header_.payload_len_) {
+      break; // wait for rest of frame
+    }
+    std::byte *payload = read_buffer_.buffer_ + begin_ + header_size;
+    NetBuffer received_buffer;
+    if (header_.flags_ & PackageHeader::FLAG_CHUNK) [[unlikely]] {
+      begin_ += header_size + header_.payload_len_;
+      if (!receive_chunk_(header_, payload, received_buffer)) {
+        continue;
+      }
+    } else { // whole message in one frame, nothing copied
+      received_buffer = read_buffer_.slice(begin_ + header_size, header_.payload_len_);
+      begin_ += header_size + header_.payload_len_;
+    }
+    on_message(header_, std::move(received_buffer));
+  }
+  compact_();
+}
+
+template <typename OnMessage>
+void FrameReader::append(const std::byte *data, uint64_t len, OnMessage &&on_message) {
+  while (len != 0) {
+    const uint64_t copy_len = std::min(len, space());
+    memcpy(tail(), data, copy_len);
+    produce(copy_len);
+    parse(on_message);
+    data += copy_len;
+    len -= copy_len;
+  }
+}
+
+}
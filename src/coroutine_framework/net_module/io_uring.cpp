@@ -0,0 +1,326 @@
+#include "io_uring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ToE
+{
+
+namespace
+{
+
+int io_uring_setup(const uint32_t entries, io_uring_params *params) noexcept {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(const int fd,
+                   const uint32_t to_submit,
+                   const uint32_t wait_nr,
+                   const uint32_t flags,
+                   const void *arg,
+                   const std::size_t arg_size) noexcept {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, wait_nr, flags, arg, arg_size));
+}
+
+int io_uring_register(const int fd, const uint32_t opcode, void *arg, const uint32_t nr_args) noexcept {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+void *map_ring(const int fd, const std::size_t size, const uint64_t offset) {
+  void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+  if (addr == MAP_FAILED) [[unlikely]] {
+    throw std::system_error(errno, std::system_category(), "mmap io_uring");
+  }
+  return addr;
+}
+
+}
+
+IoUring::IoUring(const uint32_t entries, const bool sqpoll)
+: ring_fd_{-1},
+enter_fd_{-1},
+enter_flags_{0},
+sqpoll_{sqpoll},
+sq_ring_{nullptr},
+sq_ring_size_{0},
+cq_ring_{nullptr},
+cq_ring_size_{0},
+sqes_{nullptr} {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CLAMP | IORING_SETUP_CQSIZE;
+  params.cq_entries = entries * 4; // multishot recv and accept complete many times per sqe
+  if (sqpoll) {
+    params.flags |= IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = 1000; // ms, kernel thread sleeps after idle that long
+  } else { // completions are run when io thread enters kernel, no interrupt per completion
+    params.flags |= IORING_SETUP_COOP_TASKRUN;
+  }
+  ring_fd_ = io_uring_setup(entries, &params);
+  if (ring_fd_ < 0) [[unlikely]] {
+    throw std::system_error(errno, std::system_category(), "io_uring_setup");
+  }
+  sq_entries_ = params.sq_entries;
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  try {
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+      sq_ring_ = cq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+    } else {
+      sq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+      cq_ring_ = map_ring(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+    }
+    sqes_ = static_cast<io_uring_sqe *>(map_ring(ring_fd_, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+  } catch (...) {
+    release_();
+    throw;
+  }
+  std::byte *sq = static_cast<std::byte *>(sq_ring_);
+  std::byte *cq = static_cast<std::byte *>(cq_ring_);
+  sq_head_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+  sq_flags_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.flags);
+  sq_mask_ = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+  sqe_tail_ = *sq_tail_;
+  uint32_t *sq_array = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+  for (uint32_t idx = 0; idx < sq_entries_; idx++) { // sqe at slot i is always sqes_[i]
+    sq_array[idx] = idx;
+  }
+  cq_head_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  enter_fd_ = ring_fd_;
+}
+
+IoUring::~IoUring() {
+  release_();
+}
+
+void IoUring::release_() noexcept {
+  if (sqes_) {
+    ::munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    ::close(ring_fd_);
+  }
+}
+
+void IoUring::register_ring_fd() noexcept {
+  io_uring_rsrc_update update{UINT32_MAX, 0, static_cast<uint64_t>(ring_fd_)}; // any free index
+  if (io_uring_register(ring_fd_, IORING_REGISTER_RING_FDS, &update, 1) == 1) [[likely]] {
+    enter_fd_ = static_cast<int>(update.offset);
+    enter_flags_ = IORING_ENTER_REGISTERED_RING;
+  }
+}
+
+void IoUring::reserve(const uint32_t sqe_num) {
+  while (sqe_tail_ - std::atomic_ref<uint32_t>{*sq_head_}.load(std::memory_order_acquire) + sqe_num > sq_entries_) [[unlikely]] {
+    submit_and_wait(0);
+  }
+}
+
+io_uring_sqe *IoUring::get_sqe() {
+  while (sqe_tail_ - std::atomic_ref<uint32_t>{*sq_head_}.load(std::memory_order_acquire) >= sq_entries_) [[unlikely]] {
+    submit_and_wait(0); // full, kernel consumes what has been queued so far
+  }
+  io_uring_sqe *sqe = &sqes_[sqe_tail_ & sq_mask_];
+  sqe_tail_++;
+  memset(sqe, 0, sizeof(io_uring_sqe));
+  return sqe;
+}
+
+void IoUring::submit_and_wait(const uint32_t wait_nr, const uint64_t timeout_ns) {
+  const uint32_t to_submit = flush_();
+  uint32_t flags = 0;
+  if (sqpoll_) {
+    std::atomic_thread_fence(std::memory_order_seq_cst); // tail store is seen before need-wakeup flag is read
+    const uint32_t sq_flags = std::atomic_ref<uint32_t>{*sq_flags_}.load(std::memory_order_relaxed);
+    if (sq_flags & IORING_SQ_NEED_WAKEUP) {
+      flags |= IORING_ENTER_SQ_WAKEUP;
+    } else if (to_submit == sq_entries_) { // kernel thread is busy, wait until it makes room
+      flags |= IORING_ENTER_SQ_WAIT;
+    }
+    if (sq_flags & IORING_SQ_CQ_OVERFLOW) { // flush overflowed completions to cq ring
+      flags |= IORING_ENTER_GETEVENTS;
+    }
+  }
+  if (wait_nr != 0) {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+  if (sqpoll_ ? flags == 0 : to_submit == 0 && wait_nr == 0) {
+    return; // kernel thread takes submissions by itself
+  }
+  if (enter_(sqpoll_ ? 0 : to_submit, wait_nr, flags, timeout_ns) < 0 &&
+      errno != EINTR && errno != EBUSY && errno != EAGAIN && errno != ETIME) [[unlikely]] {
+    throw std::system_error(errno, std::system_category(), "io_uring_enter");
+  }
+}
+
+void IoUring::submit_all() {
+  submit_and_wait(0);
+  while (std::atomic_ref<uint32_t>{*sq_head_}.load(std::memory_order_acquire) != sqe_tail_) [[unlikely]] {
+    std::this_thread::yield(); // kernel thread is picking them up
+    submit_and_wait(0);
+  }
+}
+
+uint32_t IoUring::flush_() noexcept {
+  std::atomic_ref<uint32_t>{*sq_tail_}.store(sqe_tail_, std::memory_order_release);
+  return sqe_tail_ - std::atomic_ref<uint32_t>{*sq_head_}.load(std::memory_order_acquire);
+}
+
+int IoUring::enter_(const uint32_t to_submit, const uint32_t wait_nr, uint32_t flags, const uint64_t timeout_ns) noexcept {
+  if (wait_nr == 0 || timeout_ns == UINT64_MAX) [[likely]] {
+    return io_uring_enter(enter_fd_, to_submit, wait_nr, flags | enter_flags_, nullptr, 0);
+  }
+  io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  __kernel_timespec timeout{static_cast<int64_t>(timeout_ns / 1'000'000'000),
+                            static_cast<long long>(timeout_ns % 1'000'000'000)};
+  arg.ts = reinterpret_cast<uint64_t>(&timeout);
+  return io_uring_enter(enter_fd_, to_submit, wait_nr, flags | enter_flags_ | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+ProvidedBufferRing::ProvidedBufferRing(IoUring &ring,
+                                       const uint16_t group_id,
+                                       const uint32_t buffer_num,
+                                       const uint32_t buffer_size)
+: ring_{ring},
+group_id_{group_id},
+buffer_num_{buffer_num},
+buffer_size_{buffer_size},
+buf_ring_{nullptr},
+buf_ring_size_{buffer_num * sizeof(io_uring_buf)},
+buffers_{nullptr},
+tail_{0},
+legacy_{false} {
+  if (buffer_num == 0 || buffer_num > 32768 || (buffer_num & (buffer_num - 1)) != 0) [[unlikely]] {
+    throw std::system_error(EINVAL, std::system_category(), "provided buffer number must be power of 2 up to 32768");
+  }
+  buffers_ = static_cast<std::byte *>(::operator new(static_cast<std::size_t>(buffer_num) * buffer_size));
+  void *addr = ::mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // page aligned
+  if (addr == MAP_FAILED) [[unlikely]] {
+    const int error = errno;
+    ::operator delete(buffers_);
+    throw std::system_error(error, std::system_category(), "mmap buffer ring");
+  }
+  buf_ring_ = static_cast<io_uring_buf_ring *>(addr);
+  io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+  reg.ring_entries = buffer_num;
+  reg.bgid = group_id;
+  const bool registered = io_uring_register(ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+  if (registered) [[likely]] {
+    for (uint32_t buffer_id = 0; buffer_id < buffer_num; buffer_id++) {
+      recycle(static_cast<uint16_t>(buffer_id));
+    }
+  }
+  try {
+    if (!registered || !probe_()) [[unlikely]] {
+      if (registered) {
+        memset(&reg, 0, sizeof(reg));
+        reg.bgid = group_id;
+        io_uring_register(ring.fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+      }
+      ::munmap(buf_ring_, buf_ring_size_);
+      buf_ring_ = nullptr;
+      legacy_ = true;
+      provide_(0, buffer_num)->flags = 0; // wait for it, all buffers are refused if it fails
+      ring.submit_and_wait(1);
+      int res = 0;
+      ring.for_each_cqe([&res](const io_uring_cqe &cqe) { res = cqe.res; });
+      if (res < 0) [[unlikely]] {
+        throw std::system_error(-res, std::system_category(), "provide buffers");
+      }
+    }
+  } catch (...) {
+    if (buf_ring_) {
+      ::munmap(buf_ring_, buf_ring_size_);
+    }
+    ::operator delete(buffers_);
+    throw;
+  }
+}
+
+ProvidedBufferRing::~ProvidedBufferRing() {
+  if (buf_ring_) {
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = group_id_;
+    io_uring_register(ring_.fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    ::munmap(buf_ring_, buf_ring_size_);
+  }
+  ::operator delete(buffers_); // legacy buffers left in kernel are only forgotten, nothing is written to them
+}
+
+void ProvidedBufferRing::recycle(const uint16_t buffer_id) {
+  if (legacy_) [[unlikely]] {
+    provide_(buffer_id, 1);
+    return;
+  }
+  // ring is an array of io_uring_buf from it's head, bufs member is not used: in older uapi headers it's flex array
+  // follows an empty struct, which takes 1 byte in C++, so bufs is 8 bytes off the layout kernel reads
+  io_uring_buf &buf = reinterpret_cast<io_uring_buf *>(buf_ring_)[tail_ & (buffer_num_ - 1)];
+  buf.addr = reinterpret_cast<uint64_t>(buffer(buffer_id));
+  buf.len = buffer_size_;
+  buf.bid = buffer_id;
+  tail_++;
+  std::atomic_ref<uint16_t>{buf_ring_->tail}.store(tail_, std::memory_order_release);
+}
+
+bool ProvidedBufferRing::probe_() {
+  int fds[2];
+  if (::pipe(fds) < 0) [[unlikely]] {
+    throw std::system_error(errno, std::system_category(), "pipe");
+  }
+  const char byte = 0;
+  int res = static_cast<int>(::write(fds[1], &byte, 1));
+  if (res == 1) [[likely]] {
+    io_uring_sqe *sqe = ring_.get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fds[0];
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group_id_;
+    sqe->user_data = 0;
+    ring_.submit_and_wait(1);
+    ring_.for_each_cqe([this, &res](const io_uring_cqe &cqe) {
+      res = cqe.res;
+      if (cqe.flags & IORING_CQE_F_BUFFER) {
+        recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+      }
+    });
+  }
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return res == 1;
+}
+
+io_uring_sqe *ProvidedBufferRing::provide_(const uint16_t buffer_id, const uint32_t buffer_num) {
+  io_uring_sqe *sqe = ring_.get_sqe();
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->fd = static_cast<int32_t>(buffer_num);
+  sqe->addr = reinterpret_cast<uint64_t>(buffer(buffer_id));
+  sqe->len = buffer_size_;
+  sqe->off = buffer_id;
+  sqe->buf_group = group_id_;
+  sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+  sqe->user_data = 0; // same as cancel, completion is ignored
+  return sqe;
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+namespace ToE
+{
+
+/**
+ * @brief IoUring is a minimal io_uring instance driven by raw syscalls, owned by one thread.
+ * 1. sqes are queued by get_sqe() and submitted in one batch by submit_and_wait(), a full queue is submitted early.
+ * 2. with sqpoll a kernel thread consumes submissions, io_uring_enter is only called to wake it or to wait.
+ * 3. ring fd may be registered by the thread driving it, so io_uring_enter skips fd lookup.
+ * constructor throws std::system_error if kernel refuses the ring.
+ */
+struct IoUring {
+  IoUring(const uint32_t entries, const bool sqpoll);
+  ~IoUring();
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+  int fd() const noexcept { return ring_fd_; }
+  void register_ring_fd() noexcept; // registration is per thread in kernel, only that thread may enter afterwards
+  io_uring_sqe *get_sqe(); // zeroed, never null
+  void reserve(const uint32_t sqe_num); // next sqe_num get_sqe() calls do not submit in between
+  // submit queued sqes, then wait until at least wait_nr cqes are ready or timeout, EINTR is not an error
+  void submit_and_wait(const uint32_t wait_nr, const uint64_t timeout_ns = UINT64_MAX);
+  void submit_all(); // return once kernel has taken every queued sqe, so fds they name can be closed
+  // call on_cqe(const io_uring_cqe &) for each ready cqe and consume them, return count
+  template <typename OnCqe>
+  uint32_t for_each_cqe(OnCqe &&on_cqe);
+  bool cq_ready() const noexcept {
+    return std::atomic_ref<uint32_t>{*cq_tail_}.load(std::memory_order_acquire) != *cq_head_;
+  }
+private:
+  void release_() noexcept;
+  uint32_t flush_() noexcept; // publish queued sqes to kernel, return count not consumed yet
+  int enter_(const uint32_t to_submit, const uint32_t wait_nr, uint32_t flags, const uint64_t timeout_ns) noexcept;
+  int ring_fd_;
+  int enter_fd_; // registered index of ring_fd_ if enter_flags_ has IORING_ENTER_REGISTERED_RING
+  uint32_t enter_flags_;
+  bool sqpoll_;
+  void *sq_ring_;
+  std::size_t sq_ring_size_;
+  void *cq_ring_; // same mapping as sq_ring_ if kernel supports single mmap
+  std::size_t cq_ring_size_;
+  io_uring_sqe *sqes_;
+  uint32_t *sq_head_;
+  uint32_t *sq_tail_;
+  uint32_t *sq_flags_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  uint32_t sqe_tail_; // next sqe to queue, published to sq_tail_ by flush_()
+  uint32_t *cq_head_;
+  uint32_t *cq_tail_;
+  uint32_t cq_mask_;
+  io_uring_cqe *cqes_;
+};
+
+/**
+ * @brief ProvidedBufferRing is a group of receive buffers registered to an IoUring as buffer ring.
+ * kernel picks a buffer for each completion of recv with IOSQE_BUFFER_SELECT, owner gives it back by recycle()
+ * once consumed, recv fails with ENOBUFS when all buffers are held.
+ * ring is probed once, if kernel refuses it or never picks from it, buffers are provided by
+ * IORING_OP_PROVIDE_BUFFERS instead, then recycle() queues an sqe going out with next submission.
+ */
+struct ProvidedBufferRing {
+  ProvidedBufferRing(IoUring &ring, const uint16_t group_id, const uint32_t buffer_num, const uint32_t buffer_size);
+  ~ProvidedBufferRing();
+  ProvidedBufferRing(const ProvidedBufferRing &) = delete;
+  ProvidedBufferRing &operator=(const ProvidedBufferRing &) = delete;
+  uint16_t group_id() const noexcept { return group_id_; }
+  std::byte *buffer(const uint16_t buffer_id) const noexcept { return buffers_ + buffer_id * buffer_size_; }
+  void recycle(const uint16_t buffer_id);
+  bool legacy() const noexcept { return legacy_; }
+private:
+  bool probe_(); // kernel picks a buffer from registered ring, called before ring is used by others
+  io_uring_sqe *provide_(const uint16_t buffer_id, const uint32_t buffer_num); // legacy, no cqe unless it fails
+  IoUring &ring_;
+  const uint16_t group_id_;
+  const uint32_t buffer_num_;
+  const uint32_t buffer_size_;
+  io_uring_buf_ring *buf_ring_;
+  std::size_t buf_ring_size_;
+  std::byte *buffers_;
+  uint16_t tail_;
+  bool legacy_;
+};
+
+template <typename OnCqe>
+uint32_t IoUring::for_each_cqe(OnCqe &&on_cqe) {
+  uint32_t head = *cq_head_;
+  const uint32_t tail = std::atomic_ref<uint32_t>{*cq_tail_}.load(std::memory_order_acquire);
+  for (; head != tail; head++) {
+    on_cqe(cqes_[head & cq_mask_]);
+  }
+  const uint32_t count = tail - *cq_head_;
+  std::atomic_ref<uint32_t>{*cq_head_}.store(tail, std::memory_order_release);
+  return count;
+}
+
+}
@@ -1,4 +1,6 @@
 #include "net_define.h"
+#include <cassert>
+#include <utility>
 
 namespace ToE
 {
@@ -59,14 +61,11 @@ void EndPoint::from_asio_end_point(const ASIO_EndPoint &end_point) {
 }
 
 ASIO_EndPoint EndPoint::to_asio_endpoint() const {
-  char ip_str[16];
-  auto result = std::format_to_n(ip_str, sizeof(ip_str), "{}.{}.{}.{}",
-                                  ip_.ipv4_.addr_[0],
-                                  ip_.ipv4_.addr_[1],
-                                  ip_.ipv4_.addr_[2],
-                                  ip_.ipv4_.addr_[3]);
-  *result.out++ = '\0';
-  return {boost::asio::ip::make_address(ip_str), port_};
+  boost::asio::ip::address_v4::bytes_type bytes{ip_.ipv4_.addr_[0],
+                                                ip_.ipv4_.addr_[1],
+                                                ip_.ipv4_.addr_[2],
+                                                ip_.ipv4_.addr_[3]};
+  return {boost::asio::ip::address_v4{bytes}, port_};
 }
 
 EndPoint::IPType EndPoint::ip_type() const {
@@ -90,18 +89,52 @@ void EndPoint::to_string(char *buffer, const int64_t buffer_len, int64_t &pos) c
   pos += result.out - (buffer + pos);
 }
 
-NetBuffer::NetBuffer(NetBuffer &&rhs) {
-  buffer_ = rhs.buffer_;
-  rhs.buffer_ = nullptr;
-  buffer_len_ = rhs.buffer_len_;
-  rhs.buffer_len_ = 0;
+uint64_t EndPoint::hash() const {
+  uint64_t ret = port_;
+  if (ip_type() == IPType::IPV4) {
+    uint32_t addr = 0;
+    memcpy(&addr, ip_.ipv4_.addr_, sizeof(addr));
+    ret |= (static_cast<uint64_t>(addr) << 16);
+  } else {
+    for (uint16_t segment : ip_.ipv6_.addr_) {
+      ret = ret * 0x100000001b3ULL ^ segment;
+    }
+  }
+  return ret;
 }
 
-NetBuffer &NetBuffer::operator=(NetBuffer &&rhs) {
+NetBuffer::NetBuffer(const uint64_t size)
+: buffer_{nullptr},
+buffer_len_{size},
+block_{nullptr} {
+  if (size != 0) [[likely]] {
+    block_ = BufferPool::instance().allocate(size);
+    buffer_ = block_->data();
+  }
+}
+
+NetBuffer::NetBuffer(NetBuffer &&rhs) noexcept
+: buffer_{std::exchange(rhs.buffer_, nullptr)},
+buffer_len_{std::exchange(rhs.buffer_len_, 0)},
+block_{std::exchange(rhs.block_, nullptr)} {}
+
+NetBuffer &NetBuffer::operator=(NetBuffer &&rhs) noexcept {
   if (&rhs != this) {
-    new (this) NetBuffer{std::move(rhs)};
+    reset();
+    buffer_ = std::exchange(rhs.buffer_, nullptr);
+    buffer_len_ = std::exchange(rhs.buffer_len_, 0);
+    block_ = std::exchange(rhs.block_, nullptr);
   }
   return *this;
 }
 
+NetBuffer NetBuffer::slice(const uint64_t offset, const uint64_t len) const noexcept {
+  assert(offset + len <= buffer_len_);
+  if (block_ == nullptr) [[unlikely]] {
+    return NetBuffer{};
+  }
+  block_->ref_cnt_.fetch_add(1, std::memory_order_relaxed);
+  return NetBuffer{block_, buffer_ + offset, len};
+}
+
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "boost/asio/ip/address.hpp"
 #include <format>
 #include "common.h"
+#include "buffer_pool.h"
 #include "mechanism/stringification.hpp"
 
 namespace ToE
@@ -35,7 +36,7 @@ struct EndPoint {
     uint16_t addr_[8];
   };
   friend class REFLECT<EndPoint>;
-  EndPoint() : ip_{}, port_{0} {}
+  EndPoint() : ip_{}, port_{0}, flags_{0} {}
   EndPoint(const IPV4 &ipv4, uint16_t port)
   : port_{port}, flags_{0} { ip_.ipv4_ = ipv4; flags_ |= static_cast<uint32_t>(IPType::IPV4);}
   EndPoint(const EndPoint &endpoint) = default;
@@ -50,6 +51,7 @@ struct EndPoint {
   uint16_t port() const { return port_; }
   void set_port(uint16_t port) { port_ = port; }
   void to_string(char *buffer, const int64_t buffer_len, int64_t &pos) const;
+  uint64_t hash() const;
 private:
   union IP {
     IP() : ipv6_{0} {}
@@ -60,18 +62,34 @@ private:
   uint32_t flags_;
 };
 
-struct NetBuffer { // RAII
-  NetBuffer() : buffer_{nullptr}, buffer_len_{0} {}
-  NetBuffer(const uint64_t size)
-  : buffer_{new std::byte[size]},
-  buffer_len_{size} {}
-  ~NetBuffer() { if (buffer_) delete[] buffer_; }
+// RAII, ref-counted slice of a BufferPool block, block is recycled when it's last slice is destroyed
+struct NetBuffer {
+  NetBuffer() : buffer_{nullptr}, buffer_len_{0}, block_{nullptr} {}
+  NetBuffer(const uint64_t size); // uninitialized, nothing allocated if size is 0
+  ~NetBuffer() { reset(); }
   NetBuffer(const NetBuffer &) = delete;
-  NetBuffer(NetBuffer &&rhs);
+  NetBuffer(NetBuffer &&rhs) noexcept;
   NetBuffer &operator=(const NetBuffer &) = delete;
-  NetBuffer &operator=(NetBuffer &&rhs);
+  NetBuffer &operator=(NetBuffer &&rhs) noexcept;
+  NetBuffer slice(const uint64_t offset, const uint64_t len) const noexcept; // shares block, nothing copied
+  NetBuffer share() const noexcept { return slice(0, buffer_len_); }
+  bool unique() const noexcept { // no other slice of block alive, so it can be rewritten
+    return block_ == nullptr || block_->ref_cnt_.load(std::memory_order_acquire) == 1;
+  }
+  void reset() noexcept {
+    if (block_ && block_->ref_cnt_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      BufferPool::instance().release(block_);
+    }
+    buffer_ = nullptr;
+    buffer_len_ = 0;
+    block_ = nullptr;
+  }
   std::byte *buffer_;
   uint64_t buffer_len_;
+private:
+  NetBuffer(BufferBlock *block, std::byte *buffer, const uint64_t buffer_len)
+  : buffer_{buffer}, buffer_len_{buffer_len}, block_{block} {}
+  BufferBlock *block_;
 };
 
 struct NetBufferView {
@@ -98,10 +116,18 @@ struct CoRpcCallBack {
   virtual void process_buffer_cb(const EndPoint endpoint,
                                  const NetBuffer &net_buffer,
                                  LinkedCoroutine *&coroutine) = 0;
+  virtual void process_error_cb(const EndPoint endpoint,
+                                const int32_t error,
+                                LinkedCoroutine *&coroutine) = 0; // server refused to execute request
   virtual void timeout_cb() = 0;
+  virtual void cancel_cb() = 0;
+  virtual void abort_cb() = 0; // canceled before sent to any endpoint
 };
 
 }
+template <> struct std::hash<ToE::EndPoint> {
+  size_t operator()(const ToE::EndPoint &endpoint) const noexcept { return endpoint.hash(); }
+};
 STATIC_REFLECT(ToE::EndPoint, ip_, port_);
 STATIC_REFLECT(ToE::NetBuffer, buffer_, buffer_len_);
 STATIC_REFLECT(ToE::NetBufferView, buffer_, buffer_len_);
\ No newline at end of file
@@ -16,163 +16,139 @@ using namespace boost::asio::ip;
 namespace ToE
 {
 
+NetService::NetService(uint16_t port, const NetConfig &config, TimeService &time_service)
+: NetServiceBase{port, config, time_service},
+stop_flag_{true},
+shards_{} {
+  const uint32_t io_thread_num = std::max(config.io_thread_num_, 1U);
+  for (uint32_t idx = 0; idx < io_thread_num; idx++) {
+    shards_.emplace_back(std::make_unique<IoShard>(idx));
+  }
+}
+
+NetService::~NetService() {
+  for (auto &shard : shards_) {
+    shard->connections_.clear();
+  }
+  for (auto &shard : shards_) {
+    shard->io_ctx_.shutdown();
+  }
+}
+
 void NetService::start() {
   stop_flag_.store(false, std::memory_order_release);
-  std::promise<void> promise;
-  std::future<void> future = promise.get_future();
-  thread_ = std::jthread([this,
-                          &promise,
-                          scheduler = TLS_SCHEDULER,
-                          framework = TLS_FRAMEWORK] {
-    TLS_SCHEDULER = scheduler;
-    TLS_FRAMEWORK = framework;
-    asio::co_spawn(io_ctx_, listener(io_ctx_, listen_port_, promise), asio::detached);
-    io_ctx_.run();
-  });
-  future.wait();
+  std::vector<std::promise<void>> promises(shards_.size());
+  for (auto &shard : shards_) {
+    shard->thread_ = std::jthread([this,
+                                   &shard = *shard,
+                                   &promise = promises[shard->idx_],
+                                   scheduler = TLS_SCHEDULER,
+                                   framework = TLS_FRAMEWORK] {
+      TLS_SCHEDULER = scheduler;
+      TLS_FRAMEWORK = framework;
+      asio::co_spawn(shard.io_ctx_, listener_(shard, promise), asio::detached);
+      shard.io_ctx_.run();
+    });
+  }
+  for (auto &promise : promises) {
+    promise.get_future().wait();
+  }
   DEBUG_LOG("NetService started");
 }
 
 void NetService::stop() noexcept {
-  io_ctx_.stop();
+  for (auto &shard : shards_) {
+    shard->io_ctx_.stop();
+  }
   DEBUG_LOG("NetService stopped");
 }
 
 void NetService::wait() noexcept {
-  if (thread_.joinable()) [[likely]] {
-    thread_.join();
+  for (auto &shard : shards_) {
+    if (shard->thread_.joinable()) [[likely]] {
+      shard->thread_.join();
+    }
   }
   DEBUG_LOG("NetService joined");
 }
 
-void NetService::commit_send_response_task(EndPoint endpoint, NetBuffer &&net_buffer) {
-  co_spawn(io_ctx_, send_response(endpoint, std::move(net_buffer)), asio::detached);
-}
-
-asio::awaitable<void> NetService::listener(asio::io_context& io_ctx, uint16_t port, std::promise<void> &promise) {
+asio::awaitable<void> NetService::listener_(IoShard &shard, std::promise<void> &promise) {
   try {
-    INFO_LOG("listen on:{}", port);
-    auto executor = co_await asio::this_coro::executor;
-    tcp::acceptor acceptor(executor, {tcp::v4(), port});
+    INFO_LOG("listen on:{}, shard:{}", listen_port_, shard.idx_);
+    tcp::acceptor acceptor(shard.io_ctx_);
+    tcp::endpoint listen_endpoint{tcp::v4(), listen_port_};
+    acceptor.open(listen_endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address{true});
+    if (shards_.size() > 1) { // kernel balances accepted connections across io threads
+      acceptor.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>{true});
+    }
+    acceptor.bind(listen_endpoint);
+    acceptor.listen();
     promise.set_value();
     while (true) {
       tcp::socket socket = co_await acceptor.async_accept(asio::use_awaitable);
-      asio::co_spawn(executor, receive(std::move(socket)), asio::detached);
+      std::make_shared<Connection>(this, shard.idx_, std::move(socket))->start_reading(); // pooled once caller is known
     }
   } catch (const std::exception &e) {
     ERROR_LOG("listen error:{}", e.what());
   }
 }
 
-asio::awaitable<void> NetService::send_response(EndPoint endpoint, NetBuffer net_buffer) {
-  co_await send_(endpoint, net_buffer);
+void NetService::post_send_(const EndPoint &endpoint, OutgoingFrame &&frame) {
+  IoShard &shard = peer_shard(endpoint);
+  asio::post(shard.io_ctx_, [this, &shard, endpoint, frame = std::move(frame)]() mutable {
+    send_(shard, endpoint, std::move(frame));
+  });
 }
 
-asio::awaitable<void> NetService::receive(tcp::socket socket) {
-  EndPoint peer_endpoint;
-  peer_endpoint.from_asio_end_point(socket.remote_endpoint());
-  PackageHeader header;
-  uint64_t header_size = Serializer<PackageHeader>::get_serialize_size(header);
-  constexpr size_t BUFFER_SIZE = 128_B;
-  std::byte data[BUFFER_SIZE];
-  try {
-    uint64_t read_idx = 0;
-    while (read_idx < header_size) {
-      size_t n = co_await socket.async_read_some(asio::buffer(data + read_idx, header_size - read_idx),
-                                                 asio::use_awaitable);
-      read_idx += n;
-    }
-    int64_t pos = 0;
-    Serializer<PackageHeader>::deserialize(header, data, header_size, pos);
-    NetBuffer received_buffer(header.payload_len_);
-    assert(header.checksum_ == PackageHeader::MAGIC_NUMBER);
-    read_idx = 0;
-    while (read_idx < header.payload_len_) {
-      size_t n = co_await socket.async_read_some(asio::buffer(received_buffer.buffer_ + read_idx, received_buffer.buffer_len_ - read_idx),
-                                                  asio::use_awaitable);
-      read_idx += n;
-    }
-    assert(TLS_FRAMEWORK != nullptr);
-    if (header.get_message_type() == PackageHeader::MessageType::REQUEST) {
-      Expected<void> ret = reflect_commit_function(header, peer_endpoint, received_buffer.buffer_, received_buffer.buffer_len_);
-      assert(ret);
-    } else if (header.get_message_type() == PackageHeader::MessageType::RESPONSE) {
-      LinkedCoroutine *need_awak_corotine = nullptr;
-      {
-        std::lock_guard<std::mutex> lg(lock_);
-        auto iter = waiting_coros_.find(header.rpc_id_);
-        if (waiting_coros_.end() != iter) [[unlikely]] {
-          auto &mantain_info = iter->second;
-          peer_endpoint.set_port(header.server_port_);
-          mantain_info.coro_rpc_callback_->process_buffer_cb(peer_endpoint, received_buffer, need_awak_corotine);
-          if (need_awak_corotine) {
-            waiting_coros_.erase(iter);
-          }
-        } else {
-          DEBUG_LOG("not find id:{}", header.rpc_id_);
-        }
-      }
-      if (need_awak_corotine) {
-        TLS_SCHEDULER->commit(need_awak_corotine);
-      }
-    } else {
-      std::abort();
-    }
-    assert(pos == header_size);
-    assert(header.payload_len_ <= BUFFER_SIZE - header_size);
-    socket.close();
-  } catch (const std::exception &e) {
-    if (socket.is_open()) {
-      DEBUG_LOG("connection closed");
-      socket.close();
-    }
-    DEBUG_LOG(e.what());
+void NetService::send_(IoShard &shard, const EndPoint &endpoint, OutgoingFrame &&frame) {
+  auto iter = shard.connections_.find(endpoint);
+  if (shard.connections_.end() == iter) [[unlikely]] {
+    iter = shard.connections_.emplace(endpoint, std::make_shared<Connection>(this, shard.idx_, shard.io_ctx_, endpoint)).first;
+  }
+  if (iter->second->shard() == shard.idx_) [[likely]] {
+    iter->second->send(std::move(frame));
+  } else { // accepted by other io thread, socket is only touched there
+    asio::post(shards_[iter->second->shard()]->io_ctx_, [connection = iter->second, frame = std::move(frame)]() mutable {
+      connection->send(std::move(frame));
+    });
   }
 }
 
-asio::awaitable<void> NetService::send_(EndPoint endpoints,
-                                        NetBufferView net_buffer_view) {
-  tcp::socket socket(io_ctx_);
-  try {
-    co_await socket.async_connect(endpoints.to_asio_endpoint(), asio::use_awaitable);
-    co_await async_write(socket, asio::buffer(net_buffer_view.buffer_, net_buffer_view.buffer_len_), asio::use_awaitable);
-    boost::system::error_code ec;
-    auto ret = socket.shutdown(tcp::socket::shutdown_send, ec);
-    if (ret || ec) [[unlikely]] {
-      DEBUG_LOG("shutdown error, ret:{}, ec:{},{}", ret.value(), ec.value(), ec.what());
-    }
-    ret = socket.close(ec);
-    if (ret || ec) [[unlikely]] {
-      DEBUG_LOG("close error, ret:{}, ec:{},{}", ret.value(), ec.value(), ec.what());
+void NetService::remove_connection(const std::shared_ptr<Connection> &connection) {
+  IoShard &shard = peer_shard(connection->peer());
+  asio::dispatch(shard.io_ctx_, [&shard, connection] {
+    auto iter = shard.connections_.find(connection->peer());
+    if (shard.connections_.end() != iter && iter->second == connection) {
+      shard.connections_.erase(iter);
     }
-  } catch (const std::exception &e) {
-    if (socket.is_open()) {
-      socket.close();
-    }
-    DEBUG_LOG(e.what());
-  }
+  });
 }
 
-asio::awaitable<void> NetService::timeout_(const uint64_t coro_id, const uint64_t timeout_ns) {
-  asio::steady_timer timer(co_await asio::this_coro::executor);
-  timer.expires_after(std::chrono::nanoseconds(timeout_ns));
-  co_await timer.async_wait(asio::use_awaitable);
-  LinkedCoroutine *need_awak_corotine = nullptr;
-  {
-    std::lock_guard<std::mutex> lg(lock_);
-    auto iter = waiting_coros_.find(coro_id);
-    if (waiting_coros_.end() != iter) [[unlikely]] {
-      auto &mantain_info = iter->second;
-      mantain_info.coro_rpc_callback_->timeout_cb();
-      need_awak_corotine = mantain_info.coroutine_;
-      if (need_awak_corotine) {
-        waiting_coros_.erase(iter);
-      }
-    }
-  }
-  if (need_awak_corotine) {
-    TLS_SCHEDULER->commit(need_awak_corotine);
+void NetService::dispatch(const std::shared_ptr<Connection> &connection,
+                          const PackageHeader &header,
+                          NetBuffer &&net_buffer) {
+  EndPoint peer_endpoint;
+  peer_endpoint.from_asio_end_point(connection->remote());
+  peer_endpoint.set_port(header.server_port_); // caller's listen port
+  assert(TLS_FRAMEWORK != nullptr);
+  if (connection->accepted() && !connection->peer().is_valid()) [[unlikely]] {
+    connection->set_peer(peer_endpoint); // responses and later requests to caller reuse this connection
+    // handled only once pooled in peer's shard, so reply of it's handler can not miss this connection,
+    // later messages may be handled first, handlers of one connection never had an order anyway
+    IoShard &shard = peer_shard(peer_endpoint);
+    asio::dispatch(shard.io_ctx_, [this, &shard, connection, peer_endpoint,
+                                   counter = header.process_restart_counter_, type = header.rpc_type_,
+                                   id = header.rpc_id_, flags = header.flags_, len = header.payload_len_,
+                                   net_buffer = std::move(net_buffer)]() mutable {
+      shard.connections_.try_emplace(peer_endpoint, connection);
+      PackageHeader first{counter, type, id, peer_endpoint.port(), len}; // header is not copyable
+      first.flags_ = flags;
+      handle_message_(peer_endpoint, first, std::move(net_buffer));
+    });
+    return;
   }
+  handle_message_(peer_endpoint, header, std::move(net_buffer));
 }
 
-}
\ No newline at end of file
+}
@@ -7,66 +7,56 @@
 #include <coroutine>
 #include <thread>
 #include "net_define.h"
-#include "coroutine_framework/common_execute_module.h"
+#include "connection.h"
+#include "net_service_base.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace ToE
 {
 
-struct MaintainInfo {
-  MaintainInfo(LinkedCoroutine *coroutine, CoRpcCallBack *coro_rpc_callback)
-  : coroutine_{coroutine},
-  coro_rpc_callback_{coro_rpc_callback} {}
-  LinkedCoroutine *coroutine_;
-  CoRpcCallBack *coro_rpc_callback_;
+// connections and handlers of one shard may hold sockets of other shards,
+// so every shard is shut down(pending handlers destroyed) before any io_context is destroyed
+struct ShardIoContext : public boost::asio::io_context {
+  using boost::asio::io_context::io_context;
+  void shutdown() { boost::asio::execution_context::shutdown(); }
 };
 
-struct NetService {
-  NetService(uint16_t port)
-  : listen_port_{port},
-  thread_{},
-  stop_flag_{true},
+struct IoShard {
+  IoShard(const uint32_t idx)
+  : idx_{idx},
   io_ctx_{1},
-  lock_{},
-  waiting_coros_{} {}
-  NetService(const NetService &) = delete;
-  NetService(NetService &&) = delete;
-  NetService &operator=(const NetService &) = delete;
-  NetService &operator=(NetService &&) = delete;
+  connections_{},
+  thread_{} {}
+  const uint32_t idx_;
+  ShardIoContext io_ctx_;
+  std::unordered_map<EndPoint, std::shared_ptr<Connection>> connections_; // peers owned by this shard, io thread only
+  std::jthread thread_;
+};
+
+// net backend on boost asio, one io_context per io thread
+struct NetService : public NetServiceBase {
+  NetService(uint16_t port, TimeService &time_service) : NetService{port, NetConfig{}, time_service} {}
+  NetService(uint16_t port, const NetConfig &config, TimeService &time_service); // drives rpc timeouts
+  ~NetService() override;
   void start();
   void stop() noexcept;
   void wait() noexcept;
-  uint16_t get_listen_port() const { return listen_port_; }
-  template <std::ranges::range EndPoints>
-  void commit_send_request_task(const uint64_t coro_id,
-                                const EndPoints &endpoints,
-                                const NetBufferView net_buffer_view,
-                                const uint64_t timeout_ns,
-                                LinkedCoroutine *coroutine,
-                                CoRpcCallBack *coro_rpc_callback) {
-    {
-      std::unique_lock<std::mutex> lg{lock_};
-      boost::asio::co_spawn(io_ctx_, timeout_(coro_id, timeout_ns), boost::asio::detached);
-      waiting_coros_.insert({coro_id, MaintainInfo{coroutine, coro_rpc_callback}});
-    }
-    for (auto &endpoint_with_flag : endpoints) {
-      DEBUG_LOG("send request");
-      boost::asio::co_spawn(io_ctx_, send_(endpoint_with_flag.first, net_buffer_view), boost::asio::detached);
-    }
-  }
-  void commit_send_response_task(EndPoint endpoint, NetBuffer &&net_buffer);
-  boost::asio::awaitable<void> send_request(const std::vector<std::pair<EndPoint, NetBuffer>> &pairs,
-                                     const NetBufferView net_buffer);
-  boost::asio::awaitable<void> send_response(EndPoint endpoints, NetBuffer net_buffer);
-  boost::asio::awaitable<void> listener(boost::asio::io_context& io_ctx, uint16_t port, std::promise<void> &promise);
-  boost::asio::awaitable<void> receive(boost::asio::ip::tcp::socket socket);
-  boost::asio::awaitable<void> send_(EndPoint endpoint, NetBufferView net_buffer);
-  boost::asio::awaitable<void> timeout_(const uint64_t coro_id, const uint64_t timeout_ns);
-  uint16_t listen_port_;
-  std::jthread thread_;
+  uint32_t io_thread_num() const { return static_cast<uint32_t>(shards_.size()); }
+  // below are called in io threads only
+  void dispatch(const std::shared_ptr<Connection> &connection, const PackageHeader &header, NetBuffer &&net_buffer);
+  void remove_connection(const std::shared_ptr<Connection> &connection);
+  IoShard &peer_shard(const EndPoint &peer) noexcept { return *shards_[peer.hash() % shards_.size()]; }
+  IoShard &shard(const uint32_t idx) noexcept { return *shards_[idx]; }
+protected:
+  void post_send_(const EndPoint &endpoint, OutgoingFrame &&frame) override;
+private:
+  void send_(IoShard &shard, const EndPoint &endpoint, OutgoingFrame &&frame);
+  boost::asio::awaitable<void> listener_(IoShard &shard, std::promise<void> &promise);
   std::atomic<bool> stop_flag_;
-  boost::asio::io_context io_ctx_;
-  std::mutex lock_;
-  std::unordered_map<uint64_t/*CoroutineID*/, MaintainInfo> waiting_coros_;
+  std::vector<std::unique_ptr<IoShard>> shards_;
+  friend struct Connection;
 };
 
 }
\ No newline at end of file
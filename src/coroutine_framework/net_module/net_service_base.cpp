@@ -0,0 +1,145 @@
+#include "net_service_base.h"
+#include <algorithm>
+#include "rpc_struct.h"
+#include "rpc_mapper.h"
+#include "mechanism/serialization.hpp"
+#include "coroutine_framework/scheduler.h"
+
+namespace ToE
+{
+
+NetServiceBase::NetServiceBase(uint16_t port, const NetConfig &config, TimeService &time_service)
+: listen_port_{port},
+connect_timeout_ns_{config.connect_timeout_ns_},
+max_message_size_{config.max_message_size_},
+reassembly_budget_{config.reassembly_budget_},
+pending_rpcs_{config.max_pending_rpc_, time_service},
+connect_cnt_{0},
+worker_polled_{false},
+handler_shards_{} {
+  const uint32_t shard_num = std::max(config.io_thread_num_, 1U);
+  for (uint32_t idx = 0; idx < shard_num; idx++) {
+    handler_shards_.emplace_back(std::make_unique<HandlerShard>());
+  }
+}
+
+void NetServiceBase::commit_send_response_task(const EndPoint &endpoint,
+                                           const uint64_t rpc_id,
+                                           const uint16_t rpc_type,
+                                           NetBuffer &&payload) {
+  PackageHeader header{1, rpc_type, rpc_id, listen_port_, payload.buffer_len_};
+  header.set_message_type(PackageHeader::MessageType::RESPONSE);
+  post_send_(endpoint, OutgoingFrame{header, std::move(payload)});
+}
+
+void NetServiceBase::commit_send_cancel_task(const EndPoint &endpoint, const uint64_t rpc_id, const uint16_t rpc_type) {
+  PackageHeader header{1, rpc_type, rpc_id, listen_port_, 0};
+  header.set_message_type(PackageHeader::MessageType::CANCEL);
+  post_send_(endpoint, OutgoingFrame{header, NetBuffer{}}); // header only, nothing allocated
+}
+
+void NetServiceBase::commit_send_error_task(const EndPoint &endpoint,
+                                        const uint64_t rpc_id,
+                                        const uint16_t rpc_type,
+                                        const Error error) {
+  PackageHeader header{1, rpc_type, rpc_id, listen_port_, 0};
+  header.set_message_type(PackageHeader::MessageType::ERROR_RESPONSE);
+  header.payload_len_ = Serializer<Error>::get_serialize_size(error);
+  NetBuffer payload{header.payload_len_};
+  int64_t pos = 0;
+  Serializer<Error>::serialize(error, payload.buffer_, payload.buffer_len_, pos);
+  post_send_(endpoint, OutgoingFrame{header, std::move(payload)});
+}
+
+LinkedCoroutine *NetServiceBase::cancel_request(const uint64_t rpc_id) noexcept {
+  LinkedCoroutine *need_awak_corotine = nullptr;
+  MaintainInfo *mantain_info = pending_rpcs_.acquire(rpc_id);
+  if (mantain_info) {
+    mantain_info->coro_rpc_callback_->cancel_cb();
+    need_awak_corotine = mantain_info->coroutine_;
+    pending_rpcs_.release(rpc_id, true);
+  }
+  return need_awak_corotine;
+}
+
+void NetServiceBase::register_handler(const EndPoint &caller, const uint64_t rpc_id, CancelState *cancel_state) {
+  cancel_state->inc_ref();
+  RunningHandlerKey key{caller, rpc_id};
+  HandlerShard &shard = handler_shard_(key);
+  std::lock_guard<std::mutex> lg(shard.lock_);
+  auto [iter, inserted] = shard.running_handlers_.try_emplace(key, cancel_state);
+  if (!inserted) [[unlikely]] { // caller retried with same id, older handler can not be canceled anymore
+    iter->second->dec_ref();
+    iter->second = cancel_state;
+  }
+}
+
+void NetServiceBase::unregister_handler(const EndPoint &caller, const uint64_t rpc_id, CancelState *cancel_state) {
+  RunningHandlerKey key{caller, rpc_id};
+  HandlerShard &shard = handler_shard_(key);
+  std::lock_guard<std::mutex> lg(shard.lock_);
+  auto iter = shard.running_handlers_.find(key);
+  if (shard.running_handlers_.end() != iter && iter->second == cancel_state) {
+    cancel_state->dec_ref();
+    shard.running_handlers_.erase(iter);
+  }
+}
+
+void NetServiceBase::cancel_handler(const EndPoint &caller, const uint64_t rpc_id) {
+  CancelState *cancel_state = nullptr;
+  {
+    RunningHandlerKey key{caller, rpc_id};
+    HandlerShard &shard = handler_shard_(key);
+    std::lock_guard<std::mutex> lg(shard.lock_);
+    auto iter = shard.running_handlers_.find(key);
+    if (shard.running_handlers_.end() != iter) {
+      cancel_state = iter->second;
+      cancel_state->inc_ref();
+    }
+  }
+  if (cancel_state) { // cancel out of lock, callbacks may send cancel to other servers
+    cancel_state->cancel();
+    cancel_state->dec_ref();
+  } else {
+    DEBUG_LOG("handler already finished, id:{}", rpc_id);
+  }
+}
+
+void NetServiceBase::handle_message_(const EndPoint &peer_endpoint,
+                                     const PackageHeader &header,
+                                     NetBuffer &&net_buffer) {
+  if (header.get_message_type() == PackageHeader::MessageType::REQUEST) {
+    Expected<void> ret = reflect_commit_function(header, peer_endpoint, net_buffer.buffer_, net_buffer.buffer_len_);
+    if (!ret) [[unlikely]] { // shed by admission control or not reflected, tell caller rather than let it timeout
+      commit_send_error_task(peer_endpoint, header.rpc_id_, header.rpc_type_, ret.error());
+    }
+  } else if (header.get_message_type() == PackageHeader::MessageType::RESPONSE ||
+             header.get_message_type() == PackageHeader::MessageType::ERROR_RESPONSE) {
+    LinkedCoroutine *need_awak_corotine = nullptr;
+    Error error{0};
+    if (header.get_message_type() == PackageHeader::MessageType::ERROR_RESPONSE) [[unlikely]] {
+      int64_t error_pos = 0;
+      Serializer<Error>::deserialize(error, net_buffer.buffer_, net_buffer.buffer_len_, error_pos);
+    }
+    MaintainInfo *mantain_info = pending_rpcs_.acquire(header.rpc_id_);
+    if (mantain_info) [[likely]] {
+      if (0 == error.error_no_) [[likely]] {
+        mantain_info->coro_rpc_callback_->process_buffer_cb(peer_endpoint, net_buffer, need_awak_corotine);
+      } else {
+        mantain_info->coro_rpc_callback_->process_error_cb(peer_endpoint, error.error_no_, need_awak_corotine);
+      }
+      pending_rpcs_.release(header.rpc_id_, need_awak_corotine != nullptr);
+    } else {
+      DEBUG_LOG("stale response, id:{}", header.rpc_id_);
+    }
+    if (need_awak_corotine) {
+      TLS_SCHEDULER->commit(need_awak_corotine);
+    }
+  } else if (header.get_message_type() == PackageHeader::MessageType::CANCEL) {
+    cancel_handler(peer_endpoint, header.rpc_id_);
+  } else {
+    std::abort();
+  }
+}
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <unordered_map>
+#include <vector>
+#include "literal.h"
+#include "log/logger.h"
+#include "net_define.h"
+#include "frame_codec.h"
+#include "pending_rpc_table.h"
+#include "coroutine_framework/common_execute_module.h"
+#include "coroutine_framework/cancellation.h"
+#include "error_define/error_struct.h"
+
+namespace ToE
+{
+
+struct RunningHandlerKey { // rpc handler running in this process, identified by caller
+  bool operator==(const RunningHandlerKey &rhs) const { return rpc_id_ == rhs.rpc_id_ && caller_ == rhs.caller_; }
+  EndPoint caller_;
+  uint64_t rpc_id_;
+};
+
+struct RunningHandlerKeyHash {
+  size_t operator()(const RunningHandlerKey &key) const noexcept {
+    return std::hash<EndPoint>{}(key.caller_) ^ (key.rpc_id_ * 0x9e3779b97f4a7c15ULL);
+  }
+};
+
+struct NetConfig {
+  // each io thread runs own event loop and SO_REUSEPORT listener, connections are sharded
+  uint32_t io_thread_num_ = 1;
+  // outgoing rpcs waiting for response at the same time, more are rejected with Error::BUSY
+  uint32_t max_pending_rpc_ = 64 * 1024;
+  // outgoing connect not finished in time is aborted and backs off like a refused one
+  uint64_t connect_timeout_ns_ = 3_s;
+  // incoming message longer than this breaks the connection, sender should keep to receiver's limit
+  uint64_t max_message_size_ = 64_MiB;
+  // declared bytes of chunked messages partly received on one connection, enough for FrameWriter::MAX_STREAMS
+  // messages of max size by default, lower it to bound memory spent on slow or hostile peers
+  uint64_t reassembly_budget_ = 256_MiB;
+  // below are for io_uring backend only
+  uint32_t uring_entries_ = 1024; // submission queue size of each io thread
+  uint32_t uring_recv_buffer_num_ = 256; // provided receive buffers of each io thread, power of 2
+  uint32_t uring_recv_buffer_size_ = 16 * 1024;
+  // kernel thread polls submission queue, io thread submits without syscall but a core spins per io thread
+  bool uring_sqpoll_ = false;
+  // io_uring backend only, no io threads, each scheduler worker polls own shard of sockets between coroutine
+  // batches, so a request is read, handled and answered on one core. io_thread_num_ is taken from worker number
+  bool run_to_completion_ = false;
+};
+
+/**
+ * @brief NetServiceBase is the part of net module shared by all net backends.
+ * 1. outgoing rpcs are tracked in PendingRpcTable, handlers running for remote callers in sharded maps for cancel.
+ * 2. backend owns connections and io threads, it sends frames through post_send_() from any thread,
+ *    and hands every whole message it reads to handle_message_() in it's io thread.
+ * 3. backend polled by scheduler workers has no io threads, worker idx drives shard idx through *_worker() below.
+ */
+struct NetServiceBase {
+  static constexpr bool WORKER_POLL_SUPPORTED = false; // NetConfig::run_to_completion_ is ignored
+  NetServiceBase(uint16_t port, const NetConfig &config, TimeService &time_service); // drives rpc timeouts
+  virtual ~NetServiceBase() = default;
+  NetServiceBase(const NetServiceBase &) = delete;
+  NetServiceBase(NetServiceBase &&) = delete;
+  NetServiceBase &operator=(const NetServiceBase &) = delete;
+  NetServiceBase &operator=(NetServiceBase &&) = delete;
+  uint16_t get_listen_port() const { return listen_port_; }
+  uint64_t connect_timeout_ns() const noexcept { return connect_timeout_ns_; }
+  uint64_t max_message_size() const noexcept { return max_message_size_; }
+  uint64_t reassembly_budget() const noexcept { return reassembly_budget_; }
+  // rpc id correlates request and response, INVALID_RPC_ID if too many pending rpcs
+  uint64_t claim_request(LinkedCoroutine *coroutine, CoRpcCallBack *coro_rpc_callback) noexcept {
+    return pending_rpcs_.claim(MaintainInfo{coroutine, coro_rpc_callback});
+  }
+  template <std::ranges::range EndPoints>
+  void commit_send_request_task(const uint64_t rpc_id,
+                                const EndPoints &endpoints,
+                                const OutgoingFrame &frame,
+                                const uint64_t timeout_ns,
+                                LinkedCoroutine *coroutine,
+                                CoRpcCallBack *coro_rpc_callback) {
+    // coroutine can not be awaken by response/timeout/cancel until published, so endpoints is safe to read
+    if (coroutine->coro_local_var_->cancel_token_.is_cancelled()) [[unlikely]] { // see cancel_request()
+      pending_rpcs_.abort(rpc_id);
+      coro_rpc_callback->abort_cb();
+      TLS_SCHEDULER->commit(coroutine);
+    } else {
+      for (auto &endpoint_with_flag : endpoints) {
+        DEBUG_LOG("send request");
+        post_send_(endpoint_with_flag.first, frame.share()); // payload shared by all endpoints
+      }
+      pending_rpcs_.publish(rpc_id, timeout_ns);
+    }
+  }
+  LinkedCoroutine *cancel_request(const uint64_t rpc_id) noexcept; // return waiting coroutine if removed
+  void commit_send_response_task(const EndPoint &endpoint,
+                                 const uint64_t rpc_id,
+                                 const uint16_t rpc_type,
+                                 NetBuffer &&payload);
+  void commit_send_cancel_task(const EndPoint &endpoint, const uint64_t rpc_id, const uint16_t rpc_type);
+  void commit_send_error_task(const EndPoint &endpoint, const uint64_t rpc_id, const uint16_t rpc_type, const Error error);
+  void register_handler(const EndPoint &caller, const uint64_t rpc_id, CancelState *cancel_state);
+  void unregister_handler(const EndPoint &caller, const uint64_t rpc_id, CancelState *cancel_state);
+  void cancel_handler(const EndPoint &caller, const uint64_t rpc_id);
+  uint64_t get_connect_count() const { return connect_cnt_.load(std::memory_order_relaxed); }
+  bool worker_polled() const noexcept { return worker_polled_; }
+  // called by worker idx only, between attach and detach, after start()
+  virtual void attach_worker(const uint32_t) {}
+  // handle ready io, wait up to timeout_ns if nothing is ready, false once stopped and drained
+  virtual bool poll_worker(const uint32_t, const uint64_t) { return false; }
+  virtual void detach_worker(const uint32_t) noexcept {}
+  virtual void wake_worker(const uint32_t) noexcept {} // any thread, poll_worker() returns soon
+protected:
+  // queue frame to peer's connection, called from any thread
+  virtual void post_send_(const EndPoint &endpoint, OutgoingFrame &&frame) = 0;
+  // whole message read from peer(caller's listen endpoint), called in io thread
+  void handle_message_(const EndPoint &peer_endpoint, const PackageHeader &header, NetBuffer &&net_buffer);
+  uint16_t listen_port_;
+  uint64_t connect_timeout_ns_;
+  uint64_t max_message_size_;
+  uint64_t reassembly_budget_;
+  PendingRpcTable pending_rpcs_;
+  std::atomic<uint64_t> connect_cnt_; // outgoing connections established
+  bool worker_polled_; // set by backend constructor
+private:
+  struct HandlerShard {
+    std::mutex lock_;
+    std::unordered_map<RunningHandlerKey, CancelState *, RunningHandlerKeyHash> running_handlers_;
+  };
+  HandlerShard &handler_shard_(const RunningHandlerKey &key) noexcept {
+    return *handler_shards_[RunningHandlerKeyHash{}(key) % handler_shards_.size()];
+  }
+  std::vector<std::unique_ptr<HandlerShard>> handler_shards_; // one per io thread
+};
+
+}
@@ -0,0 +1,151 @@
+#include "pending_rpc_table.h"
+#include <cassert>
+#include <thread>
+#include "net_define.h"
+#include "coroutine_framework/common_execute_module.h"
+
+namespace ToE
+{
+
+PendingRpcTable::PendingRpcTable(const uint32_t capacity, TimeService &time_service)
+: capacity_{capacity},
+time_service_{time_service},
+slots_{},
+free_head_{capacity == 0 ? 0ULL : 1ULL} {
+  for (uint32_t idx = 0; idx < capacity_; idx++) {
+    Slot &slot = slots_.emplace_back(this);
+    slot.state_.store(make_state_(1, FREE), std::memory_order_relaxed);
+    slot.next_free_.store(idx + 1 < capacity_ ? idx + 2 : 0, std::memory_order_relaxed);
+  }
+}
+
+uint64_t PendingRpcTable::claim(const MaintainInfo &info) noexcept {
+  uint64_t head = free_head_.load(std::memory_order_acquire);
+  uint32_t idx = 0;
+  while (true) {
+    const uint32_t top = static_cast<uint32_t>(head);
+    if (top == 0) [[unlikely]] {
+      return INVALID_RPC_ID;
+    }
+    idx = top - 1;
+    const uint64_t next = ((head >> 32) + 1) << 32 | slots_[idx].next_free_.load(std::memory_order_relaxed);
+    if (free_head_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+      break;
+    }
+  }
+  Slot &slot = slots_[idx];
+  if (!slot.timer_) [[unlikely]] { // slot is owned by claimer, resolvers see it after publish()
+    slot.timer_ = std::make_unique<TimerHandle>(time_service_, &slot);
+  }
+  const uint32_t generation = static_cast<uint32_t>(slot.state_.load(std::memory_order_relaxed) >> PHASE_BITS);
+  slot.info_ = info;
+  slot.state_.store(make_state_(generation, ARMING), std::memory_order_release);
+  return static_cast<uint64_t>(generation) << 32 | idx;
+}
+
+void PendingRpcTable::publish(const uint64_t rpc_id, const uint64_t timeout_ns) noexcept {
+  Slot &slot = slots_[index_(rpc_id)];
+  slot.armed_rpc_id_ = rpc_id;
+  slot.timer_->arm_after(timeout_ns);
+  uint64_t state = make_state_(generation_(rpc_id), ARMING);
+  if (!slot.state_.compare_exchange_strong(state, make_state_(generation_(rpc_id), WAITING),
+                                           std::memory_order_acq_rel, std::memory_order_acquire)) [[unlikely]] {
+    assert(state == make_state_(generation_(rpc_id), ARMING_EXPIRED));
+    slot.state_.store(make_state_(generation_(rpc_id), BUSY), std::memory_order_relaxed);
+    slot.timer_->wait_callback(); // timer thread may still be returning from it's callback
+    expire_(rpc_id);
+  }
+}
+
+void PendingRpcTable::abort(const uint64_t rpc_id) noexcept {
+  assert(slots_[index_(rpc_id)].state_.load(std::memory_order_relaxed) == make_state_(generation_(rpc_id), ARMING));
+  free_(index_(rpc_id), false);
+}
+
+MaintainInfo *PendingRpcTable::acquire(const uint64_t rpc_id) noexcept {
+  if (index_(rpc_id) >= capacity_) [[unlikely]] { // corrupted or from previous process
+    return nullptr;
+  }
+  Slot &slot = slots_[index_(rpc_id)];
+  uint64_t state = slot.state_.load(std::memory_order_acquire);
+  while (true) {
+    if (static_cast<uint32_t>(state >> PHASE_BITS) != generation_(rpc_id) || (state & PHASE_MASK) == FREE) {
+      return nullptr; // finished, slot may have been reused
+    }
+    if ((state & PHASE_MASK) == WAITING) [[likely]] {
+      if (slot.state_.compare_exchange_weak(state, make_state_(generation_(rpc_id), BUSY),
+                                            std::memory_order_acquire, std::memory_order_acquire)) {
+        return &slot.info_;
+      }
+    } else { // claimer still sending or other resolver running callback
+      std::this_thread::yield();
+      state = slot.state_.load(std::memory_order_acquire);
+    }
+  }
+}
+
+void PendingRpcTable::release(const uint64_t rpc_id, const bool finished) noexcept {
+  assert(slots_[index_(rpc_id)].state_.load(std::memory_order_relaxed) == make_state_(generation_(rpc_id), BUSY));
+  if (finished) {
+    free_(index_(rpc_id), false);
+  } else {
+    slots_[index_(rpc_id)].state_.store(make_state_(generation_(rpc_id), WAITING), std::memory_order_release);
+  }
+}
+
+void PendingRpcTable::Slot::on_timer(const bool cancelled) noexcept {
+  if (cancelled) {
+    return; // rpc finished before timeout
+  }
+  const uint64_t rpc_id = armed_rpc_id_; // slot is not reused until this callback returns, see free_()
+  const uint32_t generation = generation_(rpc_id);
+  uint64_t state = state_.load(std::memory_order_acquire);
+  while (true) {
+    if (static_cast<uint32_t>(state >> PHASE_BITS) != generation || (state & PHASE_MASK) == FREE) {
+      return;
+    }
+    if ((state & PHASE_MASK) == WAITING) [[likely]] {
+      if (state_.compare_exchange_weak(state, table_->make_state_(generation, BUSY),
+                                       std::memory_order_acquire, std::memory_order_acquire)) {
+        table_->expire_(rpc_id);
+        return;
+      }
+    } else if ((state & PHASE_MASK) == ARMING) { // may be inline in publish(), leave it to claimer
+      if (state_.compare_exchange_weak(state, table_->make_state_(generation, ARMING_EXPIRED),
+                                       std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return;
+      }
+    } else { // other resolver running callback, it may finish the rpc
+      std::this_thread::yield();
+      state = state_.load(std::memory_order_acquire);
+    }
+  }
+}
+
+void PendingRpcTable::expire_(const uint64_t rpc_id) noexcept {
+  Slot &slot = slots_[index_(rpc_id)];
+  slot.info_.coro_rpc_callback_->timeout_cb();
+  LinkedCoroutine *coroutine = slot.info_.coroutine_;
+  free_(index_(rpc_id), true);
+  TLS_SCHEDULER->commit(coroutine);
+}
+
+void PendingRpcTable::free_(const uint32_t idx, const bool in_timer_callback) noexcept {
+  Slot &slot = slots_[idx];
+  uint32_t generation = static_cast<uint32_t>(slot.state_.load(std::memory_order_relaxed) >> PHASE_BITS) + 1;
+  if (generation == 0) [[unlikely]] { // wrapped, keep INVALID_RPC_ID unused
+    generation = 1;
+  }
+  slot.info_ = MaintainInfo{};
+  slot.state_.store(make_state_(generation, FREE), std::memory_order_release); // expired timer gives up from now on
+  if (!slot.timer_->cancel() && !in_timer_callback) { // disarm in O(1), or wait expired one returns
+    slot.timer_->wait_callback();
+  }
+  uint64_t head = free_head_.load(std::memory_order_relaxed);
+  do {
+    slot.next_free_.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+  } while (!free_head_.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | (idx + 1),
+                                             std::memory_order_release, std::memory_order_relaxed));
+}
+
+}
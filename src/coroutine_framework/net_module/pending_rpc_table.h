@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include "coroutine_framework/time_module/time_service.h"
+
+namespace ToE
+{
+
+class LinkedCoroutine;
+struct CoRpcCallBack;
+
+struct MaintainInfo {
+  MaintainInfo() : coroutine_{nullptr}, coro_rpc_callback_{nullptr} {}
+  MaintainInfo(LinkedCoroutine *coroutine, CoRpcCallBack *coro_rpc_callback)
+  : coroutine_{coroutine},
+  coro_rpc_callback_{coro_rpc_callback} {}
+  LinkedCoroutine *coroutine_;
+  CoRpcCallBack *coro_rpc_callback_;
+};
+
+/**
+ * @brief PendingRpcTable is a pre-sized slot array of outgoing rpcs waiting for response, lock free.
+ * 1. rpc id is generation(high 32 bits) plus slot index(low 32 bits), generation is bumped when slot is freed,
+ *    so late response/timeout/cancel of a finished rpc is told by generation mismatch.
+ * 2. slot is FREE -> ARMING(claimed, request being sent) -> WAITING <-> BUSY(one resolver is running callback) -> FREE,
+ *    resolvers wait shortly while slot is ARMING or BUSY, these phases only run a few non-blocking calls.
+ * 3. free slots are kept in a tagged treiber stack, claim and free are one CAS each.
+ * 4. each slot owns a TimerHandle of TimeService for rpc timeout, armed when published and canceled in O(1)
+ *    when slot is freed, timeout fired in ARMING phase is left to claimer(ARMING_EXPIRED), it may fire inline.
+ *    handle is allocated out of line on first claim of slot, free stack is LIFO so only hot slots ever get one.
+ */
+struct PendingRpcTable {
+  static constexpr uint64_t INVALID_RPC_ID = 0; // generation starts from 1
+  PendingRpcTable(const uint32_t capacity, TimeService &time_service);
+  PendingRpcTable(const PendingRpcTable &) = delete;
+  PendingRpcTable &operator=(const PendingRpcTable &) = delete;
+  uint64_t claim(const MaintainInfo &info) noexcept; // INVALID_RPC_ID if table is full
+  // by claimer, resolvers may take it from now on, resumes coroutine with timeout if it's expired already
+  void publish(const uint64_t rpc_id, const uint64_t timeout_ns) noexcept;
+  void abort(const uint64_t rpc_id) noexcept; // by claimer, give up before publish
+  MaintainInfo *acquire(const uint64_t rpc_id) noexcept; // exclusive access, nullptr if finished or stale
+  void release(const uint64_t rpc_id, const bool finished) noexcept; // after acquire, free slot if finished
+  uint32_t capacity() const noexcept { return capacity_; }
+private:
+  enum Phase : uint64_t {
+    FREE = 0,
+    ARMING = 1,
+    WAITING = 2,
+    BUSY = 3,
+    ARMING_EXPIRED = 4,
+  };
+  static constexpr uint64_t PHASE_BITS = 3;
+  static constexpr uint64_t PHASE_MASK = (1ULL << PHASE_BITS) - 1;
+  struct Slot : public TimerCallBack {
+    Slot(PendingRpcTable *table)
+    : state_{0},
+    next_free_{0},
+    info_{},
+    armed_rpc_id_{INVALID_RPC_ID},
+    table_{table},
+    timer_{} {}
+    virtual void on_timer(const bool cancelled) noexcept override;
+    std::atomic<uint64_t> state_; // generation << PHASE_BITS | phase
+    std::atomic<uint32_t> next_free_; // index + 1 of next free slot, 0 is end
+    MaintainInfo info_;
+    uint64_t armed_rpc_id_; // timer is armed for, written before arm
+    PendingRpcTable *table_;
+    std::unique_ptr<TimerHandle> timer_; // set by first claimer, never freed before table
+  };
+  static uint32_t generation_(const uint64_t rpc_id) noexcept { return static_cast<uint32_t>(rpc_id >> 32); }
+  static uint32_t index_(const uint64_t rpc_id) noexcept { return static_cast<uint32_t>(rpc_id); }
+  static uint64_t make_state_(const uint32_t generation, const Phase phase) noexcept {
+    return static_cast<uint64_t>(generation) << PHASE_BITS | phase;
+  }
+  void expire_(const uint64_t rpc_id) noexcept; // timer fired, slot is BUSY
+  void free_(const uint32_t idx, const bool in_timer_callback) noexcept;
+  const uint32_t capacity_;
+  TimeService &time_service_;
+  std::deque<Slot> slots_; // never moved
+  std::atomic<uint64_t> free_head_; // tag << 32 | (index + 1), tag avoids ABA
+};
+
+}
@@ -17,6 +17,9 @@ Expected<void> reflect_commit_function(const PackageHeader &header,
                                        std::byte *serialized_data,
                                        const uint64_t len) {
   Expected<void> ret = {};
+  if (!TLS_FRAMEWORK->get_admission().try_acquire()) [[unlikely]] { // shed before deserializing and creating frame
+    return UnExpected{Error::BUSY};
+  }
   switch (header.rpc_type_) {
     #define RPC_REGISTER(ID, FUNC) \
     case FunctionToID<FUNC>::value: \
@@ -33,12 +36,23 @@ Expected<void> reflect_commit_function(const PackageHeader &header,
           return FUNC(std::move(args)...); \
         }, args_tuple); \
         task.promise_->coro_local_var_ = new CoroLocalVar{task.promise_->ref_cnt_}; \
-        task.promise_->coro_local_var_->response_info_ = new ResponseInfo{server_endpoint, header.rpc_id_, header.rpc_type_}; \
-        ret = TLS_FRAMEWORK->commit(std::move(task)); \
+        using RetType = FunctionToID<FUNC>::FunctionTraits::return_type::return_type; \
+        task.promise_->coro_local_var_->response_info_ = new ResponseInfo{server_endpoint, \
+                                                                          header.rpc_id_, \
+                                                                          header.rpc_type_, \
+                                                                          &reply_to_caller<RetType>}; \
+        CancellationSource cancel_source; /* caller could abort handler by CANCEL message */ \
+        task.promise_->coro_local_var_->cancel_token_ = cancel_source.token(); \
+        TLS_FRAMEWORK->get_net_module().register_handler(server_endpoint, header.rpc_id_, cancel_source.state_); \
+        ret = TLS_FRAMEWORK->commit_admitted(task); \
+        if (!ret) [[unlikely]] { \
+          TLS_FRAMEWORK->get_net_module().unregister_handler(server_endpoint, header.rpc_id_, cancel_source.state_); \
+        } \
       } \
       break;
     __RPC_REGISTER__
     default:
+      TLS_FRAMEWORK->get_admission().release();
       ret = UnExpected{Error::FUNCTION_NOT_REFLECTED};
     #undef RPC_REGISTER
   }
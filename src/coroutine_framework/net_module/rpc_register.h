@@ -1,5 +1,7 @@
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
+#include <string>
 #include <tuple>
 #include "coroutine_framework/task.h"
 #include "demo/point.h"
@@ -10,9 +12,16 @@ namespace ToE {
 CoroTask<int64_t> example_add(int64_t a, int64_t b);
 CoroTask<int64_t> example_echo();
 CoroTask<Point> example_add_point(Point a, Point b);
+CoroTask<std::string> example_repeat(char c, int64_t count);
+CoroTask<int64_t> example_count(std::string data, char c);
+CoroTask<int64_t> example_wait(uint64_t wait_ms); // aborted when caller cancels
+extern std::atomic<int64_t> EXAMPLE_WAIT_CANCELED_CNT;
 
 #define __RPC_REGISTER__ \
   RPC_REGISTER(1, example_add) \
   RPC_REGISTER(2, example_echo) \
-  RPC_REGISTER(3, example_add_point)
+  RPC_REGISTER(3, example_add_point) \
+  RPC_REGISTER(4, example_repeat) \
+  RPC_REGISTER(5, example_count) \
+  RPC_REGISTER(6, example_wait)
 }
\ No newline at end of file
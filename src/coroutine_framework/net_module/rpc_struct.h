@@ -11,11 +11,15 @@ struct PackageHeader {
     NOT_USED_1 = 0,
     REQUEST  = 1,
     RESPONSE = 2,
-    NOT_USED_2 = 3,
+    CANCEL   = 3, // caller does not need the result anymore, ask server to abort handler
+    ERROR_RESPONSE = 4, // request not executed(shed by admission control...), payload is Error
   };
   static constexpr uint32_t MAGIC_NUMBER = 0xaabbccdd;
-  static constexpr uint32_t MASK_MESSAGE_TYPE_BITS = 0x00000000000000000000000000000011b;
+  static constexpr uint32_t MASK_MESSAGE_TYPE_BITS = 0b111;
+  static constexpr uint16_t FLAG_CHUNK = 1 << 3; // one piece of a message too large for one frame
+  static constexpr uint16_t FLAG_FIRST_CHUNK = 1 << 4; // payload starts with uint64_t length of whole message
   static constexpr uint16_t VERSION = 1;
+  static constexpr uint64_t SERIALIZE_SIZE = 32; // all fields are fundamental, so every header has same size
   PackageHeader()
   : version_{0},
   reserved_{0},
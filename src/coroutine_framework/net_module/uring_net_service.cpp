@@ -0,0 +1,699 @@
+#include "uring_net_service.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "rpc_struct.h"
+#include "log/logger.h"
+#include "coroutine_framework/scheduler.h"
+
+namespace ToE
+{
+
+namespace
+{
+
+constexpr uint16_t RECV_BUFFER_GROUP = 0;
+constexpr uint64_t USER_DATA_OP_MASK = 0x7;
+constexpr uint64_t USER_DATA_OWNER_MASK = 0x0000fffffffffff8ULL;
+
+thread_local UringShard *TLS_URING_SHARD = nullptr; // shard driven by this scheduler worker, run to completion only
+
+void set_no_delay(const int fd) noexcept {
+  int on = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+}
+
+UringConnection::UringConnection(UringNetService *service, UringShard &shard, const EndPoint &peer)
+: service_{service},
+shard_{shard},
+peer_{peer},
+remote_{peer.to_asio_endpoint()},
+fd_{-1},
+writer_{},
+reader_{service->max_message_size(), service->reassembly_budget()},
+iovecs_{},
+iovec_idx_{0},
+msghdr_{},
+self_{},
+pending_ops_{0},
+state_{State::IDLE},
+accepted_{false},
+sending_{false},
+flushing_{false},
+epoch_{0},
+backoff_ns_{0},
+next_connect_ts_{} {}
+
+UringConnection::UringConnection(UringNetService *service, UringShard &shard, const int fd, const ASIO_EndPoint &remote)
+: service_{service},
+shard_{shard},
+peer_{},
+remote_{remote},
+fd_{fd},
+writer_{},
+reader_{service->max_message_size(), service->reassembly_budget()},
+iovecs_{},
+iovec_idx_{0},
+msghdr_{},
+self_{},
+pending_ops_{0},
+state_{State::CONNECTED},
+accepted_{true},
+sending_{false},
+flushing_{false},
+epoch_{0},
+backoff_ns_{0},
+next_connect_ts_{} {
+  set_no_delay(fd_);
+}
+
+UringConnection::~UringConnection() {
+  close_socket_();
+}
+
+void UringConnection::send(OutgoingFrame &&frame) {
+  if (state_ == State::CONNECTED) [[likely]] {
+    writer_.push(std::move(frame));
+    if (!flushing_) { // written after every posted send of this iteration is queued
+      flushing_ = true;
+      shard_.flush_list_.push_back(shared_from_this());
+    }
+  } else if (state_ == State::CONNECTING) {
+    writer_.push(std::move(frame)); // written once connected
+  } else if (state_ == State::IDLE && std::chrono::steady_clock::now() >= next_connect_ts_) {
+    writer_.push(std::move(frame));
+    connect_();
+  } else { // backing off or closed, caller times out
+    DEBUG_LOG("drop message to:{}, state:{}", peer_, static_cast<uint8_t>(state_));
+  }
+}
+
+void UringConnection::start_reading() {
+  submit_recv_();
+}
+
+void UringConnection::flush() noexcept {
+  flushing_ = false;
+  submit_send_();
+}
+
+void UringConnection::on_completion(const Op op, const uint16_t epoch, const io_uring_cqe &cqe) noexcept {
+  const bool current = epoch == static_cast<uint16_t>(epoch_);
+  if (op == Op::RECV) [[likely]] {
+    on_received_(current, cqe);
+  } else if (op == Op::SEND) {
+    on_sent_(current, cqe.res);
+  } else if (current) {
+    on_connected_(cqe.res);
+  }
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    finish_op_();
+  }
+}
+
+io_uring_sqe *UringConnection::prepare_op_(const Op op) {
+  io_uring_sqe *sqe = shard_.ring_.get_sqe();
+  sqe->user_data = UringShard::user_data(this, static_cast<uint8_t>(op), epoch_);
+  if (pending_ops_++ == 0) {
+    self_ = shared_from_this();
+  }
+  shard_.inflight_ops_++;
+  return sqe;
+}
+
+void UringConnection::finish_op_() noexcept {
+  shard_.inflight_ops_--;
+  if (--pending_ops_ == 0) {
+    std::shared_ptr<UringConnection> self = std::move(self_); // connection may be destroyed on return
+  }
+}
+
+void UringConnection::connect_() {
+  state_ = State::CONNECTING;
+  fd_ = ::socket(remote_.protocol().family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0 || shard_.stopping_) [[unlikely]] {
+    on_connected_(fd_ < 0 ? -errno : -ECANCELED);
+    return;
+  }
+  shard_.ring_.reserve(2); // linked pair must not be split by a flush
+  io_uring_sqe *sqe = prepare_op_(Op::CONNECT);
+  sqe->opcode = IORING_OP_CONNECT;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(remote_.data());
+  sqe->off = remote_.size();
+  sqe->flags = IOSQE_IO_LINK;
+  const uint64_t timeout_ns = service_->connect_timeout_ns();
+  connect_timeout_ = __kernel_timespec{static_cast<long long>(timeout_ns / 1_s), static_cast<long long>(timeout_ns % 1_s)};
+  io_uring_sqe *timeout_sqe = shard_.ring_.get_sqe();
+  timeout_sqe->opcode = IORING_OP_LINK_TIMEOUT; // connect completes with -ECANCELED when it fires
+  timeout_sqe->addr = reinterpret_cast<uint64_t>(&connect_timeout_);
+  timeout_sqe->len = 1;
+  timeout_sqe->user_data = 0; // ignored, see on_completion_
+}
+
+void UringConnection::submit_recv_() {
+  if (shard_.stopping_) [[unlikely]] {
+    return;
+  }
+  io_uring_sqe *sqe = prepare_op_(Op::RECV);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd_;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = shard_.recv_buffers_.group_id();
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+}
+
+void UringConnection::submit_send_() {
+  if (sending_ || state_ != State::CONNECTED || shard_.stopping_) {
+    return;
+  }
+  do {
+    if (writer_.empty()) {
+      return;
+    }
+    writer_.prepare(iovecs_);
+    if (iovecs_.empty()) [[unlikely]] {
+      writer_.commit();
+    }
+  } while (iovecs_.empty());
+  iovec_idx_ = 0;
+  sending_ = true;
+  submit_sendmsg_();
+}
+
+void UringConnection::submit_sendmsg_() {
+  msghdr_ = msghdr{};
+  msghdr_.msg_iov = iovecs_.data() + iovec_idx_;
+  msghdr_.msg_iovlen = iovecs_.size() - iovec_idx_;
+  io_uring_sqe *sqe = prepare_op_(Op::SEND);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&msghdr_);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL; // kernel retries short write itself
+}
+
+void UringConnection::on_connected_(const int res) noexcept {
+  if (res < 0) {
+    backoff_ns_ = std::clamp(backoff_ns_ * 2, MIN_BACKOFF, MAX_BACKOFF);
+    next_connect_ts_ = std::chrono::steady_clock::now() + std::chrono::nanoseconds(backoff_ns_);
+    DEBUG_LOG("connect to:{} failed:{}, back off {}ns", peer_, strerror(-res), backoff_ns_);
+    on_broken_();
+    return;
+  }
+  set_no_delay(fd_);
+  state_ = State::CONNECTED;
+  backoff_ns_ = 0;
+  service_->connect_cnt_.fetch_add(1, std::memory_order_relaxed);
+  submit_recv_();
+  submit_send_();
+}
+
+void UringConnection::on_received_(const bool current, const io_uring_cqe &cqe) noexcept {
+  const uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+  bool rearm = false;
+  if (current && state_ == State::CONNECTED) {
+    if (cqe.res > 0) [[likely]] {
+      try {
+        reader_.append(shard_.recv_buffers_.buffer(buffer_id), cqe.res,
+                       [this](const PackageHeader &header, NetBuffer &&payload) {
+          service_->dispatch(*this, header, std::move(payload));
+        });
+        rearm = true;
+      } catch (const std::exception &e) {
+        DEBUG_LOG("read from:{} failed:{}", peer_, e.what());
+        on_broken_();
+      }
+    } else if (cqe.res == -ENOBUFS) { // every provided buffer was held, some are given back now
+      rearm = true;
+    } else {
+      DEBUG_LOG("read from:{} failed:{}", peer_, cqe.res == 0 ? "eof" : strerror(-cqe.res));
+      on_broken_();
+    }
+  }
+  if (cqe.flags & IORING_CQE_F_BUFFER) {
+    shard_.recv_buffers_.recycle(buffer_id);
+  }
+  if (rearm && !(cqe.flags & IORING_CQE_F_MORE) && state_ == State::CONNECTED) {
+    submit_recv_();
+  }
+}
+
+void UringConnection::on_sent_(const bool current, const int res) noexcept {
+  if (!current) { // socket was closed, buffers are free and new socket may write
+    sending_ = false;
+    submit_send_();
+    return;
+  }
+  if (res < 0) {
+    DEBUG_LOG("write to:{} failed:{}", peer_, strerror(-res));
+    sending_ = false;
+    on_broken_();
+    return;
+  }
+  uint64_t written = static_cast<uint64_t>(res);
+  while (iovec_idx_ < iovecs_.size() && written >= iovecs_[iovec_idx_].iov_len) {
+    written -= iovecs_[iovec_idx_].iov_len;
+    iovec_idx_++;
+  }
+  if (iovec_idx_ < iovecs_.size()) [[unlikely]] { // interrupted, write the rest
+    iovecs_[iovec_idx_].iov_base = static_cast<std::byte *>(iovecs_[iovec_idx_].iov_base) + written;
+    iovecs_[iovec_idx_].iov_len -= written;
+    if (!shard_.stopping_) {
+      submit_sendmsg_();
+    } else {
+      sending_ = false;
+    }
+    return;
+  }
+  sending_ = false;
+  writer_.commit();
+  submit_send_();
+}
+
+void UringConnection::close_socket_() noexcept {
+  if (fd_ < 0) {
+    return;
+  }
+  if (pending_ops_ != 0) { // queued sqes name fd, kernel must take them before the number is reused
+    shard_.ring_.submit_all();
+  }
+  ::shutdown(fd_, SHUT_RDWR); // ops in flight hold the socket, they complete now
+  ::close(fd_);
+  fd_ = -1;
+}
+
+void UringConnection::on_broken_() noexcept {
+  if (state_ == State::CLOSED) {
+    return;
+  }
+  close_socket_();
+  epoch_++;
+  writer_.clear(); // unsent requests time out at caller
+  reader_.clear();
+  if (accepted_) {
+    state_ = State::CLOSED;
+    if (peer_.is_valid()) {
+      auto iter = shard_.local_peers_.find(peer_);
+      if (shard_.local_peers_.end() != iter && iter->second.get() == this) {
+        shard_.local_peers_.erase(iter);
+      }
+      service_->remove_connection(shared_from_this());
+    }
+  } else {
+    state_ = State::IDLE;
+  }
+}
+
+UringShard::UringShard(const uint32_t idx, const NetConfig &config)
+: idx_{idx},
+ring_{config.uring_entries_, config.uring_sqpoll_},
+recv_buffers_{ring_, RECV_BUFFER_GROUP, config.uring_recv_buffer_num_, config.uring_recv_buffer_size_},
+listen_fd_{-1},
+wake_fd_{::eventfd(0, EFD_CLOEXEC)},
+wake_value_{0},
+accept_backoff_ns_{0},
+accept_backoff_{},
+post_lock_{},
+posted_sends_{},
+posted_tasks_{},
+running_sends_{},
+running_tasks_{},
+connections_{},
+local_peers_{},
+flush_list_{},
+inflight_ops_{0},
+stopping_{false},
+thread_{} {
+  if (wake_fd_ < 0) [[unlikely]] {
+    throw std::system_error(errno, std::system_category(), "eventfd");
+  }
+}
+
+UringShard::~UringShard() {
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+  }
+  ::close(wake_fd_);
+}
+
+UringNetService::UringNetService(uint16_t port, const NetConfig &config, TimeService &time_service)
+: NetServiceBase{port, config, time_service},
+stop_flag_{true},
+shards_{} {
+  worker_polled_ = config.run_to_completion_;
+  const uint32_t io_thread_num = std::max(config.io_thread_num_, 1U);
+  for (uint32_t idx = 0; idx < io_thread_num; idx++) {
+    shards_.emplace_back(std::make_unique<UringShard>(idx, config));
+  }
+}
+
+UringNetService::~UringNetService() {
+  stop();
+  wait();
+  for (auto &shard : shards_) { // connections may be held by posts to other shards
+    shard->connections_.clear();
+    shard->local_peers_.clear();
+    shard->posted_sends_.clear();
+    shard->posted_tasks_.clear();
+  }
+}
+
+void UringNetService::start() {
+  stop_flag_.store(false, std::memory_order_release);
+  for (auto &shard : shards_) {
+    listen_(*shard);
+    if (worker_polled_) { // scheduler workers drive shards, see attach_worker()
+      continue;
+    }
+    shard->thread_ = std::jthread([this,
+                                   &shard = *shard,
+                                   scheduler = TLS_SCHEDULER,
+                                   framework = TLS_FRAMEWORK] {
+      TLS_SCHEDULER = scheduler;
+      TLS_FRAMEWORK = framework;
+      loop_(shard);
+    });
+  }
+  DEBUG_LOG("UringNetService started");
+}
+
+void UringNetService::stop() noexcept {
+  stop_flag_.store(true, std::memory_order_release);
+  for (auto &shard : shards_) {
+    wake_(*shard);
+  }
+  DEBUG_LOG("UringNetService stopped");
+}
+
+void UringNetService::wait() noexcept {
+  for (auto &shard : shards_) {
+    if (shard->thread_.joinable()) [[likely]] {
+      shard->thread_.join();
+    }
+  }
+  DEBUG_LOG("UringNetService joined");
+}
+
+void UringNetService::dispatch(UringConnection &connection, const PackageHeader &header, NetBuffer &&net_buffer) {
+  EndPoint peer_endpoint;
+  peer_endpoint.from_asio_end_point(connection.remote());
+  peer_endpoint.set_port(header.server_port_); // caller's listen port
+  if (connection.accepted() && !connection.peer().is_valid()) [[unlikely]] {
+    connection.set_peer(peer_endpoint); // responses and later requests to caller reuse this connection
+    register_connection(connection.shared_from_this());
+    if (worker_polled_) { // responses of handlers run by this worker are written here directly
+      connection.shard().local_peers_.try_emplace(peer_endpoint, connection.shared_from_this());
+    }
+  }
+  assert(TLS_FRAMEWORK != nullptr);
+  handle_message_(peer_endpoint, header, std::move(net_buffer));
+}
+
+void UringNetService::register_connection(const std::shared_ptr<UringConnection> &connection) {
+  UringShard &shard = peer_shard(connection->peer());
+  post_task_(shard, [&shard, connection] { shard.connections_.try_emplace(connection->peer(), connection); });
+}
+
+void UringNetService::remove_connection(const std::shared_ptr<UringConnection> &connection) {
+  UringShard &shard = peer_shard(connection->peer());
+  post_task_(shard, [&shard, connection] {
+    auto iter = shard.connections_.find(connection->peer());
+    if (shard.connections_.end() != iter && iter->second == connection) {
+      shard.connections_.erase(iter);
+    }
+  });
+}
+
+void UringNetService::post_send_(const EndPoint &endpoint, OutgoingFrame &&frame) {
+  UringShard *shard = TLS_URING_SHARD;
+  if (shard && shard->idx_ < shards_.size() && shards_[shard->idx_].get() == shard) { // worker owns the shard
+    auto iter = shard->local_peers_.find(endpoint);
+    if (shard->local_peers_.end() == iter) [[unlikely]] { // each worker has own connection, response comes back here
+      iter = shard->local_peers_.emplace(endpoint, std::make_shared<UringConnection>(this, *shard, endpoint)).first;
+    }
+    iter->second->send(std::move(frame)); // written by next poll_worker()
+    return;
+  }
+  post_(peer_shard(endpoint), UringShard::PostedSend{nullptr, endpoint, std::move(frame)});
+}
+
+void UringNetService::post_(UringShard &shard, UringShard::PostedSend &&send) {
+  bool idle = false;
+  {
+    std::lock_guard<std::mutex> lg(shard.post_lock_);
+    idle = shard.posted_sends_.empty() && shard.posted_tasks_.empty();
+    shard.posted_sends_.push_back(std::move(send));
+  }
+  if (idle) { // io thread may be waiting, later posts of this batch are taken along
+    wake_(shard);
+  }
+}
+
+void UringNetService::post_task_(UringShard &shard, std::function<void()> &&task) {
+  bool idle = false;
+  {
+    std::lock_guard<std::mutex> lg(shard.post_lock_);
+    idle = shard.posted_sends_.empty() && shard.posted_tasks_.empty();
+    shard.posted_tasks_.push_back(std::move(task));
+  }
+  if (idle) {
+    wake_(shard);
+  }
+}
+
+void UringNetService::wake_(UringShard &shard) noexcept {
+  const uint64_t one = 1;
+  [[maybe_unused]] const ssize_t ret = ::write(shard.wake_fd_, &one, sizeof(one));
+}
+
+void UringNetService::listen_(UringShard &shard) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  const int on = 1;
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(listen_port_);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (fd < 0 ||
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+      // kernel balances accepted connections across io threads
+      (shards_.size() > 1 && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) ||
+      ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      ::listen(fd, SOMAXCONN) < 0) [[unlikely]] {
+    ERROR_LOG("listen error:{}", strerror(errno));
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return;
+  }
+  INFO_LOG("listen on:{}, shard:{}", listen_port_, shard.idx_);
+  shard.listen_fd_ = fd;
+}
+
+void UringNetService::loop_(UringShard &shard) {
+  try {
+    attach_(shard);
+    while (!stop_flag_.load(std::memory_order_acquire)) {
+      poll_(shard, UINT64_MAX);
+    }
+    drain_(shard);
+  } catch (const std::exception &e) {
+    ERROR_LOG("io_uring loop error:{}, shard:{}", e.what(), shard.idx_);
+  }
+}
+
+void UringNetService::attach_(UringShard &shard) {
+  shard.ring_.register_ring_fd();
+  submit_wake_read_(shard);
+  submit_accept_(shard);
+}
+
+void UringNetService::poll_(UringShard &shard, const uint64_t timeout_ns) {
+  run_posted_(shard);
+  for (auto &connection : shard.flush_list_) { // frames queued by this iteration are gathered per connection
+    connection->flush();
+  }
+  shard.flush_list_.clear();
+  shard.ring_.submit_and_wait(shard.ring_.cq_ready() || timeout_ns == 0 ? 0 : 1, timeout_ns);
+  shard.ring_.for_each_cqe([this, &shard](const io_uring_cqe &cqe) { on_completion_(shard, cqe); });
+}
+
+void UringNetService::attach_worker(const uint32_t idx) {
+  UringShard &shard = *shards_[idx];
+  TLS_URING_SHARD = &shard;
+  try {
+    attach_(shard);
+  } catch (const std::exception &e) {
+    ERROR_LOG("io_uring attach error:{}, shard:{}", e.what(), shard.idx_);
+    shard.stopping_ = true; // never polled
+  }
+}
+
+bool UringNetService::poll_worker(const uint32_t idx, const uint64_t timeout_ns) {
+  UringShard &shard = *shards_[idx];
+  if (shard.stopping_) [[unlikely]] {
+    return false;
+  }
+  try {
+    if (!stop_flag_.load(std::memory_order_acquire)) [[likely]] {
+      poll_(shard, timeout_ns);
+      return true;
+    }
+    drain_(shard);
+  } catch (const std::exception &e) {
+    ERROR_LOG("io_uring loop error:{}, shard:{}", e.what(), shard.idx_);
+    shard.stopping_ = true;
+  }
+  return false;
+}
+
+void UringNetService::detach_worker(const uint32_t idx) noexcept {
+  UringShard &shard = *shards_[idx];
+  if (!shard.stopping_) {
+    try {
+      drain_(shard);
+    } catch (const std::exception &e) {
+      ERROR_LOG("io_uring drain error:{}, shard:{}", e.what(), shard.idx_);
+    }
+  }
+  TLS_URING_SHARD = nullptr;
+}
+
+void UringNetService::wake_worker(const uint32_t idx) noexcept {
+  wake_(*shards_[idx]);
+}
+
+void UringNetService::run_posted_(UringShard &shard) {
+  {
+    std::lock_guard<std::mutex> lg(shard.post_lock_);
+    shard.running_sends_.swap(shard.posted_sends_);
+    shard.running_tasks_.swap(shard.posted_tasks_);
+  }
+  for (auto &task : shard.running_tasks_) {
+    task();
+  }
+  shard.running_tasks_.clear();
+  for (auto &send : shard.running_sends_) {
+    std::shared_ptr<UringConnection> connection = std::move(send.connection_);
+    if (!connection) [[likely]] {
+      auto iter = shard.connections_.find(send.endpoint_);
+      if (shard.connections_.end() == iter) [[unlikely]] {
+        iter = shard.connections_.emplace(send.endpoint_, std::make_shared<UringConnection>(this, shard, send.endpoint_)).first;
+      }
+      connection = iter->second;
+    }
+    if (&connection->shard() == &shard) [[likely]] {
+      connection->send(std::move(send.frame_));
+    } else { // accepted by other io thread, socket is only touched there
+      post_(connection->shard(), UringShard::PostedSend{connection, send.endpoint_, std::move(send.frame_)});
+    }
+  }
+  shard.running_sends_.clear();
+}
+
+void UringNetService::submit_accept_(UringShard &shard) {
+  if (shard.listen_fd_ < 0 || shard.stopping_) {
+    return;
+  }
+  io_uring_sqe *sqe = shard.ring_.get_sqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = shard.listen_fd_;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = UringShard::user_data(&shard, static_cast<uint8_t>(UringShard::Op::ACCEPT), 0);
+  shard.inflight_ops_++;
+}
+
+void UringNetService::submit_accept_backoff_(UringShard &shard) {
+  if (shard.stopping_) {
+    return;
+  }
+  shard.accept_backoff_ns_ = std::clamp(shard.accept_backoff_ns_ * 2, UringShard::MIN_ACCEPT_BACKOFF, UringShard::MAX_ACCEPT_BACKOFF);
+  shard.accept_backoff_ = __kernel_timespec{static_cast<long long>(shard.accept_backoff_ns_ / 1_s),
+                                            static_cast<long long>(shard.accept_backoff_ns_ % 1_s)};
+  io_uring_sqe *sqe = shard.ring_.get_sqe();
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->addr = reinterpret_cast<uint64_t>(&shard.accept_backoff_);
+  sqe->len = 1;
+  sqe->user_data = UringShard::user_data(&shard, static_cast<uint8_t>(UringShard::Op::ACCEPT_BACKOFF), 0);
+  shard.inflight_ops_++;
+}
+
+void UringNetService::submit_wake_read_(UringShard &shard) {
+  if (shard.stopping_) {
+    return;
+  }
+  io_uring_sqe *sqe = shard.ring_.get_sqe();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = shard.wake_fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&shard.wake_value_);
+  sqe->len = sizeof(shard.wake_value_);
+  sqe->user_data = UringShard::user_data(&shard, static_cast<uint8_t>(UringShard::Op::WAKE), 0);
+  shard.inflight_ops_++;
+}
+
+void UringNetService::on_completion_(UringShard &shard, const io_uring_cqe &cqe) noexcept {
+  if (cqe.user_data == 0) { // cancel, connect timeout, or buffer given back to legacy group failed
+    return;
+  }
+  const uint8_t op = static_cast<uint8_t>(cqe.user_data & USER_DATA_OP_MASK);
+  const bool finished = !(cqe.flags & IORING_CQE_F_MORE);
+  if (op == static_cast<uint8_t>(UringShard::Op::WAKE)) {
+    shard.inflight_ops_--;
+    submit_wake_read_(shard);
+  } else if (op == static_cast<uint8_t>(UringShard::Op::ACCEPT)) {
+    shard.inflight_ops_ -= finished ? 1 : 0;
+    if (cqe.res >= 0) [[likely]] {
+      ASIO_EndPoint remote;
+      socklen_t len = static_cast<socklen_t>(remote.capacity());
+      shard.accept_backoff_ns_ = 0;
+      if (shard.stopping_ || ::getpeername(cqe.res, remote.data(), &len) < 0) [[unlikely]] {
+        ::close(cqe.res);
+      } else {
+        remote.resize(len);
+        std::make_shared<UringConnection>(this, shard, cqe.res, remote)->start_reading(); // pooled once caller is known
+      }
+      if (finished) {
+        submit_accept_(shard);
+      }
+    } else if (cqe.res != -ECANCELED) { // listener keeps working, pending connections wait in backlog meanwhile
+      ERROR_LOG("accept error:{}, shard:{}", strerror(-cqe.res), shard.idx_);
+      const bool out_of_resource = cqe.res == -EMFILE || cqe.res == -ENFILE || cqe.res == -ENOMEM || cqe.res == -ENOBUFS;
+      if (finished && out_of_resource) {
+        submit_accept_backoff_(shard);
+      } else if (finished) {
+        submit_accept_(shard);
+      }
+    }
+  } else if (op == static_cast<uint8_t>(UringShard::Op::ACCEPT_BACKOFF)) {
+    shard.inflight_ops_--;
+    if (cqe.res != -ECANCELED) {
+      submit_accept_(shard);
+    }
+  } else {
+    UringConnection *connection = reinterpret_cast<UringConnection *>(cqe.user_data & USER_DATA_OWNER_MASK);
+    connection->on_completion(static_cast<UringConnection::Op>(op), static_cast<uint16_t>(cqe.user_data >> 48), cqe);
+  }
+}
+
+void UringNetService::drain_(UringShard &shard) {
+  shard.stopping_ = true;
+  shard.flush_list_.clear();
+  io_uring_sqe *sqe = shard.ring_.get_sqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+  sqe->user_data = 0;
+  while (shard.inflight_ops_ != 0) { // canceled ops still complete, their buffers are in use until then
+    shard.ring_.submit_and_wait(1);
+    shard.ring_.for_each_cqe([this, &shard](const io_uring_cqe &cqe) { on_completion_(shard, cqe); });
+  }
+}
+
+}
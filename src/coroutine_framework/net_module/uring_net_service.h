@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "literal.h"
+#include "net_define.h"
+#include "frame_codec.h"
+#include "io_uring.h"
+#include "net_service_base.h"
+
+namespace ToE
+{
+
+struct UringNetService;
+struct UringShard;
+
+/**
+ * @brief UringConnection is Connection of io_uring backend, same states and rules, only touched by it's own io thread.
+ * 1. reads by one multishot recv picking provided buffers, bytes are copied into FrameReader and buffer is given back.
+ * 2. writes by one sendmsg at a time, gathered from FrameWriter, short write is resubmitted for the rest.
+ * 3. every submitted op holds the connection alive until it's last completion, completions of a closed socket
+ *    are told by epoch in user_data and only release their buffers.
+ */
+struct UringConnection : public std::enable_shared_from_this<UringConnection> {
+  enum class State : uint8_t {
+    IDLE = 0, // not connected, connect on next send
+    CONNECTING = 1,
+    CONNECTED = 2,
+    CLOSED = 3, // accepted connection broken, removed from pool
+  };
+  enum class Op : uint8_t { // low bits of user_data
+    CONNECT = 3,
+    RECV = 4,
+    SEND = 5,
+  };
+  static constexpr uint64_t MIN_BACKOFF = 10_ms;
+  static constexpr uint64_t MAX_BACKOFF = 5_s;
+  UringConnection(UringNetService *service, UringShard &shard, const EndPoint &peer); // outgoing
+  UringConnection(UringNetService *service, UringShard &shard, const int fd, const ASIO_EndPoint &remote); // accepted
+  UringConnection(const UringConnection &) = delete;
+  UringConnection &operator=(const UringConnection &) = delete;
+  ~UringConnection();
+  void send(OutgoingFrame &&frame);
+  void start_reading(); // accepted connection only, outgoing one starts reading when connected
+  void flush() noexcept; // write frames sent in this io loop iteration
+  void on_completion(const Op op, const uint16_t epoch, const io_uring_cqe &cqe) noexcept;
+  bool accepted() const noexcept { return accepted_; }
+  UringShard &shard() const noexcept { return shard_; } // io thread the socket belongs to
+  const EndPoint &peer() const noexcept { return peer_; }
+  void set_peer(const EndPoint &peer) noexcept { peer_ = peer; } // learned from first message of accepted connection
+  const ASIO_EndPoint &remote() const noexcept { return remote_; }
+  State state() const noexcept { return state_; }
+private:
+  io_uring_sqe *prepare_op_(const Op op); // op holds connection until it's last completion
+  void finish_op_() noexcept; // may destroy connection
+  void connect_();
+  void submit_recv_();
+  void submit_send_(); // next batch of writer if no sendmsg in flight
+  void submit_sendmsg_(); // rest of current batch
+  void on_connected_(const int res) noexcept;
+  void on_received_(const bool current, const io_uring_cqe &cqe) noexcept;
+  void on_sent_(const bool current, const int res) noexcept;
+  void close_socket_() noexcept;
+  void on_broken_() noexcept;
+  UringNetService *service_;
+  UringShard &shard_;
+  EndPoint peer_; // peer's listen endpoint, key in pool
+  ASIO_EndPoint remote_; // sockaddr for connect, cached
+  int fd_;
+  FrameWriter writer_;
+  FrameReader reader_;
+  std::vector<iovec> iovecs_; // of sendmsg in flight
+  std::size_t iovec_idx_; // first iovec not fully written
+  msghdr msghdr_;
+  __kernel_timespec connect_timeout_; // of linked timeout, read by kernel when submitted
+  std::shared_ptr<UringConnection> self_; // while any op is in flight
+  uint32_t pending_ops_;
+  State state_;
+  bool accepted_;
+  bool sending_; // sendmsg in flight, maybe of a closed socket, buffers are in use until it completes
+  bool flushing_; // in shard's flush list
+  uint64_t epoch_; // bumped when socket is closed
+  uint64_t backoff_ns_;
+  std::chrono::steady_clock::time_point next_connect_ts_;
+};
+
+struct UringShard {
+  enum class Op : uint8_t { // low bits of user_data
+    ACCEPT = 1,
+    WAKE = 2,
+    ACCEPT_BACKOFF = 6, // timeout before accept is armed again, 3~5 are taken by UringConnection::Op
+  };
+  static constexpr uint64_t MIN_ACCEPT_BACKOFF = 10_ms; // out of fds or memory, accepting again at once would spin
+  static constexpr uint64_t MAX_ACCEPT_BACKOFF = 1_s;
+  struct PostedSend {
+    std::shared_ptr<UringConnection> connection_; // null if not known yet, looked up by endpoint in pool
+    EndPoint endpoint_;
+    OutgoingFrame frame_;
+  };
+  UringShard(const uint32_t idx, const NetConfig &config);
+  ~UringShard();
+  // user_data of an op, pointer is 8 bytes aligned and user space address fits in 48 bits
+  static uint64_t user_data(const void *owner, const uint8_t op, const uint64_t epoch) noexcept {
+    return reinterpret_cast<uint64_t>(owner) | op | (epoch & 0xffff) << 48;
+  }
+  const uint32_t idx_;
+  IoUring ring_;
+  ProvidedBufferRing recv_buffers_;
+  int listen_fd_;
+  int wake_fd_; // eventfd, read is always pending while running
+  uint64_t wake_value_;
+  uint64_t accept_backoff_ns_; // reset by accepted connection
+  __kernel_timespec accept_backoff_; // read by kernel when submitted
+  std::mutex post_lock_;
+  std::vector<PostedSend> posted_sends_;
+  std::vector<std::function<void()>> posted_tasks_; // rare, run before sends posted after them
+  std::vector<PostedSend> running_sends_; // swapped with posted_sends_ by io thread
+  std::vector<std::function<void()>> running_tasks_;
+  std::unordered_map<EndPoint, std::shared_ptr<UringConnection>> connections_; // peers owned by this shard
+  // run to completion only, connections with socket in this shard, so owner worker writes them without posting
+  std::unordered_map<EndPoint, std::shared_ptr<UringConnection>> local_peers_;
+  std::vector<std::shared_ptr<UringConnection>> flush_list_; // connections sent to in this iteration
+  uint64_t inflight_ops_; // submitted and not finished
+  bool stopping_; // draining, no more ops are submitted
+  std::jthread thread_;
+};
+
+/**
+ * @brief UringNetService is net backend on io_uring, one ring per io thread, same protocol and rules as NetService.
+ * 1. each io thread loops: run sends posted by other threads, write frames gathered in this iteration, submit all
+ *    queued sqes and wait for completions in one io_uring_enter, handle completions.
+ * 2. accept and recv are multishot, so a connection keeps one recv armed for it's whole life.
+ * 3. recv picks buffers from a provided buffer ring registered per io thread, memory is not pinned per connection.
+ * 4. with NetConfig::uring_sqpoll_ a kernel thread polls submissions, enter is only called to wait or wake it.
+ * 5. stop cancels every op and waits their completions, so no buffer is used by kernel after wait() returns.
+ * 6. with NetConfig::run_to_completion_ there is no io thread, scheduler worker idx polls shard idx between
+ *    coroutine batches and parks in it's ring. frames woken by it's io run on it, and it's sends are written
+ *    to connections of it's shard without posting, each worker connects to a peer by itself.
+ */
+struct UringNetService : public NetServiceBase {
+  static constexpr bool WORKER_POLL_SUPPORTED = true;
+  UringNetService(uint16_t port, TimeService &time_service) : UringNetService{port, NetConfig{}, time_service} {}
+  UringNetService(uint16_t port, const NetConfig &config, TimeService &time_service); // drives rpc timeouts
+  ~UringNetService() override;
+  void start();
+  void stop() noexcept;
+  void wait() noexcept;
+  uint32_t io_thread_num() const { return static_cast<uint32_t>(shards_.size()); }
+  void attach_worker(const uint32_t idx) override;
+  bool poll_worker(const uint32_t idx, const uint64_t timeout_ns) override;
+  void detach_worker(const uint32_t idx) noexcept override;
+  void wake_worker(const uint32_t idx) noexcept override;
+  // below are called in io threads only
+  void dispatch(UringConnection &connection, const PackageHeader &header, NetBuffer &&net_buffer);
+  void register_connection(const std::shared_ptr<UringConnection> &connection); // accepted connection learned it's peer
+  void remove_connection(const std::shared_ptr<UringConnection> &connection);
+  UringShard &peer_shard(const EndPoint &peer) noexcept { return *shards_[peer.hash() % shards_.size()]; }
+  UringShard &shard(const uint32_t idx) noexcept { return *shards_[idx]; }
+protected:
+  void post_send_(const EndPoint &endpoint, OutgoingFrame &&frame) override;
+private:
+  void post_(UringShard &shard, UringShard::PostedSend &&send);
+  void post_task_(UringShard &shard, std::function<void()> &&task);
+  void wake_(UringShard &shard) noexcept;
+  void listen_(UringShard &shard);
+  void loop_(UringShard &shard);
+  void attach_(UringShard &shard); // arm wake read and accept, by thread driving shard
+  void poll_(UringShard &shard, const uint64_t timeout_ns); // one iteration of io loop
+  void run_posted_(UringShard &shard);
+  void submit_accept_(UringShard &shard);
+  void submit_accept_backoff_(UringShard &shard);
+  void submit_wake_read_(UringShard &shard);
+  void on_completion_(UringShard &shard, const io_uring_cqe &cqe) noexcept;
+  void drain_(UringShard &shard);
+  std::atomic<bool> stop_flag_;
+  std::vector<std::unique_ptr<UringShard>> shards_;
+  friend struct UringConnection;
+};
+
+}
@@ -2,6 +2,8 @@
 #define SRC_COROUTINE_FRAMEWORK_QUEUE_H
 #include <atomic>
 #include <coroutine>
+#include <cstddef>
+#include <new>
 #include <assert.h>
 #include <stdlib.h>
 #include "local_var.h"
@@ -9,6 +11,32 @@
 namespace ToE
 {
 
+struct LatchState;
+struct AdmissionControl;
+
+/**
+ * @brief FrameByteCounter holds coroutine frame bytes allocated(+) and freed(-) by one thread, so frame alloc/free
+ * touches no shared cache line. Counters live in a grow only lock free list and are reused after their thread
+ * exits, process wide sum is only taken by AdmissionControl when max_frame_bytes_ is configured.
+ */
+struct FrameByteCounter {
+  void add(const int64_t bytes) noexcept { bytes_.store(bytes_.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed); }
+  static uint64_t total() noexcept; // bytes of all live coroutine frames in process
+  std::atomic<int64_t> bytes_{0}; // written by owner thread only, may be negative
+  std::atomic<bool> in_use_{false};
+  FrameByteCounter *next_ = nullptr;
+};
+
+struct ThreadFrameBytes { // claims a counter for calling thread, returns it at thread exit
+  ThreadFrameBytes();
+  ~ThreadFrameBytes();
+  void add(const int64_t bytes) noexcept;
+  static void add_orphan(const int64_t bytes) noexcept; // frames freed by thread local dtors after ours
+  FrameByteCounter *counter_;
+};
+
+extern thread_local ThreadFrameBytes TLS_FRAME_BYTES;
+
 struct LinkedCoroutine {
   LinkedCoroutine()
   : prev_{this},
@@ -21,12 +49,16 @@ struct LinkedCoroutine {
   lock_{},
   done_flag_{false},
   cv_{},
-  frame_running_cnt_{nullptr} {};
+  admission_{nullptr},
+  done_latch_{nullptr} {};
   LinkedCoroutine(const LinkedCoroutine &) = delete;
   LinkedCoroutine(LinkedCoroutine &&) = delete;
   LinkedCoroutine &operator=(const LinkedCoroutine &) = delete;
   LinkedCoroutine &operator=(LinkedCoroutine &&) = delete;
   ~LinkedCoroutine();
+  // coroutine frames are allocated through promise_type, counted for admission control
+  static void *operator new(std::size_t size);
+  static void operator delete(void *ptr, std::size_t size) noexcept;
   bool empty() { return prev_ == this; }
   void link_next(LinkedCoroutine &new_coroutine);
   void remove_self();
@@ -43,7 +75,8 @@ struct LinkedCoroutine {
   std::mutex lock_;
   bool done_flag_;
   std::condition_variable cv_;
-  std::atomic<uint64_t> *frame_running_cnt_;
+  AdmissionControl *admission_; // root frame only, released when finished
+  std::atomic<LatchState *> done_latch_; // root frame only, see latch.h
 };
 
 struct CoroutineQueue {
@@ -15,6 +15,24 @@ inline LinkedCoroutine::~LinkedCoroutine() {
   assert(in_queue_link_next_ == nullptr);
 }
 
+inline void ThreadFrameBytes::add(const int64_t bytes) noexcept {
+  if (counter_) [[likely]] {
+    counter_->add(bytes);
+  } else {
+    add_orphan(bytes);
+  }
+}
+
+inline void *LinkedCoroutine::operator new(std::size_t size) {
+  TLS_FRAME_BYTES.add(static_cast<int64_t>(size));
+  return ::operator new(size);
+}
+
+inline void LinkedCoroutine::operator delete(void *ptr, std::size_t size) noexcept {
+  TLS_FRAME_BYTES.add(-static_cast<int64_t>(size));
+  ::operator delete(ptr, size);
+}
+
 inline void LinkedCoroutine::link_next(LinkedCoroutine &new_coroutine) {
   LinkedCoroutine *tmp_next = next_;
   next_ = &new_coroutine;
@@ -1,9 +1,23 @@
 #include "scheduler.h"
+#include <sys/prctl.h>
 
 namespace ToE {
 
 thread_local CommonExecuteModule *TLS_SCHEDULER = nullptr;
-thread_local CoroFrameWork *TLS_FRAMEWORK = nullptr;
+thread_local FrameWorkBase *TLS_FRAMEWORK = nullptr;
+thread_local LocalReadyQueue TLS_LOCAL_READY_QUEUE{};
+
+Expected<void> FrameWorkBase::commit_admitted_(LinkedCoroutine *frame) noexcept {
+  if (stop_flag_.load(std::memory_order_acquire)) [[unlikely]] {
+    admission_.release();
+    return UnExpected{Error::HAS_BEEN_STOPPED};
+  } else {
+    frame->ref_cnt_.inc();
+    frame->admission_ = &admission_;
+    CommonExecuteModule::commit(frame);
+  }
+  return {};
+}
 
 template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
 CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::~CoroScheduler() {
@@ -18,14 +32,19 @@ void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::start() {
     TLS_FRAMEWORK = this;
     time_module_.start();
     net_module_.start();
+    external_park_ = net_module_.worker_polled();
     stop_flag_.store(false, std::memory_order_release);
-    for (int64_t idx = 0; idx < worker_thread_num_; ++idx) {
+    for (uint32_t idx = 0; idx < worker_thread_num_; ++idx) {
       workers_.emplace_back([this,
+                             idx,
                              scheduler = TLS_SCHEDULER,
                              framework = TLS_FRAMEWORK] {
         TLS_SCHEDULER = scheduler;
         TLS_FRAMEWORK = framework;
-        this->loop_();
+        if (time_module_.config().high_resolution_) {
+          ::prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL); // default 50us slack of kernel timer is too coarse
+        }
+        this->loop_(idx);
       });
     }
     TLS_SCHEDULER = nullptr;
@@ -45,7 +64,7 @@ void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::stop() noexce
   stop_flag_.store(true, std::memory_order_release);
   time_module_.stop();
   net_module_.stop();
-  cv_.notify_all();
+  notify_all();
   DEBUG_LOG("CoroScheduler stopped");
 }
 
@@ -62,14 +81,64 @@ void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::wait() noexce
 }
 
 template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
-void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::loop_() noexcept {
+void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::loop_(const uint32_t idx) noexcept {
   CoroutineQueue ready_coroutine_queue;
-  while (!stop_flag_.load(std::memory_order_acquire) || running_coro_cnt_ != 0) [[likely]] {
+  const TimeConfig &time_config = time_module_.config();
+  WorkerTimers timers{this, &time_module_.lateness_stats(), time_module_.precision(), FastClockTime::now()};
+  TLS_WORKER_TIMERS = &timers;
+  bool net_polled = net_module_.worker_polled(); // run to completion, park in net poll until net is stopped
+  if (net_polled) {
+    net_module_.attach_worker(idx);
+  }
+  while (!stop_flag_.load(std::memory_order_acquire) || admission_.running_cnt() != 0) [[likely]] {
+    if (stop_flag_.load(std::memory_order_acquire)) [[unlikely]] {
+      timers.drain(ready_coroutine_queue); // force awake sleeping frames
+    } else {
+      timers.expire(CoarseClockTime::update_local(FastClockTime::now()), ready_coroutine_queue);
+    }
+    consume_ready_coroutine_(ready_coroutine_queue); // expired on the core armed them
     {
+      uint64_t park_ns = (2000 + random_gen_.gen()/*0-1000*/) * 1_ms;
+      uint64_t next_deadline = timers.next_deadline();
+      if (next_deadline != UINT64_MAX) {
+        uint64_t now = FastClockTime::now();
+        park_ns = next_deadline > now ? std::min(park_ns, next_deadline - now) : 0;
+        if (time_config.high_resolution_) { // wake spin_ns_ earlier and spin in loop
+          park_ns = park_ns > time_config.spin_ns_ ? park_ns - time_config.spin_ns_ : 0;
+        }
+      }
+      if (net_polled) {
+        bool park = false;
+        {
+          std::unique_lock lk(lock_);
+          if (!coroutine_queue_.empty()) {
+            ready_coroutine_queue.append_to_tail(coroutine_queue_.pop_from_head());
+          } else if (park_ns != 0 && !stop_flag_.load(std::memory_order_acquire) && !timers.has_remote_cancel()) {
+            park = true; // committer sees it after it's own commit under lock_, see wake_external_()
+            parked_workers_[idx].store(true, std::memory_order_relaxed);
+          }
+        }
+        TLS_LOCAL_READY_QUEUE = LocalReadyQueue{this, &ready_coroutine_queue}; // woken by io, run here
+        net_polled = net_module_.poll_worker(idx, park ? park_ns : 0);
+        TLS_LOCAL_READY_QUEUE = LocalReadyQueue{};
+        parked_workers_[idx].store(false, std::memory_order_relaxed);
+        consume_ready_coroutine_(ready_coroutine_queue);
+        continue;
+      }
+      if (park_ns == 0 && next_deadline != UINT64_MAX) { // due within spin_ns_, spin on clock without lock_, commits wait at most that long
+        while (FastClockTime::now() < next_deadline && !stop_flag_.load(std::memory_order_acquire)
+               && !timers.has_remote_cancel()) {
+#if defined(__x86_64__)
+          _mm_pause();
+#endif
+        }
+      }
       std::unique_lock lk(lock_);
       cv_.wait_for(lk,
-        std::chrono::milliseconds(2000 + random_gen_.gen()/*0-1000*/),
-        [this] noexcept { return !coroutine_queue_.empty() || stop_flag_.load(std::memory_order_acquire); });
+        std::chrono::nanoseconds(park_ns),
+        [this, &timers] noexcept {
+          return !coroutine_queue_.empty() || stop_flag_.load(std::memory_order_acquire) || timers.has_remote_cancel();
+        });
       // while (!coroutine_queue_.empty()) [[likely]]
       if (!coroutine_queue_.empty()) [[likely]] {
         ready_coroutine_queue.append_to_tail(coroutine_queue_.pop_from_head());
@@ -77,6 +146,23 @@ void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::loop_() noexc
     }
     consume_ready_coroutine_(ready_coroutine_queue);
   }
+  if (net_module_.worker_polled()) {
+    net_module_.detach_worker(idx);
+  }
+  TLS_WORKER_TIMERS = nullptr;
+}
+
+template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
+void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::wake_external_(const bool all) noexcept {
+  for (uint32_t idx = 0; idx < worker_thread_num_; ++idx) {
+    if (parked_workers_[idx].load(std::memory_order_relaxed) && parked_workers_[idx].exchange(false)) {
+      net_module_.wake_worker(idx);
+      if (!all) {
+        return;
+      }
+    }
+  }
+  cv_.notify_all(); // none parked in net poll, some may wait on cv_ once net is stopped
 }
 
 template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
@@ -90,6 +176,7 @@ void CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::consume_ready
   }
 }
 
-template struct CoroScheduler<UsedTimeModule, UsedLockModule, UsedNetModule, UsedDiskModule>;
+template struct CoroScheduler<UsedTimeModule, UsedLockModule, NetService, UsedDiskModule>;
+template struct CoroScheduler<UsedTimeModule, UsedLockModule, UringNetService, UsedDiskModule>;
 
 }
\ No newline at end of file
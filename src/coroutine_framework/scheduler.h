@@ -1,11 +1,17 @@
 #pragma once
 #include "task.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <random>
 #include "common_execute_module.h"
+#include "admission.h"
 #include "time_module/time_service.h"
+#include "time_module/worker_timers.h"
 #include "net_module/net_service.h"
+#include "net_module/uring_net_service.h"
 
 namespace ToE
 {
@@ -19,56 +25,102 @@ struct RandomGenerator {
   std::uniform_int_distribution<> dis_;
 };
 
+/**
+ * @brief FrameWorkBase is the part of CoroScheduler not depending on it's modules.
+ * async actions and rpc handlers reach framework of their thread through TLS_FRAMEWORK, so the same code serves
+ * every net backend, schedulers of both backends can run in one process.
+ */
+struct FrameWorkBase : public CommonExecuteModule {
+  FrameWorkBase()
+  : CommonExecuteModule{}, stop_flag_{true}, admission_{this}, time_service_{nullptr}, net_service_{nullptr} {}
+  template <typename Ret>
+  Expected<void> commit_admitted(CoroTask<Ret> &new_task) noexcept { // slot has been acquired from admission control
+    return commit_admitted_(new_task.promise_);
+  }
+  void set_admission_config(const AdmissionConfig &config) noexcept { admission_.set_config(config); }
+  AdmissionControl &get_admission() noexcept { return admission_; }
+  TimeService &get_time_module() noexcept { return *time_service_; }
+  NetServiceBase &get_net_module() noexcept { return *net_service_; }
+protected:
+  Expected<void> commit_admitted_(LinkedCoroutine *frame) noexcept;
+  std::atomic<bool> stop_flag_;
+  AdmissionControl admission_;
+  TimeService *time_service_; // set by CoroScheduler once it's modules are constructed
+  NetServiceBase *net_service_;
+};
+
+extern thread_local FrameWorkBase *TLS_FRAMEWORK;
+
 template <typename TimeModule, // for async sleep operatoin
           typename LockModule, // for async lock operation
           typename NetModule, // for async network operation
           typename DiskModule> // for async disk operation
-struct CoroScheduler : public CommonExecuteModule {
+struct CoroScheduler : public FrameWorkBase {
   CoroScheduler(const uint32_t worker_thread_num = 1)
   : CoroScheduler{worker_thread_num, 8888} {}
   CoroScheduler(const uint32_t worker_thread_num, uint16_t port)
-  : CommonExecuteModule{},
-  time_module_{1_ms},
-  net_module_{port},
+  : CoroScheduler{worker_thread_num, port, TimeConfig{}} {}
+  CoroScheduler(const uint32_t worker_thread_num, uint16_t port, const TimeConfig &time_config)
+  : CoroScheduler{worker_thread_num, port, time_config, NetConfig{}} {}
+  CoroScheduler(const uint32_t worker_thread_num, uint16_t port, const TimeConfig &time_config, const NetConfig &net_config)
+  : FrameWorkBase{},
+  time_module_{time_config},
+  net_module_{port, worker_net_config_(net_config, worker_thread_num), time_module_},
   workers_{},
   worker_thread_num_{worker_thread_num},
-  stop_flag_{true},
-  running_coro_cnt_{0},
-  random_gen_{0, 1000} { start(); }
-  ~CoroScheduler();
+  parked_workers_{std::make_unique<std::atomic<bool>[]>(worker_thread_num)},
+  random_gen_{0, 1000} {
+    time_service_ = &time_module_;
+    net_service_ = &net_module_;
+    start();
+  }
+  ~CoroScheduler() override;
   void start();
   void stop() noexcept;
   void wait() noexcept;
   template <typename Ret>
-  Expected<void> commit(CoroTask<Ret> &&new_task) noexcept; // for first time schedule root frame
+  struct SpawnAwaitable { // co_await framework.spawn(task), suspend caller until admitted
+    bool await_ready() noexcept { return framework_->admission_.try_acquire(); }
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+    Expected<void> await_resume() noexcept { return framework_->commit_admitted(task_); }
+    CoroScheduler *framework_;
+    CoroTask<Ret> task_;
+  };
+  template <typename Ret>
+  Expected<void> commit(CoroTask<Ret> &&new_task) noexcept; // for first time schedule root frame, fail fast if busy
   template <typename Ret>
-  Expected<void> commit(CoroTask<Ret> &new_task) noexcept; // for first time schedule root frame
+  Expected<void> commit(CoroTask<Ret> &new_task) noexcept; // for first time schedule root frame, fail fast if busy
+  template <typename Ret>
+  SpawnAwaitable<Ret> spawn(CoroTask<Ret> new_task) noexcept { return {this, std::move(new_task)}; }
   TimeModule &get_time_module() noexcept { return time_module_; }
   NetModule &get_net_module() noexcept { return net_module_; }
 private:
-  void loop_() noexcept;
+  static NetConfig worker_net_config_(const NetConfig &config, const uint32_t worker_thread_num) noexcept {
+    NetConfig worker_config = config; // shard per worker, polled by it
+    if (NetModule::WORKER_POLL_SUPPORTED && config.run_to_completion_) {
+      worker_config.io_thread_num_ = std::max(worker_thread_num, 1U);
+    } else {
+      worker_config.run_to_completion_ = false;
+    }
+    return worker_config;
+  }
+  void loop_(const uint32_t idx) noexcept;
   void consume_ready_coroutine_(CoroutineQueue &ready_queue) noexcept;
+  void wake_external_(const bool all) noexcept override; // workers parked in net poll
+
   TimeModule time_module_;
   NetModule net_module_;
   std::vector<std::jthread> workers_;
   uint32_t worker_thread_num_;
-  std::atomic<bool> stop_flag_;
-  std::atomic<uint64_t> running_coro_cnt_;
+  std::unique_ptr<std::atomic<bool>[]> parked_workers_; // parked in net poll, cleared by whom wakes it
   RandomGenerator random_gen_;
 };
 
 template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
 template <typename Ret>
 Expected<void> CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::commit(CoroTask<Ret> &&new_task) noexcept {
-  if (stop_flag_.load(std::memory_order_acquire)) [[unlikely]] {
-    return UnExpected{Error::HAS_BEEN_STOPPED};
-  } else {
-    new_task.promise_->ref_cnt_.inc();
-    running_coro_cnt_++;
-    new_task.promise_->frame_running_cnt_ = &running_coro_cnt_;
-    CommonExecuteModule::commit(new_task.promise_);
-  }
-  return {};
+  return commit(new_task);
 }
 
 template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
@@ -76,13 +128,19 @@ template <typename Ret>
 Expected<void> CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::commit(CoroTask<Ret> &new_task) noexcept {
   if (stop_flag_.load(std::memory_order_acquire)) [[unlikely]] {
     return UnExpected{Error::HAS_BEEN_STOPPED};
-  } else {
-    new_task.promise_->ref_cnt_.inc();
-    running_coro_cnt_++;
-    new_task.promise_->frame_running_cnt_ = &running_coro_cnt_;
-    CommonExecuteModule::commit(new_task.promise_);
+  } else if (!admission_.try_acquire()) [[unlikely]] {
+    return UnExpected{Error::BUSY};
   }
-  return {};
+  return commit_admitted(new_task);
+}
+
+template <typename TimeModule,  typename LockModule,  typename NetModule,  typename DiskModule>
+template <typename Ret>
+template <typename Promise>
+bool CoroScheduler<TimeModule, LockModule, NetModule, DiskModule>::SpawnAwaitable<Ret>::await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+  LinkedCoroutine *frame = &handle.promise();
+  frame->sync_release();
+  return !framework_->admission_.acquire_or_wait(frame); // once queued, frame may be resumed by other thread at once
 }
 
 inline void GlobalInit(LogLevel level) {
@@ -92,11 +150,17 @@ inline void GlobalInit(LogLevel level) {
 
 using UsedTimeModule = TimeService;
 using UsedLockModule = int;
+#ifdef TOE_NET_IO_URING
+using UsedNetModule = UringNetService; // built with xmake f --io_uring=y
+#else
 using UsedNetModule = NetService;
+#endif
 using UsedDiskModule = int;
-extern template struct CoroScheduler<UsedTimeModule, UsedLockModule, UsedNetModule, UsedDiskModule>;
+// both backends are instantiated, net module of a framework is chosen by it's type, CoroFrameWork is the default one
+extern template struct CoroScheduler<UsedTimeModule, UsedLockModule, NetService, UsedDiskModule>;
+extern template struct CoroScheduler<UsedTimeModule, UsedLockModule, UringNetService, UsedDiskModule>;
+using AsioFrameWork = CoroScheduler<UsedTimeModule, UsedLockModule, NetService, UsedDiskModule>;
+using UringFrameWork = CoroScheduler<UsedTimeModule, UsedLockModule, UringNetService, UsedDiskModule>;
 using CoroFrameWork = CoroScheduler<UsedTimeModule, UsedLockModule, UsedNetModule, UsedDiskModule>;
 
-extern thread_local CoroFrameWork *TLS_FRAMEWORK;
-
 }
\ No newline at end of file
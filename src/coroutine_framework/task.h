@@ -5,21 +5,23 @@
 #include <type_traits>
 #include <utility>
 #include <stdlib.h>
+#include "coroutine_framework/admission.h"
+#include "coroutine_framework/latch.h"
 #include "coroutine_framework/local_var.h"
 #include "coroutine_framework/net_module/net_define.h"
 #include "queue.h"
 
 namespace ToE {
 
-void send_result_to_caller(const EndPoint &, NetBuffer &&);
-void prepare_buffer(const ResponseInfo &response_info,
-                    const uint64_t payload_len,
-                    NetBuffer &net_buffer,
-                    int64_t &pos);
+void send_result_to_caller(const ResponseInfo &response_info, NetBuffer &&payload); // header is added by net module
+void finish_rpc_handler(const ResponseInfo &response_info, CancelState *cancel_state);
 
 template  <typename Ret, typename = void>
 class CoroPromise;
 
+template <typename Ret>
+void reply_to_caller(LinkedCoroutine *frame, const ResponseInfo &response_info);
+
 template <typename CoroTask>
 concept ValidCoroTask = requires {
   typename CoroTask::return_type;
@@ -48,6 +50,7 @@ struct CoroTask {
   bool done();
   void wait();
   void reset() noexcept;
+  CoroTask<Ret> &bind_cancellation(const CancellationToken &token); // only for root frame, before commit
   template <typename U = Ret>
   auto get_result() -> std::enable_if_t<!std::is_void_v<U>, U&>;
   struct GetPromiseOp {
@@ -72,10 +75,28 @@ struct MiddleAwaitable { // 用于协程函数在中间挂起的处理
   MiddleAwaitable(CoroTask<MiddleResult> &&task) : task_{std::move(task)} {}
   constexpr bool await_ready() noexcept { return false; }
   std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept { return task_.promise_->handle_; }
-  MiddleResult await_resume() noexcept { return task_.promise_->result_; }
+  MiddleResult await_resume() noexcept;
   CoroTask<MiddleResult> task_;
 };
 
+// co_await操作数的统一转换, CoroPromise与AsyncGeneratorPromise共用
+template <typename ASYNC>
+auto transform_awaitable(LinkedCoroutine &frame, ASYNC &&task) {
+  if constexpr (ValidCoroTask<ASYNC>) { // 协程链式调用
+    // linking a child is not a cancellation point: child has no way to produce Ret without running, so it
+    // still runs when chain is cancelled and its first cancel aware await(co_sleep/co_rpc) returns CANCELED,
+    // cpu bound children should poll co_cancel_token themselves
+    frame.link_next(*task.promise_);
+    task.promise_->coro_local_var_ = frame.coro_local_var_;
+    return MiddleAwaitable<typename ASYNC::return_type>{std::move(task)};
+  } else { // 异步动作调用
+    if constexpr (CancelAware<ASYNC>) { // 取消检查
+      task.bind_cancel_state(frame.coro_local_var_->cancel_token_.state_);
+    }
+    return std::forward<ASYNC>(task);
+  }
+}
+
 template <typename Ret>
 struct FinalAwaitable { // 用于协程函数在最终挂起的处理
   constexpr bool await_ready() const noexcept { return false; }
@@ -96,43 +117,32 @@ struct CoroPromise<Ret, std::enable_if_t<std::is_same_v<Ret, void>, void>> : pub
   FinalAwaitable<Ret> final_suspend() noexcept { return {*this}; }
   void unhandled_exception() { std::abort(); }
   auto get_return_object() { return CoroTask{std::coroutine_handle<CoroPromise<Ret>>::from_promise(*this)}; }
-  template <typename CoroTask>
-  auto await_transform(CoroTask &&task) {
-    if constexpr (ValidCoroTask<CoroTask>) {
-      link_next(*task.promise_);
-      task.promise_->coro_local_var_ = coro_local_var_;
-      return MiddleAwaitable<typename CoroTask::return_type>{std::move(task)};
-    } else {
-      return std::forward<CoroTask>(task);
-    }
-  }
+  template <typename ASYNC>
+  auto await_transform(ASYNC &&task) { return transform_awaitable(*this, std::forward<ASYNC>(task)); }
   void return_void() {}
 };
 
 template <typename Ret>
 struct CoroPromise<Ret, std::enable_if_t<!std::is_same_v<Ret, void>, void>> : public LinkedCoroutine {
-  CoroPromise() : LinkedCoroutine{} { handle_ = std::coroutine_handle<CoroPromise<Ret>>::from_promise(*this); }
+  CoroPromise() : LinkedCoroutine{}, has_result_{false} { handle_ = std::coroutine_handle<CoroPromise<Ret>>::from_promise(*this); }
   CoroPromise(const CoroPromise<Ret> &) = delete; // disallow copy
   CoroPromise<Ret> &operator=(const CoroPromise<Ret> &) = delete; // disallow copy
   CoroPromise(CoroPromise<Ret> &&) = delete; // disallow move
   CoroPromise<Ret> &operator=(CoroPromise<Ret> &&) = delete; // disallow move
-  ~CoroPromise() {}
+  ~CoroPromise() { if (has_result_) { result_.~Ret(); } }
   InitialAwaitable<Ret> initial_suspend() noexcept { return {this}; }
   FinalAwaitable<Ret> final_suspend() noexcept { return {*this}; }
   void unhandled_exception() { std::abort(); }
   auto get_return_object() { return CoroTask{std::coroutine_handle<CoroPromise<Ret>>::from_promise(*this)}; }
   template <typename ASYNC>
-  auto await_transform(ASYNC &&task) {
-    if constexpr (ValidCoroTask<ASYNC>) { // 协程链式调用
-      link_next(*task.promise_);
-      task.promise_->coro_local_var_ = coro_local_var_;
-      return MiddleAwaitable<typename ASYNC::return_type>{std::move(task)};
-    } else { // 异步动作调用
-      return std::forward<ASYNC>(task);
-    }
+  auto await_transform(ASYNC &&task) { return transform_awaitable(*this, std::forward<ASYNC>(task)); }
+  template <typename U = Ret>
+  void return_value(U &&result) { // construct in place, Ret need not be default-constructible
+    new (&result_) Ret(std::forward<U>(result));
+    has_result_ = true;
   }
-  void return_value(Ret result) { result_ = std::move(result); }
-  Ret result_;
+  union { Ret result_; }; // uninitialized until co_return, moved out by MiddleAwaitable
+  bool has_result_;
 };
 
 }
@@ -22,8 +22,11 @@ CoroTask<Ret>::CoroTask(const CoroTask<Ret> &rhs) {
 template <typename Ret>
 CoroTask<Ret> &CoroTask<Ret>::operator=(const CoroTask<Ret> &rhs) {
   if (this != &rhs) [[likely]] {
+    if (rhs.promise_) {
+      ((LinkedCoroutine *)rhs.promise_)->ref_cnt_.inc();
+    }
+    this->~CoroTask();
     promise_ = rhs.promise_;
-    ((LinkedCoroutine *)promise_)->ref_cnt_.inc();
   }
   return *this;
 }
@@ -34,6 +37,8 @@ CoroTask<Ret>::CoroTask(CoroTask<Ret> &&rhs) : promise_{rhs.promise_} { rhs.prom
 template <typename Ret>
 CoroTask<Ret> &CoroTask<Ret>::operator=(CoroTask<Ret> &&rhs) {
   if (this != &rhs) [[likely]] {
+    this->~CoroTask();
+    promise_ = rhs.promise_;
     rhs.promise_ = nullptr;
   }
   return *this;
@@ -49,6 +54,15 @@ void CoroTask<Ret>::wait() {
 template <typename Ret>
 void CoroTask<Ret>::reset() noexcept { promise_ = nullptr; }
 
+template <typename Ret>
+CoroTask<Ret> &CoroTask<Ret>::bind_cancellation(const CancellationToken &token) {
+  if (nullptr == promise_->coro_local_var_) {
+    promise_->coro_local_var_ = new CoroLocalVar{promise_->ref_cnt_};
+  }
+  promise_->coro_local_var_->cancel_token_ = token;
+  return *this;
+}
+
 template <typename Ret>
 constexpr bool CoroTask<Ret>::GetPromiseOp::await_ready() noexcept { return false; }
 
@@ -63,7 +77,7 @@ CoroTask<Ret>::promise_type* CoroTask<Ret>::GetPromiseOp::await_resume() noexcep
 
 template <typename Ret>
 CoroTask<Ret>::~CoroTask() {
-  if (promise_ && promise_->ref_cnt_.dec() == 0) {
+  if (promise_ && promise_->ref_cnt_.dec() == 1) { // dec() returns the value before decrement
     promise_->handle_.destroy();
   }
 }
@@ -80,6 +94,14 @@ auto CoroTask<Ret>::get_result() -> std::enable_if_t<!std::is_void_v<U>, U&> {
   return promise_->result_;
 }
 
+template <typename MiddleResult>
+MiddleResult MiddleAwaitable<MiddleResult>::await_resume() noexcept {
+  if constexpr (!std::is_void_v<MiddleResult>) {
+    assert(task_.promise_->has_result_);
+    return std::move(task_.promise_->result_); // child frame will not read result again, move it out
+  }
+}
+
 template <typename Ret>
 void InitialAwaitable<Ret>::await_resume() const noexcept {
   if (nullptr == promise_->coro_local_var_) [[unlikely]] {
@@ -87,6 +109,16 @@ void InitialAwaitable<Ret>::await_resume() const noexcept {
   }
 }
 
+template <typename Ret>
+void reply_to_caller(LinkedCoroutine *frame, const ResponseInfo &response_info) {
+  if constexpr (!std::is_void_v<Ret>) {
+    CoroPromise<Ret> &promise = *static_cast<CoroPromise<Ret> *>(frame);
+    NetBuffer payload(Serializer<Ret>::get_serialize_size(promise.result_));
+    Serializer<Ret>::serialize(promise.result_, payload.buffer_, payload.buffer_len_);
+    send_result_to_caller(response_info, std::move(payload));
+  }
+}
+
 template <typename Ret>
 std::coroutine_handle<> FinalAwaitable<Ret>::await_suspend(std::coroutine_handle<> this_coro) const noexcept {
   std::coroutine_handle<> ret = std::noop_coroutine(); // noop协程的resume动作不会导致未定义行为，线程控制权将直接返回caller
@@ -94,29 +126,27 @@ std::coroutine_handle<> FinalAwaitable<Ret>::await_suspend(std::coroutine_handle
     ret = promise_.prev_->handle_;
     promise_.remove_self();
   } else {
-    if (promise_.frame_running_cnt_) [[likely]] {
-      (*promise_.frame_running_cnt_)--;
+    if (promise_.admission_) [[likely]] {
+      promise_.admission_->release();
     }
     if (promise_.coro_local_var_ && promise_.coro_local_var_->response_info_) [[unlikely]] {
       const ResponseInfo &response_info = *promise_.coro_local_var_->response_info_;
-      if constexpr (!std::is_void_v<Ret>) {
-        int64_t serialize_size = Serializer<Ret>::get_serialize_size(promise_.result_);
-        NetBuffer buffer;
-        int64_t pos = 0;
-        prepare_buffer(response_info, serialize_size, buffer, pos);
-        Serializer<Ret>::serialize(promise_.result_, buffer.buffer_, buffer.buffer_len_, pos);
-        send_result_to_caller(response_info.response_to_end_point_, std::move(buffer));
+      const CancellationToken &cancel_token = promise_.coro_local_var_->cancel_token_;
+      if (!cancel_token.is_cancelled()) [[likely]] { // caller has given up the result, no need to reply
+        response_info.reply_(&promise_, response_info);
       }
+      finish_rpc_handler(response_info, cancel_token.state_);
     } else {
       std::unique_lock<std::mutex> lg(promise_.lock_);
       promise_.done_flag_ = true;
       promise_.cv_.notify_all();
       DEBUG_LOG("notify");
     }
+    notify_frame_latch(&promise_); // wait_all/wait_any/TaskGroup
     delete promise_.coro_local_var_;
     promise_.coro_local_var_ = nullptr;
     assert(this_coro.done() == true);
-    if (promise_.ref_cnt_.dec() == 0) {
+    if (promise_.ref_cnt_.dec() == 1) {
       promise_.handle_.destroy();
     }
   }
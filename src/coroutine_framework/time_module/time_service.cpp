@@ -1,6 +1,15 @@
 #include "time_service.h"
 #include "coroutine_framework/scheduler.h"
 #include "log/logger.h"
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
 namespace ToE
 {
@@ -17,13 +26,64 @@ uint64_t SteadyClockTime::now() noexcept {
   return ns_timestamp;
 }
 
+FastClockTime::TscCalibration FastClockTime::calibrate_() noexcept {
+  TscCalibration ret{0, SteadyClockTime::now(), 0};
+#if defined(__x86_64__)
+  uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1U << 8))) { // invariant TSC
+    uint64_t start_ns = SteadyClockTime::now();
+    uint64_t start_tsc = __rdtsc();
+    uint64_t end_ns = start_ns;
+    while (end_ns - start_ns < 10_ms) {
+      end_ns = SteadyClockTime::now();
+    }
+    uint64_t end_tsc = __rdtsc();
+    if (end_tsc > start_tsc) [[likely]] {
+      ret.mult_ = static_cast<uint64_t>((static_cast<unsigned __int128>(end_ns - start_ns) << 32) / (end_tsc - start_tsc));
+      ret.base_tsc_ = end_tsc;
+      ret.base_ns_ = end_ns;
+    }
+  }
+#endif
+  return ret;
+}
+
+uint64_t CoarseClockTime::update(const uint64_t now) noexcept {
+  uint64_t current = NOW_NS.load(std::memory_order_relaxed);
+  while (now > current && !NOW_NS.compare_exchange_weak(current, now, std::memory_order_relaxed)) {}
+  return std::max(now, current);
+}
+
+TimeService::~TimeService() {
+  if (timer_fd_ >= 0) {
+    ::close(timer_fd_);
+  }
+  if (event_fd_ >= 0) {
+    ::close(event_fd_);
+  }
+}
+
 void TimeService::start() {
+  uint64_t now_tick = FastClockTime::now() / precision_;
+  for (auto &shard : shards_) {
+    shard.wheel_.reset(now_tick);
+  }
+  if (config_.high_resolution_ && timer_fd_ < 0) {
+    timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (timer_fd_ < 0 || event_fd_ < 0) [[unlikely]] {
+      throw std::runtime_error("create timerfd or eventfd failed");
+    }
+  }
   stop_flag_.store(false, std::memory_order_release);
   loop_thread_ = std::jthread([this,
                                   scheduler = TLS_SCHEDULER,
                                   framework = TLS_FRAMEWORK] {
     TLS_SCHEDULER = scheduler;
     TLS_FRAMEWORK = framework;
+    if (config_.high_resolution_) {
+      ::prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL); // default 50us slack of kernel timer is too coarse
+    }
     this->loop_();
   });
   DEBUG_LOG("TimeService started");
@@ -31,7 +91,7 @@ void TimeService::start() {
 
 void TimeService::stop() noexcept {
   stop_flag_.store(true, std::memory_order_release);
-  cv_.notify_all();
+  notify_();
   DEBUG_LOG("TimeService stopped");
 }
 
@@ -42,72 +102,294 @@ void TimeService::wait() noexcept {
   DEBUG_LOG("TimeService joinded");
 }
 
-void TimeService::register_frame(LinkedCoroutine *frame) noexcept {
-  const uint64_t wake_up_ts = frame->coro_local_var_->wake_up_ts_;
-  const uint64_t start_bukcet_run_ts = start_bukcet_run_ts_.load(std::memory_order_acquire);
-  bool miss_awaken = false;
-  if (start_bukcet_run_ts >= wake_up_ts) [[unlikely]] {
-    miss_awaken = true;
-  } else {
-    const uint64_t calculated_bucket_idx = ((wake_up_ts - start_bukcet_run_ts) - 1) / precision_ + 1; // ceil
-    const uint64_t real_bucket_idx = (calculated_bucket_idx & (BUCKET_NUM - 1));
-    TimeWheelBucket &bucket = buckets_[real_bucket_idx];
-    {
-      std::lock_guard<ByteSpinLock> lg(bucket.lock_);
-      if (bucket.scan_over_ts_ >= wake_up_ts) [[unlikely]] {
-        miss_awaken = true;
-      } else {
-        bucket.waiting_queue_.append_to_tail(frame);
+uint32_t TimeService::pick_shard() const noexcept {
+  static std::atomic<uint32_t> NEXT_SHARD{0};
+  thread_local uint32_t TLS_SHARD = NEXT_SHARD.fetch_add(1, std::memory_order_relaxed) % SHARD_NUM;
+  return TLS_SHARD;
+}
+
+void TimeService::register_timer(TimerNode *node, const uint64_t slack) noexcept {
+  CancellationToken &cancel_token = node->frame_->coro_local_var_->cancel_token_;
+  ArmResult result = arm_(node, node->deadline_, slack, cancel_token.state_);
+  if (result != ArmResult::ARMED) [[unlikely]] {
+    fire_(node, result == ArmResult::CANCELED);
+  }
+}
+
+bool TimeService::unregister_timer(TimerNode *node) noexcept {
+  bool removed = false;
+  WheelShard &shard = shards_[node->shard_];
+  {
+    std::lock_guard<ByteSpinLock> lg(shard.lock_);
+    removed = shard.wheel_.remove(node);
+  }
+  if (removed) {
+    node->frame_->sync_acquire();
+  }
+  return removed;
+}
+
+TimeService::ArmResult TimeService::arm_(TimerNode *node, const uint64_t deadline, const uint64_t slack, const CancelState *cancel_state) noexcept {
+  ArmResult ret = ArmResult::ARMED;
+  const uint64_t expire_tick = expire_tick_(deadline, slack);
+  WheelShard &shard = shards_[node->shard_];
+  {
+    std::lock_guard<ByteSpinLock> lg(shard.lock_);
+    // check cancel flag with shard lock held, cancel action will find node in wheel or see it awaken here
+    if (node->linked()) [[unlikely]] {
+      ret = ArmResult::ALREADY_ARMED;
+    } else if (cancel_state && cancel_state->is_cancelled()) [[unlikely]] {
+      ret = ArmResult::CANCELED;
+    } else {
+      node->deadline_ = deadline;
+      node->expire_tick_ = expire_tick;
+      // elapsed tick of idle wheel lags behind in tickless loop, so compare with clock too
+      if (deadline <= FastClockTime::now() || !shard.wheel_.insert(node)) [[unlikely]] {
+        ret = ArmResult::EXPIRED;
       }
     }
   }
-  if (miss_awaken) [[unlikely]] {
-    frame->sync_acquire();
-    TLS_SCHEDULER->commit(frame);
+  if (ret == ArmResult::ARMED) [[likely]] {
+    lower_wakeup_tick_(expire_tick); // node may be awaken already, do not access it
   }
+  return ret;
 }
 
-void TimeService::loop_() noexcept {
-  uint64_t idx = 0;
-  do {
-    idx = ((idx + 1) & (BUCKET_NUM - 1)); // round-robin
-    if (idx == 0) [[unlikely]] {
-      start_bukcet_run_ts_.store(SteadyClockTime::now(), std::memory_order_release);
+bool TimeService::cancel_(TimerNode *node) noexcept {
+  bool removed = false;
+  WheelShard &shard = shards_[node->shard_];
+  {
+    std::lock_guard<ByteSpinLock> lg(shard.lock_);
+    removed = shard.wheel_.remove(node);
+  }
+  if (removed) {
+    fire_(node, true);
+  }
+  return removed;
+}
+
+bool TimeService::reschedule_(TimerNode *node, const uint64_t deadline, const uint64_t slack) noexcept {
+  bool ret = false;
+  bool expired = false;
+  const uint64_t expire_tick = expire_tick_(deadline, slack);
+  WheelShard &shard = shards_[node->shard_];
+  {
+    std::lock_guard<ByteSpinLock> lg(shard.lock_);
+    if (shard.wheel_.remove(node)) {
+      ret = true;
+      node->deadline_ = deadline;
+      node->expire_tick_ = expire_tick;
+      expired = !shard.wheel_.insert(node);
     }
-    wakeup_frame_on_bucket_(idx);
-    uint64_t now = SteadyClockTime::now();
-    uint64_t next_run_ts = start_bukcet_run_ts_ + (precision_ * (idx + 1));
-    if (now >= next_run_ts) {
-      continue;
+  }
+  if (expired) [[unlikely]] {
+    fire_(node, false);
+  } else if (ret) {
+    lower_wakeup_tick_(expire_tick);
+  }
+  return ret;
+}
+
+bool TimeService::armed_(TimerNode *node) noexcept {
+  WheelShard &shard = shards_[node->shard_];
+  std::lock_guard<ByteSpinLock> lg(shard.lock_);
+  return node->linked();
+}
+
+void TimeService::fire_(TimerNode *node, const bool cancelled) noexcept {
+  if (node->callback_) {
+    node->callback_->on_timer(cancelled);
+  } else {
+    node->frame_->sync_acquire();
+    TLS_SCHEDULER->commit(node->frame_);
+  }
+}
+
+void TimeService::lower_wakeup_tick_(const uint64_t tick) noexcept {
+  uint64_t current = next_wakeup_tick_.load(std::memory_order_seq_cst);
+  while (tick < current) [[unlikely]] {
+    if (next_wakeup_tick_.compare_exchange_weak(current, tick, std::memory_order_seq_cst)) {
+      notify_();
+      break;
+    }
+  }
+}
+
+void TimeService::notify_() noexcept {
+  if (event_fd_ >= 0) {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t ret = ::write(event_fd_, &one, sizeof(one)); // counter persists, no lost wakeup
+  }
+  { // high resolution park falls back to cv when timerfd fails
+    std::lock_guard<std::mutex> lg(lock_); // pairs with predicate check of loop thread, avoid lost wakeup
+  }
+  cv_.notify_all();
+}
+
+void TimeService::loop_() noexcept {
+  while (!stop_flag_.load(std::memory_order_acquire)) [[likely]] {
+    uint64_t now = CoarseClockTime::update(FastClockTime::now());
+    // reset before scanning wheels, timer armed since here either is found by scan or lowers it
+    next_wakeup_tick_.store(UINT64_MAX, std::memory_order_seq_cst);
+    uint64_t next_tick = expire_timers_(now);
+    uint64_t wakeup_tick = next_wakeup_tick_.load(std::memory_order_seq_cst);
+    while (next_tick < wakeup_tick && !next_wakeup_tick_.compare_exchange_weak(wakeup_tick, next_tick, std::memory_order_seq_cst)) {}
+    wakeup_tick = std::min(wakeup_tick, next_tick);
+    if (config_.high_resolution_) {
+      park_high_resolution_(wakeup_tick, now);
     } else {
-      std::unique_lock<std::mutex> lock(lock_);
-      cv_.wait_for(lock, std::chrono::nanoseconds(next_run_ts - now),
-                   [this, next_run_ts] noexcept { return stop_flag_.load(std::memory_order_acquire) || SteadyClockTime::now() > next_run_ts; });
+      park_(wakeup_tick, now);
     }
-  } while (!stop_flag_.load(std::memory_order_acquire));
-  for (uint64_t idx = 0; idx < BUCKET_NUM; ++idx) {
-    wakeup_frame_on_bucket_(idx, true); // force awake all frames on bucket
   }
+  expire_timers_(0, true); // force awake all frames on wheel
 }
 
-void TimeService::wakeup_frame_on_bucket_(const uint64_t idx, const bool force_awake) noexcept {
+void TimeService::park_(const uint64_t wakeup_tick, const uint64_t now) noexcept {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto pred = [this, wakeup_tick] noexcept {
+    return stop_flag_.load(std::memory_order_acquire) || next_wakeup_tick_.load(std::memory_order_seq_cst) < wakeup_tick;
+  };
+  if (wakeup_tick == UINT64_MAX) { // no timer at all, park until armed
+    cv_.wait(lock, pred);
+  } else if (wakeup_tick * precision_ > now) {
+    cv_.wait_for(lock, std::chrono::nanoseconds(wakeup_tick * precision_ - now), pred);
+  }
+}
+
+bool TimeService::drain_fd_(const int fd) noexcept {
+  uint64_t counter = 0;
+  ssize_t ret = ::read(fd, &counter, sizeof(counter));
+  return ret == sizeof(counter) || (ret < 0 && errno == EAGAIN); // not readable if other fd woke us
+}
+
+void TimeService::park_high_resolution_(const uint64_t wakeup_tick, const uint64_t now) noexcept {
+  const uint64_t deadline = wakeup_tick == UINT64_MAX ? UINT64_MAX : wakeup_tick * precision_;
+  if (deadline > now + config_.spin_ns_) {
+    itimerspec spec{};
+    if (deadline != UINT64_MAX) { // absolute CLOCK_MONOTONIC, converted by relative span to avoid tsc drift
+      uint64_t expire_ts = SteadyClockTime::now() + (deadline - config_.spin_ns_ - now);
+      spec.it_value.tv_sec = expire_ts / 1_s;
+      spec.it_value.tv_nsec = expire_ts % 1_s;
+    } // else disarm, wait for event only
+    int polled = -1;
+    if (0 == ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr)) [[likely]] {
+      pollfd fds[2] = {{timer_fd_, POLLIN, 0}, {event_fd_, POLLIN, 0}};
+      while ((polled = ::poll(fds, 2, -1)) < 0 && errno == EINTR) {}
+    }
+    if (polled < 0 || !drain_fd_(timer_fd_) || !drain_fd_(event_fd_)) [[unlikely]] {
+      WARN_LOG("timerfd park failed, errno:{}, fall back to cv park", errno);
+      park_(wakeup_tick, now); // coarser, spin below covers what is left
+    }
+  }
+  // spin the rest, give up when stopped or an earlier timer is armed
+  while (deadline != UINT64_MAX && FastClockTime::now() < deadline
+         && !stop_flag_.load(std::memory_order_acquire)
+         && next_wakeup_tick_.load(std::memory_order_seq_cst) >= wakeup_tick) {
+#if defined(__x86_64__)
+    _mm_pause();
+#endif
+  }
+}
+
+uint64_t TimeService::expire_timers_(const uint64_t now, const bool force_awake) noexcept {
+  const uint64_t now_tick = now / precision_;
+  uint64_t next_tick = UINT64_MAX;
+  uint64_t fired_cnt = 0;
+  uint64_t total_lateness_ns = 0;
+  uint64_t max_lateness_ns = 0;
+  ExpiredTimers expired;
   CoroutineQueue ready_queue;
-  {
-    auto &bucket = buckets_[idx];
-    std::lock_guard<ByteSpinLock> lg(bucket.lock_);
-    bucket.scan_over_ts_ = SteadyClockTime::now();
-    bucket.waiting_queue_.fetch_nodes(
-      [force_awake, &bucket](LinkedCoroutine *coro_frame) noexcept {
-        coro_frame->sync_acquire();
-        return coro_frame->coro_local_var_->wake_up_ts_ <= bucket.scan_over_ts_ || force_awake;
-      },
-    &ready_queue);
-  }
-  while (!ready_queue.empty()) [[likely]] {
+  for (auto &shard : shards_) {
+    ExpiredTimers shard_expired;
+    std::lock_guard<ByteSpinLock> lg(shard.lock_);
+    if (force_awake) [[unlikely]] {
+      shard.wheel_.drain(shard_expired);
+    } else {
+      shard.wheel_.advance(now_tick, shard_expired);
+      next_tick = std::min(next_tick, shard.wheel_.next_expire_tick());
+    }
+    while (!shard_expired.empty()) {
+      TimerNode *node = shard_expired.pop();
+      if (node->callback_) { // TimerHandle waits it in destructor
+        node->firing_.store(true, std::memory_order_relaxed);
+      }
+      expired.append(node);
+    }
+  }
+  while (!expired.empty()) [[likely]] {
     DEBUG_LOG("wakeup one");
-    LinkedCoroutine *coro_frame = ready_queue.pop_from_head();
-    TLS_SCHEDULER->commit(coro_frame);
+    TimerNode *node = expired.pop(); // frame of node is not resumed yet, safe to access
+    if (!force_awake) [[likely]] {
+      uint64_t lateness_ns = now > node->deadline_ ? now - node->deadline_ : 0;
+      fired_cnt++;
+      total_lateness_ns += lateness_ns;
+      max_lateness_ns = std::max(max_lateness_ns, lateness_ns);
+    }
+    if (node->callback_) {
+      node->callback_->on_timer(false);
+      node->firing_.store(false, std::memory_order_release);
+    } else {
+      node->frame_->sync_acquire();
+      ready_queue.append_to_tail(node->frame_); // node is gone once frame is resumed
+    }
+  }
+  if (!ready_queue.empty()) [[likely]] {
+    TLS_SCHEDULER->commit(ready_queue); // coalesced timers cost one commit
+  }
+  if (fired_cnt != 0) {
+    lateness_stats_.record(fired_cnt, total_lateness_ns, max_lateness_ns);
+  }
+  return next_tick;
+}
+
+TimerHandle::TimerHandle(TimeService &time_service, TimerCallBack *callback) noexcept
+: time_service_{&time_service},
+node_{} {
+  node_.callback_ = callback;
+  node_.shard_ = time_service.pick_shard();
+}
+
+TimerHandle::~TimerHandle() {
+  cancel();
+  wait_callback();
+}
+
+bool TimerHandle::arm(const uint64_t deadline, const uint64_t slack) noexcept {
+  return arm_(deadline, slack, nullptr);
+}
+
+bool TimerHandle::arm_after(const uint64_t delay, const uint64_t slack) noexcept {
+  return arm_(FastClockTime::now() + delay, slack, nullptr);
+}
+
+bool TimerHandle::cancel() noexcept {
+  return time_service_->cancel_(&node_);
+}
+
+bool TimerHandle::reschedule(const uint64_t deadline, const uint64_t slack) noexcept {
+  return time_service_->reschedule_(&node_, deadline, slack);
+}
+
+bool TimerHandle::armed() noexcept {
+  return time_service_->armed_(&node_);
+}
+
+void TimerHandle::wait_callback() noexcept {
+  while (node_.firing_.load(std::memory_order_acquire)) [[unlikely]] {
+    std::this_thread::yield();
+  }
+}
+
+bool TimerHandle::arm_(const uint64_t deadline, const uint64_t slack, const CancelState *cancel_state) noexcept {
+  assert(node_.callback_);
+  bool ret = true;
+  TimeService::ArmResult result = time_service_->arm_(&node_, deadline, slack, cancel_state);
+  if (result == TimeService::ArmResult::ALREADY_ARMED) [[unlikely]] {
+    ret = false;
+  } else if (result != TimeService::ArmResult::ARMED) [[unlikely]] { // due or canceled already, fire in place
+    TimeService::fire_(&node_, result == TimeService::ArmResult::CANCELED);
   }
+  return ret;
 }
 
-}
\ No newline at end of file
+}
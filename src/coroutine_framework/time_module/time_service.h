@@ -1,9 +1,16 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdlib>
 #include <thread>
 #include <condition_variable>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 #include "coroutine_framework/queue.h"
+#include "coroutine_framework/cancellation.h"
+#include "timing_wheel.h"
 
 namespace ToE
 {
@@ -12,25 +19,137 @@ struct WallClockTime {
   static uint64_t now() noexcept;
 };
 
-struct SteadyClockTime {
+struct SteadyClockTime { // precise, vDSO clock_gettime, tens of ns
   static uint64_t now() noexcept;
 };
 
+/**
+ * @brief FastClockTime is precise and costs a few cycles, in the same ns domain as SteadyClockTime.
+ * it scales rdtsc by a ratio calibrated against steady clock at first use(blocks about 10ms once),
+ * falls back to SteadyClockTime if cpu has no invariant TSC. timers and latency instrumentation use it.
+ * ratio error is a few ppm, so it slowly drifts from SteadyClockTime, do not mix them for long spans.
+ */
+struct FastClockTime {
+  struct TscCalibration {
+    uint64_t base_tsc_;
+    uint64_t base_ns_;
+    uint64_t mult_; // ns per tsc cycle in 32.32 fixed point, 0 means tsc is not usable
+  };
+  static uint64_t now() noexcept;
+  static bool tsc_enabled() noexcept { return calibration().mult_ != 0; }
+  static const TscCalibration &calibration() noexcept {
+    static const TscCalibration CALIBRATION = calibrate_();
+    return CALIBRATION;
+  }
+private:
+  static TscCalibration calibrate_() noexcept;
+};
+
+/**
+ * @brief CoarseClockTime is a relaxed load of FastClockTime published once per loop, cheapest but lags behind
+ * by up to one loop(or one idle park), for stats and rough timestamps only, never for deadlines of short timers.
+ * each scheduler worker keeps it's own copy so no shared cache line is written per loop, other threads read
+ * the one published by TimeService thread.
+ */
+struct CoarseClockTime {
+  static uint64_t now() noexcept {
+    uint64_t ret = TLS_NOW_NS != 0 ? TLS_NOW_NS : NOW_NS.load(std::memory_order_relaxed);
+    return ret != 0 ? ret : update(FastClockTime::now()); // never published yet
+  }
+  static uint64_t update(const uint64_t now) noexcept; // keep monotonic among publishers, return published value
+  static uint64_t update_local(const uint64_t now) noexcept { // worker loop only, seen by calling thread
+    TLS_NOW_NS = std::max(TLS_NOW_NS, now);
+    return TLS_NOW_NS;
+  }
+private:
+  static inline std::atomic<uint64_t> NOW_NS{0};
+  static inline thread_local uint64_t TLS_NOW_NS{0};
+};
+
+inline uint64_t FastClockTime::now() noexcept {
+#if defined(__x86_64__)
+  const TscCalibration &calibration = FastClockTime::calibration();
+  if (calibration.mult_ != 0) [[likely]] {
+    uint64_t tsc = __rdtsc();
+    uint64_t delta = tsc > calibration.base_tsc_ ? tsc - calibration.base_tsc_ : 0;
+    return calibration.base_ns_ + static_cast<uint64_t>((static_cast<unsigned __int128>(delta) * calibration.mult_) >> 32);
+  }
+#endif
+  return SteadyClockTime::now();
+}
+
+struct TimeService;
+
+struct TimeConfig {
+  uint64_t precision_ = 1_ms; // tick of timer wheels
+  // TimeService parks on timerfd with absolute deadline instead of condition variable, for 10us~1ms timers
+  bool high_resolution_ = false;
+  // busy wait this long before deadline in high resolution mode, trades cpu for lateness, 0 to disable
+  uint64_t spin_ns_ = 0;
+};
+
+/**
+ * @brief TimerHandle owns a reusable timer node, arm/cancel/reschedule are O(1) and allocation free.
+ * 1. callback is invoked exactly once per successful arm, on_timer(false) when expired and on_timer(true) when canceled,
+ *    it runs in time service thread(or caller thread if due at arm), should be short and never block.
+ * 2. handle may be re-armed in it's own callback, which makes a periodic timer without allocation.
+ * 3. destructor cancels the timer and waits for running callback, so never destroy handle in it's own callback.
+ */
+class TimerHandle {
+public:
+  TimerHandle(TimeService &time_service, TimerCallBack *callback = nullptr) noexcept;
+  TimerHandle(const TimerHandle &) = delete;
+  TimerHandle &operator=(const TimerHandle &) = delete;
+  ~TimerHandle();
+  void set_callback(TimerCallBack *callback) noexcept { node_.callback_ = callback; } // only when not armed
+  // FastClockTime ns, may fire up to slack later for coalescing with other timers, return false if armed already
+  bool arm(const uint64_t deadline, const uint64_t slack = 0) noexcept;
+  bool arm_after(const uint64_t delay, const uint64_t slack = 0) noexcept;
+  bool cancel() noexcept; // return false if not armed, expired or canceled already
+  // move deadline of armed timer, return false if not armed
+  bool reschedule(const uint64_t deadline, const uint64_t slack = 0) noexcept;
+  bool armed() noexcept;
+  void wait_callback() noexcept; // wait for callback running in time service thread, never call it in own callback
+  uint64_t deadline() const noexcept { return node_.deadline_; }
+private:
+  friend struct co_sleep;
+  bool arm_(const uint64_t deadline, const uint64_t slack, const CancelState *cancel_state) noexcept;
+  TimeService *time_service_;
+  TimerNode node_;
+};
+
+/**
+ * @brief TimeService drives TimerHandle and co_sleep out of scheduler workers with a dedicated thread,
+ * co_sleep on a worker uses WorkerTimers of that worker instead.
+ * timers are spread over SHARD_NUM hierarchical wheels by arming thread, each guarded by a spin lock,
+ * so arming threads rarely contend, and each timer is touched O(levels) times before expiry.
+ * the thread is tickless, it parks until the earliest deadline of all wheels, arming an earlier timer lowers
+ * next_wakeup_tick_ and wakes it, arming a later one costs no wake up.
+ * expired frames are committed to scheduler in bulk, one lock and one notify per wake up.
+ * in high resolution mode it parks on a timerfd armed with absolute deadline minus spin_ns_(timer slack set to 1ns),
+ * early wake up goes through an eventfd, then spins to deadline. lateness of every fired timer is recorded in
+ * lateness_stats(), expected bound is precision + wake up latency(+ spin_ns_ saved) in high resolution mode.
+ */
 struct TimeService {
-  static constexpr int64_t BUCKET_NUM = 1LL << 12;
-  struct TimeWheelBucket {
-    TimeWheelBucket() : lock_{}, scan_over_ts_(0), waiting_queue_{} {}
+  static constexpr uint64_t SHARD_NUM = 8;
+  struct alignas(64) WheelShard {
+    WheelShard() : lock_{}, wheel_{} {}
     ByteSpinLock lock_;
-    uint64_t scan_over_ts_;
-    CoroutineQueue waiting_queue_;
-  } cache_aligned;
-  TimeService(const uint64_t precision)
+    TimingWheel wheel_;
+  };
+  TimeService(const uint64_t precision) : TimeService{TimeConfig{precision, false, 0}} {}
+  TimeService(const TimeConfig &config)
   : loop_thread_{},
   stop_flag_{false},
   lock_{},
-  precision_{precision},
-  start_bukcet_run_ts_{SteadyClockTime::now()},
-  buckets_{} {}
+  config_{config},
+  precision_{config.precision_},
+  next_wakeup_tick_{UINT64_MAX},
+  timer_fd_{-1},
+  event_fd_{-1},
+  lateness_stats_{},
+  shards_{} {}
+  ~TimeService();
   TimeService(const TimeService &) = delete;
   TimeService(TimeService &&) = delete;
   TimeService &operator=(const TimeService &) = delete;
@@ -38,17 +157,48 @@ struct TimeService {
   void start();
   void stop() noexcept;
   void wait() noexcept;
-  void register_frame(LinkedCoroutine *frame) noexcept;
+  uint64_t precision() const noexcept { return precision_; }
+  const TimeConfig &config() const noexcept { return config_; }
+  TimerLatenessStats &lateness_stats() noexcept { return lateness_stats_; } // shared with WorkerTimers
+  uint32_t pick_shard() const noexcept; // thread local round robin, set to node before it's visible to other threads
+  // node->deadline_, node->frame_ and node->shard_ should be set
+  void register_timer(TimerNode *node, const uint64_t slack = 0) noexcept;
+  bool unregister_timer(TimerNode *node) noexcept; // return true if removed before awaken
 private:
+  friend class TimerHandle;
+  enum class ArmResult : uint8_t {
+    ARMED = 0,
+    ALREADY_ARMED = 1,
+    EXPIRED = 2,
+    CANCELED = 3,
+  };
+  ArmResult arm_(TimerNode *node, const uint64_t deadline, const uint64_t slack, const CancelState *cancel_state) noexcept;
+  bool cancel_(TimerNode *node) noexcept;
+  bool reschedule_(TimerNode *node, const uint64_t deadline, const uint64_t slack) noexcept;
+  bool armed_(TimerNode *node) noexcept;
+  static void fire_(TimerNode *node, const bool cancelled) noexcept;
+  void lower_wakeup_tick_(const uint64_t tick) noexcept; // wake loop thread if tick is earlier than it's parking for
+  uint64_t expire_tick_(const uint64_t deadline, const uint64_t slack) const noexcept {
+    return TimingWheel::coalesce_tick((deadline - 1) / precision_ + 1, slack / precision_);
+  }
   void loop_() noexcept;
-  void wakeup_frame_on_bucket_(const uint64_t idx, const bool force_awake = false) noexcept;
+  void park_(const uint64_t wakeup_tick, const uint64_t now) noexcept; // until wakeup_tick or lowered or stopped
+  void park_high_resolution_(const uint64_t wakeup_tick, const uint64_t now) noexcept;
+  static bool drain_fd_(const int fd) noexcept; // reset timerfd/eventfd counter, false on error
+  void notify_() noexcept;
+  // return next expire tick, now is 0 if force awake
+  uint64_t expire_timers_(const uint64_t now, const bool force_awake = false) noexcept;
   std::jthread loop_thread_;
   std::atomic<bool> stop_flag_;
   std::mutex lock_;
   std::condition_variable cv_;
+  const TimeConfig config_;
   const uint64_t precision_;
-  std::atomic<uint64_t> start_bukcet_run_ts_;
-  std::array<TimeWheelBucket, BUCKET_NUM> buckets_;
+  std::atomic<uint64_t> next_wakeup_tick_; // loop thread parks until it
+  int timer_fd_; // high resolution mode only
+  int event_fd_; // high resolution mode only, for early wake up
+  TimerLatenessStats lateness_stats_;
+  std::array<WheelShard, SHARD_NUM> shards_;
 };
 
 }
\ No newline at end of file
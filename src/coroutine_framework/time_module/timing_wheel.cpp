@@ -0,0 +1,145 @@
+#include "timing_wheel.h"
+#include <algorithm>
+#include <bit>
+
+namespace ToE
+{
+
+void TimingWheel::reset(const uint64_t tick) noexcept {
+  assert(size_ == 0);
+  elapsed_ = tick;
+}
+
+bool TimingWheel::insert(TimerNode *node) noexcept {
+  bool ret = false;
+  if (node->expire_tick_ > elapsed_) [[likely]] {
+    link_(node);
+    size_++;
+    ret = true;
+  }
+  return ret;
+}
+
+bool TimingWheel::remove(TimerNode *node) noexcept {
+  bool ret = false;
+  if (node->linked()) {
+    node->unlink();
+    const uint64_t level = node->slot_ / SLOT_NUM;
+    const uint64_t slot = node->slot_ % SLOT_NUM;
+    if (!slots_[level][slot].linked()) {
+      occupied_[level] &= ~(1ULL << slot);
+    }
+    size_--;
+    ret = true;
+  }
+  return ret;
+}
+
+void TimingWheel::advance(const uint64_t now_tick, ExpiredTimers &expired) noexcept {
+  while (elapsed_ < now_tick) {
+    const uint64_t next_tick = next_expire_tick(); // skip empty ticks, idle driver may advance hours at once
+    if (next_tick > now_tick) {
+      elapsed_ = now_tick;
+      break;
+    }
+    elapsed_ = next_tick;
+    const uint64_t tick = next_tick;
+    for (uint64_t level = LEVEL_NUM - 1; level > 0; --level) { // from high to low, cascaded timer may cascade again
+      if ((tick & ((1ULL << (level * SLOT_BITS)) - 1)) == 0) {
+        cascade_(level, (tick >> (level * SLOT_BITS)) & (SLOT_NUM - 1));
+      }
+    }
+    expire_slot_(tick & (SLOT_NUM - 1), expired);
+  }
+}
+
+void TimingWheel::drain(ExpiredTimers &expired) noexcept {
+  for (uint64_t level = 0; level < LEVEL_NUM; ++level) {
+    for (uint64_t slot = 0; slot < SLOT_NUM; ++slot) {
+      TimerLink pending;
+      splice_(level, slot, pending);
+      while (pending.linked()) {
+        TimerNode *node = static_cast<TimerNode *>(pending.next_);
+        node->unlink();
+        size_--;
+        expired.append(node);
+      }
+    }
+  }
+}
+
+uint64_t TimingWheel::next_expire_tick() const noexcept {
+  uint64_t ret = UINT64_MAX;
+  // slots behind current one are empty except top level(clamped timers), so search forward from low level to high
+  for (uint64_t level = 0; size_ != 0 && level < LEVEL_NUM; ++level) {
+    const uint64_t shift = level * SLOT_BITS;
+    const uint64_t current = (elapsed_ >> shift) & (SLOT_NUM - 1);
+    const uint64_t ahead = current == SLOT_NUM - 1 ? 0 : occupied_[level] & (~0ULL << (current + 1));
+    if (ahead != 0) {
+      const uint64_t base = (elapsed_ >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+      ret = base | (static_cast<uint64_t>(std::countr_zero(ahead)) << shift);
+      break;
+    }
+  }
+  if (size_ != 0 && ret == UINT64_MAX) [[unlikely]] { // wrapped top level slot, wake at next top level boundary
+    const uint64_t shift = (LEVEL_NUM - 1) * SLOT_BITS;
+    ret = ((elapsed_ >> shift) + 1) << shift;
+  }
+  return ret;
+}
+
+uint64_t TimingWheel::level_of_(const uint64_t elapsed, const uint64_t when) noexcept {
+  uint64_t significant = (elapsed ^ when) | (SLOT_NUM - 1);
+  uint64_t level = (63 - std::countl_zero(significant)) / SLOT_BITS;
+  return std::min(level, LEVEL_NUM - 1);
+}
+
+void TimingWheel::link_(TimerNode *node) noexcept {
+  uint64_t when = std::min(node->expire_tick_, elapsed_ + MAX_SPAN - 1); // out of range, re-armed when reached
+  uint64_t level = level_of_(elapsed_, when);
+  uint64_t slot = (when >> (level * SLOT_BITS)) & (SLOT_NUM - 1);
+  node->link_before(&slots_[level][slot]);
+  node->slot_ = static_cast<uint16_t>(level * SLOT_NUM + slot);
+  occupied_[level] |= 1ULL << slot;
+}
+
+void TimingWheel::cascade_(const uint64_t level, const uint64_t slot) noexcept {
+  TimerLink pending;
+  splice_(level, slot, pending);
+  while (pending.linked()) {
+    TimerNode *node = static_cast<TimerNode *>(pending.next_);
+    node->unlink();
+    link_(node);
+  }
+}
+
+void TimingWheel::expire_slot_(const uint64_t slot, ExpiredTimers &expired) noexcept {
+  TimerLink pending;
+  splice_(0, slot, pending);
+  while (pending.linked()) {
+    TimerNode *node = static_cast<TimerNode *>(pending.next_);
+    node->unlink();
+    if (node->expire_tick_ > elapsed_) [[unlikely]] { // clamped by MAX_SPAN
+      link_(node);
+    } else {
+      size_--;
+      expired.append(node);
+    }
+  }
+}
+
+void TimingWheel::splice_(const uint64_t level, const uint64_t slot, TimerLink &to) noexcept {
+  assert(!to.linked());
+  TimerLink &from = slots_[level][slot];
+  occupied_[level] &= ~(1ULL << slot);
+  if (from.linked()) {
+    to.next_ = from.next_;
+    to.prev_ = from.prev_;
+    to.next_->prev_ = &to;
+    to.prev_->next_ = &to;
+    from.next_ = &from;
+    from.prev_ = &from;
+  }
+}
+
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include "coroutine_framework/queue.h"
+
+namespace ToE
+{
+
+struct TimerLink { // intrusive circular doubly linked list, unlinked node points to itself
+  TimerLink() : prev_{this}, next_{this} {}
+  TimerLink(const TimerLink &) : TimerLink{} {} // link is never copied
+  TimerLink &operator=(const TimerLink &) { return *this; }
+  bool linked() const noexcept { return next_ != this; }
+  void link_before(TimerLink *pos) noexcept {
+    prev_ = pos->prev_;
+    next_ = pos;
+    pos->prev_->next_ = this;
+    pos->prev_ = this;
+  }
+  void unlink() noexcept {
+    prev_->next_ = next_;
+    next_->prev_ = prev_;
+    prev_ = this;
+    next_ = this;
+  }
+  TimerLink *prev_;
+  TimerLink *next_;
+};
+
+struct TimerCallBack {
+  // called exactly once per successful arm, when expired or canceled through TimerHandle, never with wheel lock held
+  virtual void on_timer(const bool cancelled) noexcept = 0;
+};
+
+enum class TimerState : uint8_t { // only used by WorkerTimers, settles expiry against cross thread cancellation
+  IDLE = 0,
+  ARMED = 1,
+  FIRED = 2,
+  CANCELED = 3,
+};
+
+// embedded in async action(co_sleep...) or TimerHandle, lives with it's owner, no allocation when armed
+struct TimerNode : public TimerLink {
+  TimerNode()
+  : TimerLink{},
+  deadline_{0},
+  expire_tick_{0},
+  frame_{nullptr},
+  callback_{nullptr},
+  expired_next_{nullptr},
+  remote_next_{nullptr},
+  shard_{0},
+  slot_{0},
+  firing_{false},
+  state_{TimerState::IDLE} {}
+  TimerNode(const TimerNode &rhs) // only unarmed node is copied
+  : TimerLink{},
+  deadline_{rhs.deadline_},
+  expire_tick_{rhs.expire_tick_},
+  frame_{rhs.frame_},
+  callback_{rhs.callback_},
+  expired_next_{nullptr},
+  remote_next_{nullptr},
+  shard_{rhs.shard_},
+  slot_{0},
+  firing_{false},
+  state_{TimerState::IDLE} {}
+  uint64_t deadline_; // steady clock ns
+  uint64_t expire_tick_; // ceil(deadline_ / precision)
+  LinkedCoroutine *frame_; // committed to scheduler when expired, if callback_ is null
+  TimerCallBack *callback_;
+  TimerNode *expired_next_;
+  TimerNode *remote_next_; // in remote cancel inbox of WorkerTimers
+  uint32_t shard_; // which TimingWheel it's armed in
+  uint16_t slot_; // level * SLOT_NUM + slot it's linked in, for clearing occupancy bit when removed
+  std::atomic<bool> firing_; // callback is running out of wheel lock
+  std::atomic<TimerState> state_;
+};
+
+struct ExpiredTimers { // singly linked by TimerNode::expired_next_, in expiry order
+  ExpiredTimers() : head_{nullptr}, tail_{nullptr} {}
+  bool empty() const noexcept { return nullptr == head_; }
+  void append(TimerNode *node) noexcept {
+    node->expired_next_ = nullptr;
+    if (tail_) {
+      tail_->expired_next_ = node;
+    } else {
+      head_ = node;
+    }
+    tail_ = node;
+  }
+  TimerNode *pop() noexcept {
+    TimerNode *ret = head_;
+    head_ = head_->expired_next_;
+    if (nullptr == head_) {
+      tail_ = nullptr;
+    }
+    ret->expired_next_ = nullptr;
+    return ret;
+  }
+  TimerNode *head_;
+  TimerNode *tail_;
+};
+
+struct TimerLatenessStats { // lateness of fired timers, time when frame is committed or callback runs minus deadline
+  TimerLatenessStats() : fired_cnt_{0}, wakeup_cnt_{0}, total_lateness_ns_{0}, max_lateness_ns_{0} {}
+  void record(const uint64_t fired_cnt, const uint64_t total_lateness_ns, const uint64_t max_lateness_ns) noexcept {
+    fired_cnt_.fetch_add(fired_cnt, std::memory_order_relaxed);
+    wakeup_cnt_.fetch_add(1, std::memory_order_relaxed); // one record per expiry pass
+    total_lateness_ns_.fetch_add(total_lateness_ns, std::memory_order_relaxed);
+    uint64_t current = max_lateness_ns_.load(std::memory_order_relaxed);
+    while (max_lateness_ns > current && !max_lateness_ns_.compare_exchange_weak(current, max_lateness_ns, std::memory_order_relaxed)) {}
+  }
+  void reset() noexcept {
+    fired_cnt_.store(0, std::memory_order_relaxed);
+    wakeup_cnt_.store(0, std::memory_order_relaxed);
+    total_lateness_ns_.store(0, std::memory_order_relaxed);
+    max_lateness_ns_.store(0, std::memory_order_relaxed);
+  }
+  uint64_t mean_lateness_ns() const noexcept {
+    uint64_t fired_cnt = fired_cnt_.load(std::memory_order_relaxed);
+    return fired_cnt == 0 ? 0 : total_lateness_ns_.load(std::memory_order_relaxed) / fired_cnt;
+  }
+  std::atomic<uint64_t> fired_cnt_;
+  std::atomic<uint64_t> wakeup_cnt_; // expiry passes which fired any timer, coalesced timers share one
+  std::atomic<uint64_t> total_lateness_ns_;
+  std::atomic<uint64_t> max_lateness_ns_;
+};
+
+/**
+ * @brief TimingWheel is a hierarchical hashed timing wheel, not thread safe.
+ * 1. LEVEL_NUM levels of SLOT_NUM slots, slot width of level L is SLOT_NUM^L ticks,
+ *    it covers SLOT_NUM^LEVEL_NUM ticks(about 2.2 years in 1ms tick), longer timer is re-armed when reached.
+ * 2. level of a timer is decided by the highest bit group where expire tick differs from elapsed tick,
+ *    when a higher level slot is reached, it's timers are cascaded to lower levels,
+ *    so each timer is touched at most LEVEL_NUM times no matter how long it is.
+ * 3. insert/remove are O(1), remove needs no search since node is doubly linked.
+ * 4. expired nodes are unlinked and handed out, caller decides to resume frame or run callback.
+ * 5. one occupancy bitmap per level tells non-empty slots, next_expire_tick() is a few countr_zero,
+ *    so driver thread can sleep until it instead of waking every tick.
+ * 6. timer with slack is coalesced by coalesce_tick(), timers of overlapping windows share one tick and one wake up.
+ */
+class TimingWheel {
+public:
+  static constexpr uint64_t SLOT_BITS = 6;
+  static constexpr uint64_t SLOT_NUM = 1ULL << SLOT_BITS;
+  static constexpr uint64_t LEVEL_NUM = 6;
+  static constexpr uint64_t MAX_SPAN = 1ULL << (SLOT_BITS * LEVEL_NUM); // in ticks
+  TimingWheel() : slots_{}, occupied_{}, elapsed_{0}, size_{0} {}
+  TimingWheel(const TimingWheel &) = delete;
+  TimingWheel &operator=(const TimingWheel &) = delete;
+  void reset(const uint64_t tick) noexcept; // set start tick, only for empty wheel
+  bool insert(TimerNode *node) noexcept; // return false if node is due already(expire_tick_ <= elapsed tick)
+  bool remove(TimerNode *node) noexcept; // return false if node is not armed
+  void advance(const uint64_t now_tick, ExpiredTimers &expired) noexcept; // expire every tick <= now_tick
+  void drain(ExpiredTimers &expired) noexcept; // expire all timers no matter when
+  uint64_t next_expire_tick() const noexcept; // earliest tick advance() has work(expire or cascade), UINT64_MAX if empty
+  // round up to the tick with most trailing zero bits in [expire_tick, expire_tick + slack_ticks]
+  static uint64_t coalesce_tick(const uint64_t expire_tick, const uint64_t slack_ticks) noexcept {
+    uint64_t ret = expire_tick;
+    if (slack_ticks != 0) {
+      const uint64_t limit = expire_tick + slack_ticks;
+      const uint64_t bit = 63 - std::countl_zero(expire_tick ^ limit); // highest bit limit is over expire_tick
+      ret = limit & ~((1ULL << bit) - 1);
+    }
+    return ret;
+  }
+  uint64_t elapsed() const noexcept { return elapsed_; }
+  uint64_t size() const noexcept { return size_; }
+private:
+  static uint64_t level_of_(const uint64_t elapsed, const uint64_t when) noexcept;
+  void link_(TimerNode *node) noexcept;
+  void cascade_(const uint64_t level, const uint64_t slot) noexcept;
+  void expire_slot_(const uint64_t slot, ExpiredTimers &expired) noexcept;
+  void splice_(const uint64_t level, const uint64_t slot, TimerLink &to) noexcept;
+  std::array<std::array<TimerLink, SLOT_NUM>, LEVEL_NUM> slots_;
+  std::array<uint64_t, LEVEL_NUM> occupied_; // bit i set if slots_[level][i] is not empty
+  uint64_t elapsed_; // every tick <= elapsed_ has been processed
+  uint64_t size_;
+};
+
+}
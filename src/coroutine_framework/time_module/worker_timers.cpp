@@ -0,0 +1,94 @@
+#include "worker_timers.h"
+#include <algorithm>
+
+namespace ToE
+{
+
+thread_local WorkerTimers *TLS_WORKER_TIMERS = nullptr;
+
+bool WorkerTimers::arm(TimerNode *node, const uint64_t slack) noexcept {
+  bool ret = false;
+  TimerState expected = TimerState::IDLE;
+  node->expire_tick_ = TimingWheel::coalesce_tick((node->deadline_ - 1) / precision_ + 1, slack / precision_);
+  if (node->state_.compare_exchange_strong(expected, TimerState::ARMED, std::memory_order_acq_rel)) [[likely]] {
+    if (wheel_.insert(node)) [[likely]] {
+      ret = true;
+    } else {
+      expected = TimerState::ARMED;
+      // lost to cancel() means node is in inbox already, frame must suspend and wait for it
+      ret = !node->state_.compare_exchange_strong(expected, TimerState::FIRED, std::memory_order_acq_rel);
+    }
+  } // else canceled before armed
+  return ret;
+}
+
+bool WorkerTimers::cancel(TimerNode *node) noexcept {
+  bool ret = false;
+  TimerState state = node->state_.load(std::memory_order_acquire);
+  while (state == TimerState::IDLE || state == TimerState::ARMED) {
+    if (node->state_.compare_exchange_weak(state, TimerState::CANCELED, std::memory_order_acq_rel)) {
+      if (state == TimerState::ARMED) { // owner will unlink and resume it
+        CommonExecuteModule *scheduler = scheduler_; // this may be gone once node is resumed
+        TimerNode *head = remote_cancel_.load(std::memory_order_relaxed);
+        do {
+          node->remote_next_ = head;
+        } while (!remote_cancel_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        scheduler->notify_all();
+      }
+      ret = true;
+      break;
+    }
+  }
+  return ret;
+}
+
+void WorkerTimers::expire(const uint64_t now, CoroutineQueue &ready_queue) noexcept {
+  ExpiredTimers expired;
+  collect_remote_cancel_(ready_queue);
+  wheel_.advance(now / precision_, expired);
+  fire_(expired, ready_queue, now);
+}
+
+void WorkerTimers::drain(CoroutineQueue &ready_queue) noexcept {
+  ExpiredTimers expired;
+  collect_remote_cancel_(ready_queue);
+  wheel_.drain(expired);
+  fire_(expired, ready_queue, 0);
+}
+
+uint64_t WorkerTimers::next_deadline() const noexcept {
+  uint64_t tick = wheel_.next_expire_tick();
+  return tick == UINT64_MAX ? UINT64_MAX : tick * precision_;
+}
+
+void WorkerTimers::collect_remote_cancel_(CoroutineQueue &ready_queue) noexcept {
+  TimerNode *node = remote_cancel_.exchange(nullptr, std::memory_order_acquire);
+  while (node) [[unlikely]] {
+    TimerNode *next = node->remote_next_;
+    wheel_.remove(node); // may be unlinked by expiry already
+    ready_queue.append_to_tail(node->frame_);
+    node = next;
+  }
+}
+
+void WorkerTimers::fire_(ExpiredTimers &expired, CoroutineQueue &ready_queue, const uint64_t now) noexcept {
+  uint64_t fired_cnt = 0;
+  uint64_t total_lateness_ns = 0;
+  uint64_t max_lateness_ns = 0;
+  while (!expired.empty()) {
+    TimerNode *node = expired.pop();
+    TimerState expected = TimerState::ARMED;
+    if (node->state_.compare_exchange_strong(expected, TimerState::FIRED, std::memory_order_acq_rel)) [[likely]] {
+      uint64_t lateness_ns = now > node->deadline_ ? now - node->deadline_ : 0;
+      fired_cnt++;
+      total_lateness_ns += lateness_ns;
+      max_lateness_ns = std::max(max_lateness_ns, lateness_ns);
+      ready_queue.append_to_tail(node->frame_);
+    } // else canceled, resumed from inbox
+  }
+  if (fired_cnt != 0 && now != 0) {
+    stats_->record(fired_cnt, total_lateness_ns, max_lateness_ns);
+  }
+}
+
+}
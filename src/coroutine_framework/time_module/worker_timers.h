@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "coroutine_framework/queue.h"
+#include "coroutine_framework/common_execute_module.h"
+#include "timing_wheel.h"
+
+namespace ToE
+{
+
+/**
+ * @brief WorkerTimers is the timing wheel owned by one scheduler worker, co_sleep on a worker arms here.
+ * 1. arm and expire only happen on owner thread without lock, expired frame is resumed by the same worker.
+ * 2. cancellation from other threads wins by CAS on TimerNode::state_ and pushes node to remote cancel inbox,
+ *    owner unlinks and resumes it in next loop, so wheel is never touched by two threads.
+ * 3. owner parks no longer than next_deadline(), and is notified when inbox is not empty.
+ */
+struct WorkerTimers {
+  WorkerTimers(CommonExecuteModule *scheduler, TimerLatenessStats *stats, const uint64_t precision, const uint64_t now)
+  : scheduler_{scheduler},
+  stats_{stats},
+  precision_{precision},
+  wheel_{},
+  remote_cancel_{nullptr} { wheel_.reset(now / precision); }
+  WorkerTimers(const WorkerTimers &) = delete;
+  WorkerTimers &operator=(const WorkerTimers &) = delete;
+  // owner only, return false if due or canceled already, frame should not suspend
+  bool arm(TimerNode *node, const uint64_t slack = 0) noexcept;
+  bool cancel(TimerNode *node) noexcept; // any thread, return true if canceled before expiry
+  void expire(const uint64_t now, CoroutineQueue &ready_queue) noexcept; // owner only
+  void drain(CoroutineQueue &ready_queue) noexcept; // owner only, awake all frames when stopping
+  uint64_t next_deadline() const noexcept; // steady clock ns, UINT64_MAX if no timer
+  bool has_remote_cancel() const noexcept { return remote_cancel_.load(std::memory_order_relaxed) != nullptr; }
+  uint64_t size() const noexcept { return wheel_.size(); }
+private:
+  void collect_remote_cancel_(CoroutineQueue &ready_queue) noexcept;
+  void fire_(ExpiredTimers &expired, CoroutineQueue &ready_queue, const uint64_t now) noexcept; // now is 0 if drain
+  CommonExecuteModule *scheduler_;
+  TimerLatenessStats *stats_; // shared, flushed once per expire()
+  const uint64_t precision_;
+  TimingWheel wheel_;
+  std::atomic<TimerNode *> remote_cancel_; // MPSC stack linked by TimerNode::remote_next_
+};
+
+extern thread_local WorkerTimers *TLS_WORKER_TIMERS; // set by scheduler worker thread
+
+}
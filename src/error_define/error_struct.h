@@ -11,7 +11,11 @@ struct Error {
   #define __DEF_ERROR__ \
     DEF_ERROR(RPC_TIMEOUT, -1001, "rpc response not returned at specified time span.") \
     DEF_ERROR(HAS_BEEN_STOPPED, -1002, "module has been stopped.") \
-    DEF_ERROR(FUNCTION_NOT_REFLECTED, -1003, "deserialize meet not reflected function.") 
+    DEF_ERROR(FUNCTION_NOT_REFLECTED, -1003, "deserialize meet not reflected function.") \
+    DEF_ERROR(CANCELED, -1004, "operation canceled by cancellation token.") \
+    DEF_ERROR(BUSY, -1005, "admission control rejected the task, too many running coroutines, frame memory or pending rpcs.") \
+    DEF_ERROR(TIMER_BUSY, -1006, "timer handle is armed already.") \
+    DEF_ERROR(TIMEOUT, -1007, "awaited operation not finished at specified time span.") 
   #define DEF_ERROR(error_name, error_value, message) \
   static constexpr int32_t error_name = error_value;
   __DEF_ERROR__
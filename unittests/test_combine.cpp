@@ -0,0 +1,120 @@
+#include <tuple>
+#include <variant>
+#include "coroutine_framework/framework.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace ToE;
+using namespace std;
+
+CoroTask<int64_t> delayed_value(uint64_t delay, int64_t value) {
+  co_await co_sleep(delay);
+  co_return value;
+}
+
+CoroTask<void> delayed_flag(uint64_t delay, bool &flag) {
+  co_await co_sleep(delay);
+  flag = true;
+}
+
+CoroTask<std::size_t> race_sleep_with_rpc(EndPoint peer) {
+  auto ret = co_await (co_sleep(50_ms) || co_rpc<example_add>().with_args(1, 2).on(peer).timeout(10_s));
+  co_return ret.index();
+}
+
+CoroTask<int64_t> join_rpcs(EndPoint peer) {
+  auto [lhs, rhs] = co_await (co_rpc<example_add>().with_args(1, 2).on(peer).timeout(10_s) &&
+                              co_rpc<example_add>().with_args(3, 4).on(peer).timeout(10_s));
+  co_return lhs.value_or(0) + rhs.value_or(0);
+}
+
+CoroTask<int64_t> join_mixed() {
+  bool flag = false;
+  auto [slept, value, done] = co_await when_all(co_sleep(10_ms), delayed_value(20_ms, 7), delayed_flag(5_ms, flag));
+  co_return slept && flag ? value : -1;
+}
+
+CoroTask<std::pair<std::size_t, int64_t>> race_three() {
+  auto ret = co_await (delayed_value(1_s, 1) || delayed_value(10_ms, 2) || co_sleep(1_s));
+  co_return std::pair<std::size_t, int64_t>{ret.index(), ret.index() == 1 ? std::get<1>(ret) : 0};
+}
+
+CoroTask<std::pair<Expected<int64_t>, Expected<int64_t>>> timeouts() {
+  auto timed_out = co_await with_timeout(delayed_value(1_s, 1), 20_ms);
+  auto finished = co_await with_timeout(delayed_value(5_ms, 3), 1_s);
+  co_return std::pair<Expected<int64_t>, Expected<int64_t>>{timed_out, finished};
+}
+
+CoroTask<Expected<void>> cancelled_race() {
+  auto ret = co_await when_any(co_sleep(10_s), co_sleep(10_s));
+  co_return std::visit([](auto &result) { return result; }, ret);
+}
+
+BOOST_AUTO_TEST_SUITE(test_combine)
+
+BOOST_AUTO_TEST_CASE(test_when_any_and_all) {
+  CoroFrameWork framework{1, 18897};
+  {
+    uint64_t start_ts = FastClockTime::now();
+    auto task = race_three();
+    BOOST_CHECK(framework.commit(task));
+    task.wait();
+    BOOST_CHECK_EQUAL(task.get_result().first, 1);
+    BOOST_CHECK_EQUAL(task.get_result().second, 2);
+    BOOST_CHECK(FastClockTime::now() - start_ts < 500_ms); // losers canceled, not waited
+  }
+  {
+    uint64_t start_ts = FastClockTime::now();
+    auto task = join_mixed();
+    BOOST_CHECK(framework.commit(task));
+    task.wait();
+    BOOST_CHECK_EQUAL(task.get_result(), 7);
+    BOOST_CHECK(FastClockTime::now() - start_ts >= 20_ms);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_with_timeout) {
+  CoroFrameWork framework{1, 18898};
+  uint64_t start_ts = FastClockTime::now();
+  auto task = timeouts();
+  BOOST_CHECK(framework.commit(task));
+  task.wait();
+  BOOST_CHECK(FastClockTime::now() - start_ts < 500_ms);
+  BOOST_CHECK(task.get_result().first.error() == Error{Error::TIMEOUT});
+  BOOST_CHECK_EQUAL(task.get_result().second.value_or(0), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_cancel_combined) {
+  CoroFrameWork framework{1, 18899};
+  CancellationSource source;
+  uint64_t start_ts = FastClockTime::now();
+  auto task = cancelled_race();
+  task.bind_cancellation(source.token());
+  BOOST_CHECK(framework.commit(task));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  source.cancel();
+  task.wait();
+  BOOST_CHECK(FastClockTime::now() - start_ts < 1_s);
+  BOOST_CHECK(task.get_result().error() == Error{Error::CANCELED});
+}
+
+BOOST_AUTO_TEST_CASE(test_combine_rpc) {
+  CoroFrameWork client{1, 18900};
+  CoroFrameWork server{2, 18901};
+  EndPoint peer{{127, 0, 0, 1}, 18901};
+  {
+    uint64_t start_ts = FastClockTime::now();
+    auto task = race_sleep_with_rpc(peer);
+    BOOST_CHECK(client.commit(task));
+    task.wait();
+    BOOST_CHECK_EQUAL(task.get_result(), 0); // example_add sleeps 1s before reply
+    BOOST_CHECK(FastClockTime::now() - start_ts < 500_ms);
+  }
+  {
+    auto task = join_rpcs(peer); // two requests in flight from one caller
+    BOOST_CHECK(client.commit(task));
+    task.wait();
+    BOOST_CHECK_EQUAL(task.get_result(), 10);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
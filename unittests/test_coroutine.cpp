@@ -0,0 +1,614 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "coroutine_framework/framework.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace ToE;
+using namespace std;
+
+struct CopyCounter {
+  CopyCounter(int64_t value) : value_{value} {}
+  CopyCounter(const CopyCounter &rhs) : value_{rhs.value_} { COPY_CNT++; }
+  CopyCounter(CopyCounter &&rhs) : value_{rhs.value_} {}
+  CopyCounter &operator=(const CopyCounter &rhs) { value_ = rhs.value_; COPY_CNT++; return *this; }
+  CopyCounter &operator=(CopyCounter &&rhs) { value_ = rhs.value_; return *this; }
+  int64_t value_;
+  static int64_t COPY_CNT;
+};
+int64_t CopyCounter::COPY_CNT = 0;
+
+CoroTask<std::unique_ptr<int64_t>> make_unique_value(int64_t value) {
+  co_return std::make_unique<int64_t>(value);
+}
+
+CoroTask<std::unique_ptr<int64_t>> forward_unique_value(int64_t value) {
+  auto ptr = co_await make_unique_value(value);
+  *ptr += 1;
+  co_return std::move(ptr);
+}
+
+CoroTask<CopyCounter> make_counter(int64_t depth) {
+  if (depth == 0) {
+    co_return CopyCounter{0};
+  }
+  CopyCounter counter = co_await make_counter(depth - 1);
+  counter.value_++;
+  co_return std::move(counter);
+}
+
+CoroTask<void> void_child(int64_t &output) {
+  output = 1;
+  co_return;
+}
+
+CoroTask<int64_t> await_void_child() {
+  int64_t output = 0;
+  co_await void_child(output);
+  co_return output;
+}
+
+CoroTask<Expected<void>> long_sleep() {
+  auto ret = co_await co_sleep(10_s);
+  co_return ret;
+}
+
+CoroTask<Expected<int64_t>> rpc_add_timeout(EndPoint peer, uint64_t timeout) {
+  auto ret = co_await co_rpc<example_add>().with_args(1, 2).on(peer).timeout(timeout);
+  co_return ret;
+}
+
+CoroTask<Expected<int64_t>> rpc_add(EndPoint peer) {
+  auto ret = co_await co_rpc<example_add>().with_args(1, 2).on(peer).timeout(10_s);
+  co_return ret;
+}
+
+CoroTask<Expected<int64_t>> rpc_wait(EndPoint peer, uint64_t wait_ms) {
+  auto ret = co_await co_rpc<example_wait>().with_args(wait_ms).on(peer).timeout(10_s);
+  co_return ret;
+}
+
+CoroTask<Expected<std::string>> rpc_repeat(EndPoint peer, char c, int64_t count) {
+  auto ret = co_await co_rpc<example_repeat>().with_args(c, count).on(peer).timeout(10_s);
+  co_return ret;
+}
+
+CoroTask<Expected<int64_t>> rpc_count(EndPoint peer, std::string data, char c) {
+  auto ret = co_await co_rpc<example_count>().with_args(std::move(data), c).on(peer).timeout(10_s);
+  co_return ret;
+}
+
+CoroGenerator<int64_t> fibonacci(int64_t count) {
+  int64_t a = 0, b = 1;
+  for (int64_t i = 0; i < count; i++) {
+    co_yield a;
+    b = std::exchange(a, b) + b;
+  }
+}
+
+AsyncGenerator<std::unique_ptr<int64_t>> slow_values(int64_t count) {
+  for (int64_t i = 0; i < count; i++) {
+    co_await co_sleep(1_ms);
+    co_yield co_await make_unique_value(i);
+  }
+}
+
+CoroTask<int64_t> sum_slow_values(int64_t count) {
+  auto gen = slow_values(count);
+  int64_t sum = 0;
+  while (auto item = co_await gen.next()) {
+    sum += **item;
+  }
+  co_return sum;
+}
+
+CoroTask<int64_t> sleep_then_return(uint64_t sleep_ms, int64_t value) {
+  co_await co_sleep(sleep_ms * 1_ms);
+  co_return value;
+}
+
+std::atomic<int64_t> ADMITTED_RUNNING{0};
+std::atomic<int64_t> ADMITTED_PEAK{0};
+
+CoroTask<void> tracked_sleep() {
+  int64_t running = ++ADMITTED_RUNNING;
+  int64_t peak = ADMITTED_PEAK.load();
+  while (running > peak && !ADMITTED_PEAK.compare_exchange_weak(peak, running));
+  co_await co_sleep(5_ms);
+  --ADMITTED_RUNNING;
+}
+
+CoroTask<int64_t> spawn_all(CoroFrameWork *framework, int64_t count) {
+  std::vector<CoroTask<void>> children;
+  int64_t admitted = 0;
+  for (int64_t idx = 0; idx < count; ++idx) {
+    children.push_back(tracked_sleep());
+    if (co_await framework->spawn(children.back())) {
+      admitted++;
+    }
+  }
+  co_return admitted;
+}
+
+BOOST_AUTO_TEST_SUITE(test_coroutine) // logger is initialized by GlobalSetup in test_stringification.cpp
+
+BOOST_AUTO_TEST_CASE(test_move_only_result) {
+  CoroFrameWork framework{1, 18881};
+  auto task = forward_unique_value(1);
+  BOOST_CHECK(framework.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(*task.get_result(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_result_not_copied) {
+  CoroFrameWork framework{1, 18882};
+  CopyCounter::COPY_CNT = 0;
+  auto task = make_counter(10);
+  BOOST_CHECK(framework.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(task.get_result().value_, 10);
+  BOOST_CHECK_EQUAL(CopyCounter::COPY_CNT, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_await_void_task) {
+  CoroFrameWork framework{1, 18883};
+  auto task = await_void_child();
+  BOOST_CHECK(framework.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(task.get_result(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_cancel_sleep) {
+  CoroFrameWork framework{1, 18884};
+  {
+    CancellationSource source;
+    auto task = long_sleep();
+    task.bind_cancellation(source.token());
+    uint64_t start_ts = SteadyClockTime::now();
+    BOOST_CHECK(framework.commit(task));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(source.cancel());
+    BOOST_CHECK(!source.cancel());
+    task.wait();
+    BOOST_CHECK(SteadyClockTime::now() - start_ts < 1_s);
+    BOOST_CHECK(!task.get_result());
+    BOOST_CHECK(task.get_result().error() == Error{Error::CANCELED});
+  }
+  {
+    CancellationSource source;
+    source.cancel();
+    auto task = long_sleep();
+    task.bind_cancellation(source.token());
+    BOOST_CHECK(framework.commit(task));
+    task.wait();
+    BOOST_CHECK(task.get_result().error() == Error{Error::CANCELED});
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_cancel_rpc) {
+  CoroFrameWork client{1, 18885};
+  CoroFrameWork server{1, 18886};
+  CancellationSource source;
+  auto task = rpc_add(EndPoint{{127, 0, 0, 1}, 18886});
+  task.bind_cancellation(source.token());
+  uint64_t start_ts = SteadyClockTime::now();
+  BOOST_CHECK(client.commit(task));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  source.cancel();
+  task.wait();
+  BOOST_CHECK(SteadyClockTime::now() - start_ts < 1_s); // example_add sleeps 1s before reply
+  BOOST_CHECK(task.get_result().error() == Error{Error::CANCELED});
+}
+
+BOOST_AUTO_TEST_CASE(test_cancel_remote_handler) {
+  CoroFrameWork client{1, 18918};
+  CoroFrameWork server{1, 18919};
+  const int64_t canceled_cnt = EXAMPLE_WAIT_CANCELED_CNT.load();
+  CancellationSource source;
+  auto task = rpc_wait(EndPoint{{127, 0, 0, 1}, 18919}, 10'000);
+  task.bind_cancellation(source.token());
+  BOOST_CHECK(client.commit(task));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  source.cancel();
+  task.wait();
+  BOOST_CHECK(task.get_result().error() == Error{Error::CANCELED});
+  uint64_t start_ts = SteadyClockTime::now(); // CANCEL is sent after caller resumed, handler aborts its sleep soon
+  while (EXAMPLE_WAIT_CANCELED_CNT.load() == canceled_cnt && SteadyClockTime::now() - start_ts < 5_s) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_CHECK_EQUAL(EXAMPLE_WAIT_CANCELED_CNT.load(), canceled_cnt + 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_sync_generator) {
+  std::vector<int64_t> values;
+  for (int64_t value : fibonacci(10)) {
+    values.push_back(value);
+  }
+  BOOST_CHECK((values == std::vector<int64_t>{0, 1, 1, 2, 3, 5, 8, 13, 21, 34}));
+  auto empty = fibonacci(0);
+  BOOST_CHECK(empty.begin() == empty.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_async_generator) {
+  CoroFrameWork framework{1, 18887};
+  auto task = sum_slow_values(100);
+  BOOST_CHECK(framework.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(task.get_result(), 4950);
+}
+
+BOOST_AUTO_TEST_CASE(test_wait_all_and_any) {
+  CoroFrameWork framework{2, 18888};
+  std::vector<CoroTask<int64_t>> tasks;
+  for (int64_t idx = 0; idx < 1000; ++idx) {
+    tasks.push_back(sleep_then_return(idx % 20, idx));
+    BOOST_CHECK(framework.commit(tasks.back()));
+  }
+  wait_all(tasks);
+  int64_t sum = 0;
+  for (auto &task : tasks) {
+    sum += task.get_result();
+  }
+  BOOST_CHECK_EQUAL(sum, 999 * 1000 / 2);
+  wait_all(tasks); // finished frames count down immediately
+
+  std::vector<CoroTask<int64_t>> race;
+  race.push_back(sleep_then_return(2000, 0));
+  race.push_back(sleep_then_return(10, 1));
+  for (auto &task : race) {
+    BOOST_CHECK(framework.commit(task));
+  }
+  BOOST_CHECK_EQUAL(wait_any(race), 1);
+  BOOST_CHECK_EQUAL(wait_any(std::vector<CoroTask<int64_t>>{}), WAIT_ANY_NPOS);
+
+  TaskGroup group;
+  auto late = sleep_then_return(10, 2);
+  BOOST_CHECK(group.add(late));
+  BOOST_CHECK(group.add(race[1]));
+  BOOST_CHECK(!group.try_wait());
+  BOOST_CHECK(framework.commit(late));
+  group.wait();
+  BOOST_CHECK_EQUAL(late.get_result(), 2);
+  wait_all(race);
+}
+
+BOOST_AUTO_TEST_CASE(test_admission_control) {
+  CoroFrameWork framework{2, 18889};
+  framework.set_admission_config(AdmissionConfig{.max_running_root_cnt_ = 3});
+  auto spawner = spawn_all(&framework, 20);
+  BOOST_CHECK(framework.commit(spawner));
+  spawner.wait();
+  BOOST_CHECK_EQUAL(spawner.get_result(), 20);
+  BOOST_CHECK(ADMITTED_PEAK.load() <= 2); // spawner holds one slot itself
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::vector<CoroTask<int64_t>> tasks;
+  for (int64_t idx = 0; idx < 4; ++idx) {
+    tasks.push_back(sleep_then_return(50, idx));
+  }
+  BOOST_CHECK(framework.commit(tasks[0]));
+  BOOST_CHECK(framework.commit(tasks[1]));
+  BOOST_CHECK(framework.commit(tasks[2]));
+  BOOST_CHECK(framework.commit(tasks[3]).error() == Error{Error::BUSY}); // fail fast
+  tasks.pop_back();
+  wait_all(tasks);
+
+  framework.set_admission_config(AdmissionConfig{.max_frame_bytes_ = 1});
+  auto over_memory = sleep_then_return(0, 0);
+  BOOST_CHECK(framework.commit(over_memory).error() == Error{Error::BUSY});
+}
+
+BOOST_AUTO_TEST_CASE(test_shed_rpc_when_busy) {
+  CoroFrameWork client{1, 18890};
+  CoroFrameWork server{1, 18891};
+  server.set_admission_config(AdmissionConfig{.max_running_root_cnt_ = 1});
+  std::vector<CoroTask<Expected<int64_t>>> tasks;
+  tasks.push_back(rpc_add(EndPoint{{127, 0, 0, 1}, 18891}));
+  tasks.push_back(rpc_add(EndPoint{{127, 0, 0, 1}, 18891}));
+  uint64_t start_ts = SteadyClockTime::now();
+  for (auto &task : tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  std::size_t shed = wait_any(tasks);
+  BOOST_CHECK(SteadyClockTime::now() - start_ts < 500_ms); // rejected at once, example_add sleeps 1s
+  BOOST_CHECK(tasks[shed].get_result().error() == Error{Error::BUSY});
+  wait_all(tasks);
+  int64_t busy_cnt = 0;
+  for (auto &task : tasks) {
+    if (task.get_result()) {
+      BOOST_CHECK_EQUAL(task.get_result().value(), 3);
+    } else {
+      BOOST_CHECK(task.get_result().error() == Error{Error::BUSY});
+      busy_cnt++;
+    }
+  }
+  BOOST_CHECK_EQUAL(busy_cnt, 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_reuse_connection) {
+  CoroFrameWork client{1, 18902};
+  EndPoint peer{{127, 0, 0, 1}, 18903};
+  {
+    CoroFrameWork server{2, 18903};
+    for (int64_t i = 0; i < 3; i++) {
+      auto task = rpc_add(peer);
+      BOOST_CHECK(client.commit(task));
+      task.wait();
+      BOOST_CHECK_EQUAL(task.get_result().value_or(0), 3);
+    }
+    BOOST_CHECK_EQUAL(client.get_net_module().get_connect_count(), 1);
+    BOOST_CHECK_EQUAL(server.get_net_module().get_connect_count(), 0); // responses go back on accepted connection
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CoroFrameWork restarted_server{2, 18903};
+  auto task = rpc_add(peer);
+  BOOST_CHECK(client.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(task.get_result().value_or(0), 3);
+  BOOST_CHECK_EQUAL(client.get_net_module().get_connect_count(), 2); // reconnected after peer restarted
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline_rpc) {
+  CoroFrameWork client{2, 18904};
+  CoroFrameWork server{2, 18905};
+  std::vector<CoroTask<Expected<int64_t>>> tasks;
+  for (int64_t i = 0; i < 32; i++) {
+    tasks.push_back(rpc_add(EndPoint{{127, 0, 0, 1}, 18905}));
+  }
+  uint64_t start_ts = SteadyClockTime::now();
+  for (auto &task : tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  wait_all(tasks);
+  BOOST_CHECK(SteadyClockTime::now() - start_ts < 5_s); // in flight together, example_add sleeps 1s
+  for (auto &task : tasks) {
+    BOOST_CHECK_EQUAL(task.get_result().value_or(0), 3);
+  }
+  BOOST_CHECK_EQUAL(client.get_net_module().get_connect_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_multi_io_threads) {
+  CoroFrameWork server{2, 18907, TimeConfig{}, NetConfig{.io_thread_num_ = 4}};
+  BOOST_CHECK_EQUAL(server.get_net_module().io_thread_num(), 4);
+  std::vector<std::unique_ptr<CoroFrameWork>> clients; // each is a new peer, accepted by any shard
+  for (uint16_t port : {18906, 18921, 18922, 18923}) {
+    clients.push_back(std::make_unique<CoroFrameWork>(2, port, TimeConfig{}, NetConfig{.io_thread_num_ = 3}));
+  }
+  std::vector<CoroTask<Expected<std::string>>> tasks;
+  for (auto &client : clients) {
+    for (int64_t i = 0; i < 64; i++) { // handler replies at once, while first request may still be in flight
+      tasks.push_back(rpc_repeat(EndPoint{{127, 0, 0, 1}, 18907}, 'x', 3));
+      BOOST_CHECK(client->commit(tasks.back()));
+    }
+  }
+  wait_all(tasks);
+  for (auto &task : tasks) {
+    BOOST_CHECK_EQUAL(task.get_result().value_or(""), "xxx");
+  }
+  for (auto &client : clients) {
+    BOOST_CHECK_EQUAL(client->get_net_module().get_connect_count(), 1);
+  }
+  BOOST_CHECK_EQUAL(server.get_net_module().get_connect_count(), 0); // replied from any shard on accepted connection
+}
+
+BOOST_AUTO_TEST_CASE(test_gathered_large_and_small_frames) {
+  CoroFrameWork client{2, 18912};
+  CoroFrameWork server{2, 18913};
+  // small payloads are copied into write buffer, larger ones are written in place between them
+  std::vector<int64_t> counts{1, 100_KiB, 16, 2_KiB, 0, 64_KiB, 1_KiB, 300};
+  std::vector<CoroTask<Expected<std::string>>> tasks;
+  for (int64_t i = 0; i < 4; i++) {
+    for (int64_t count : counts) {
+      tasks.push_back(rpc_repeat(EndPoint{{127, 0, 0, 1}, 18913}, static_cast<char>('a' + i), count));
+    }
+  }
+  for (auto &task : tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  wait_all(tasks);
+  for (std::size_t idx = 0; idx < tasks.size(); idx++) {
+    BOOST_REQUIRE(tasks[idx].get_result().has_value());
+    BOOST_CHECK(tasks[idx].get_result().value() == std::string(counts[idx % counts.size()], 'a' + idx / counts.size()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_chunked_large_messages) {
+  CoroFrameWork client{2, 18914};
+  CoroFrameWork server{2, 18915};
+  EndPoint peer{{127, 0, 0, 1}, 18915};
+  // more large messages than FrameWriter::MAX_STREAMS in both directions, small ones interleave with their chunks
+  std::vector<CoroTask<Expected<std::string>>> repeat_tasks;
+  std::vector<CoroTask<Expected<int64_t>>> count_tasks;
+  for (int64_t i = 0; i < 6; i++) {
+    repeat_tasks.push_back(rpc_repeat(peer, static_cast<char>('a' + i), (i + 1) * 1_MiB + i));
+    repeat_tasks.push_back(rpc_repeat(peer, static_cast<char>('a' + i), 10));
+    std::string data((i + 1) * 1_MiB + 7, 'x');
+    data[i] = 'y';
+    count_tasks.push_back(rpc_count(peer, std::move(data), 'x'));
+  }
+  for (auto &task : repeat_tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  for (auto &task : count_tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  wait_all(repeat_tasks);
+  wait_all(count_tasks);
+  for (int64_t i = 0; i < 6; i++) {
+    BOOST_REQUIRE(repeat_tasks[2 * i].get_result().has_value() && repeat_tasks[2 * i + 1].get_result().has_value());
+    BOOST_CHECK(repeat_tasks[2 * i].get_result().value() == std::string((i + 1) * 1_MiB + i, 'a' + i));
+    BOOST_CHECK(repeat_tasks[2 * i + 1].get_result().value() == std::string(10, 'a' + i));
+    BOOST_CHECK_EQUAL(count_tasks[i].get_result().value_or(0), static_cast<int64_t>((i + 1) * 1_MiB + 6));
+  }
+  BOOST_CHECK_EQUAL(client.get_net_module().get_connect_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_run_to_completion) {
+  NetConfig net_config{.run_to_completion_ = true}; // io_uring backend only, asio keeps io threads
+  CoroFrameWork client{2, 18916, TimeConfig{}, net_config};
+  CoroFrameWork server{2, 18917, TimeConfig{}, net_config};
+  BOOST_CHECK_EQUAL(server.get_net_module().worker_polled(), UsedNetModule::WORKER_POLL_SUPPORTED);
+  EndPoint peer{{127, 0, 0, 1}, 18917};
+  std::vector<CoroTask<Expected<int64_t>>> add_tasks;
+  std::vector<CoroTask<Expected<std::string>>> repeat_tasks;
+  for (int64_t i = 0; i < 16; i++) {
+    add_tasks.push_back(rpc_add(peer)); // handler sleeps on server worker's timers
+    repeat_tasks.push_back(rpc_repeat(peer, static_cast<char>('a' + i), i * 20'000));
+  }
+  uint64_t start_ts = SteadyClockTime::now();
+  for (int64_t i = 0; i < 16; i++) {
+    BOOST_CHECK(client.commit(add_tasks[i]));
+    BOOST_CHECK(client.commit(repeat_tasks[i]));
+  }
+  wait_all(add_tasks);
+  wait_all(repeat_tasks);
+  BOOST_CHECK(SteadyClockTime::now() - start_ts < 5_s);
+  for (int64_t i = 0; i < 16; i++) {
+    BOOST_CHECK_EQUAL(add_tasks[i].get_result().value_or(0), 3);
+    BOOST_CHECK(repeat_tasks[i].get_result().value_or("") == std::string(i * 20'000, static_cast<char>('a' + i)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_pending_rpc_table) {
+  TimeService time_service{1_ms};
+  time_service.start();
+  PendingRpcTable table{2, time_service};
+  LinkedCoroutine frame;
+  uint64_t first = table.claim(MaintainInfo{&frame, nullptr});
+  uint64_t second = table.claim(MaintainInfo{&frame, nullptr});
+  BOOST_CHECK(first != PendingRpcTable::INVALID_RPC_ID && second != PendingRpcTable::INVALID_RPC_ID);
+  BOOST_CHECK_EQUAL(table.claim(MaintainInfo{}), PendingRpcTable::INVALID_RPC_ID); // full
+  table.publish(first, 10_s);
+  table.abort(second);
+  MaintainInfo *info = table.acquire(first);
+  BOOST_REQUIRE(info != nullptr);
+  BOOST_CHECK_EQUAL(info->coroutine_, &frame);
+  table.release(first, false); // still waiting for other responses
+  BOOST_CHECK(table.acquire(first) != nullptr);
+  table.release(first, true);
+  BOOST_CHECK(table.acquire(first) == nullptr); // late response
+  uint64_t reused = table.claim(MaintainInfo{&frame, nullptr});
+  table.publish(reused, 10_s);
+  BOOST_CHECK(reused != first && reused != second);
+  BOOST_CHECK(table.acquire(first) == nullptr && table.acquire(second) == nullptr); // same slot, older generation
+  BOOST_CHECK(table.acquire(reused) != nullptr);
+  table.release(reused, true);
+  time_service.stop();
+  time_service.wait();
+}
+
+BOOST_AUTO_TEST_CASE(test_pooled_net_buffer) {
+  BOOST_CHECK_EQUAL(BufferPool::size_class(1), 0u);
+  BOOST_CHECK_EQUAL(BufferPool::size_class(65), 1u);
+  BOOST_CHECK_EQUAL(BufferPool::size_class(1_MiB), BufferPool::SIZE_CLASS_NUM - 1);
+  BOOST_CHECK_EQUAL(BufferPool::size_class(1_MiB + 1), BufferBlock::UNPOOLED);
+  auto churn = [] {
+    for (int64_t i = 0; i < 1000; i++) {
+      NetBuffer small{100};
+      NetBuffer large{64_KiB};
+    }
+  };
+  churn();
+  const uint64_t allocated = BufferPool::instance().allocated_blocks();
+  churn();
+  BOOST_CHECK_EQUAL(BufferPool::instance().allocated_blocks(), allocated); // recycled by thread cache
+  NetBuffer buffer{3_KiB};
+  std::byte *data = buffer.buffer_;
+  NetBuffer head = buffer.slice(0, 16);
+  NetBuffer tail = buffer.slice(1_KiB, 2_KiB);
+  BOOST_CHECK(!buffer.unique());
+  buffer.reset();
+  head.reset();
+  BOOST_CHECK(tail.unique());
+  BOOST_CHECK(tail.buffer_ == data + 1_KiB && tail.buffer_len_ == 2_KiB);
+  tail.reset();
+  NetBuffer reused{4_KiB}; // same size class
+  BOOST_CHECK(reused.buffer_ == data);
+}
+
+// write messages of given sizes through FrameWriter and parse them back, return lengths of whole messages read
+std::vector<uint64_t> pass_frames(FrameReader &reader, const std::vector<uint64_t> &message_lens) {
+  FrameWriter writer;
+  for (uint64_t idx = 0; idx < message_lens.size(); idx++) {
+    PackageHeader header{0, 1, idx, 0, message_lens[idx]};
+    header.set_message_type(PackageHeader::MessageType::REQUEST);
+    NetBuffer payload{message_lens[idx]};
+    memset(payload.buffer_, static_cast<int>('a' + idx), message_lens[idx]);
+    writer.push(OutgoingFrame{header, std::move(payload)});
+  }
+  std::vector<uint64_t> received;
+  std::vector<NetBufferView> buffers;
+  while (!writer.empty()) {
+    writer.prepare(buffers);
+    for (auto &buffer : buffers) {
+      reader.append(buffer.buffer_, buffer.buffer_len_, [&received](const PackageHeader &header, NetBuffer &&payload) {
+        const std::byte fill = static_cast<std::byte>('a' + header.rpc_id_);
+        BOOST_CHECK_EQUAL(header.payload_len_, payload.buffer_len_);
+        BOOST_CHECK(std::all_of(payload.buffer_, payload.buffer_ + payload.buffer_len_, [fill](std::byte b) { return b == fill; }));
+        received.push_back(payload.buffer_len_);
+      });
+    }
+    writer.commit();
+  }
+  return received;
+}
+
+BOOST_AUTO_TEST_CASE(test_chunk_reassembly_limits) {
+  FrameReader reader{1_MiB, 2_MiB};
+  auto received = pass_frames(reader, {600_KiB, 100, 1_MiB});
+  std::sort(received.begin(), received.end());
+  BOOST_CHECK(received == (std::vector<uint64_t>{100, 600_KiB, 1_MiB}));
+  const uint64_t allocated = BufferPool::instance().allocated_blocks();
+  pass_frames(reader, {1_MiB, 1_MiB}); // chunks are held in recycled pooled blocks
+  BOOST_CHECK_LE(BufferPool::instance().allocated_blocks(), allocated + 2);
+  FrameReader small_limit{512_KiB, 2_MiB};
+  BOOST_CHECK_THROW(pass_frames(small_limit, {600_KiB}), std::runtime_error); // refused on first chunk
+  FrameReader small_budget{1_MiB, 1_MiB};
+  BOOST_CHECK_THROW(pass_frames(small_budget, {600_KiB, 600_KiB}), std::runtime_error); // streamed at the same time
+  small_budget.clear();
+  BOOST_CHECK(pass_frames(small_budget, {1_MiB}) == std::vector<uint64_t>{1_MiB}); // budget returned by clear
+}
+
+BOOST_AUTO_TEST_CASE(test_too_many_pending_rpc) {
+  CoroFrameWork client{1, 18908, TimeConfig{}, NetConfig{.max_pending_rpc_ = 1}};
+  CoroFrameWork server{1, 18909};
+  std::vector<CoroTask<Expected<int64_t>>> tasks;
+  tasks.push_back(rpc_add(EndPoint{{127, 0, 0, 1}, 18909}));
+  tasks.push_back(rpc_add(EndPoint{{127, 0, 0, 1}, 18909}));
+  for (auto &task : tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  wait_all(tasks);
+  int64_t busy_cnt = 0;
+  for (auto &task : tasks) {
+    if (task.get_result()) {
+      BOOST_CHECK_EQUAL(task.get_result().value(), 3);
+    } else {
+      BOOST_CHECK(task.get_result().error() == Error{Error::BUSY});
+      busy_cnt++;
+    }
+  }
+  BOOST_CHECK_EQUAL(busy_cnt, 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_rpc_timeout) {
+  CoroFrameWork client{1, 18910};
+  CoroFrameWork server{1, 18911};
+  std::vector<CoroTask<Expected<int64_t>>> tasks;
+  tasks.push_back(rpc_add_timeout(EndPoint{{127, 0, 0, 1}, 18911}, 50_ms)); // handler sleeps 1s
+  tasks.push_back(rpc_add_timeout(EndPoint{{127, 0, 0, 1}, 18911}, 0)); // expires before published
+  tasks.push_back(rpc_add_timeout(EndPoint{{127, 0, 0, 1}, 18911}, 10_s));
+  uint64_t start_ts = FastClockTime::now();
+  for (auto &task : tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  wait_all(tasks);
+  BOOST_CHECK(tasks[0].get_result().error() == Error{Error::RPC_TIMEOUT});
+  BOOST_CHECK(tasks[1].get_result().error() == Error{Error::RPC_TIMEOUT});
+  BOOST_CHECK_EQUAL(tasks[2].get_result().value_or(0), 3); // timer disarmed by response
+  BOOST_CHECK_LT(FastClockTime::now() - start_ts, 5_s);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <set>
+#include <memory>
+#include <vector>
+#include "coroutine_framework/framework.hpp"
+#include "coroutine_framework/time_module/timing_wheel.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace ToE;
+using namespace std;
+
+struct WheelFixture {
+  WheelFixture() : wheel_{}, frames_{}, nodes_{} { wheel_.reset(START_TICK); }
+  ~WheelFixture() {
+    ExpiredTimers expired;
+    wheel_.drain(expired);
+  }
+  TimerNode *arm(const uint64_t expire_tick) {
+    frames_.push_back(std::make_unique<LinkedCoroutine>());
+    nodes_.push_back(std::make_unique<TimerNode>());
+    TimerNode *node = nodes_.back().get();
+    node->frame_ = frames_.back().get();
+    node->expire_tick_ = expire_tick;
+    return node;
+  }
+  std::vector<LinkedCoroutine *> advance(const uint64_t now_tick) {
+    std::vector<LinkedCoroutine *> ret;
+    ExpiredTimers expired;
+    wheel_.advance(now_tick, expired);
+    while (!expired.empty()) {
+      ret.push_back(expired.pop()->frame_);
+    }
+    return ret;
+  }
+  static constexpr uint64_t START_TICK = 1'000'003;
+  TimingWheel wheel_;
+  std::vector<std::unique_ptr<LinkedCoroutine>> frames_;
+  std::vector<std::unique_ptr<TimerNode>> nodes_;
+};
+
+struct CountingCallBack : public TimerCallBack {
+  virtual void on_timer(const bool cancelled) noexcept override {
+    (cancelled ? cancelled_cnt_ : expired_cnt_).fetch_add(1, std::memory_order_release);
+  }
+  std::atomic<int64_t> expired_cnt_{0};
+  std::atomic<int64_t> cancelled_cnt_{0};
+};
+
+template <typename PRED>
+bool wait_until(PRED &&pred) {
+  uint64_t deadline = FastClockTime::now() + 1_s;
+  while (!pred() && FastClockTime::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return pred();
+}
+
+CoroTask<Expected<void>> bound_sleep(TimerHandle &handle) {
+  auto ret = co_await co_sleep(10_s).bind(handle);
+  co_return ret;
+}
+
+CoroTask<void> paced_sleeps(int64_t count, uint64_t interval) {
+  for (int64_t idx = 0; idx < count; ++idx) {
+    co_await co_sleep(interval);
+  }
+  co_return;
+}
+
+CoroTask<uint64_t> sleep_with_slack(uint64_t sleep_ts, uint64_t slack) {
+  uint64_t start_ts = FastClockTime::now();
+  co_await co_sleep(sleep_ts, slack);
+  co_return FastClockTime::now() - start_ts;
+}
+
+CoroTask<std::vector<uint64_t>> interval_ticks(MissedTickPolicy policy, std::vector<uint64_t> body_ts, uint64_t &grid_span) {
+  co_interval interval{20_ms, policy};
+  uint64_t start_deadline = interval.next_deadline();
+  std::vector<uint64_t> consumed;
+  for (uint64_t ts : body_ts) {
+    auto ticks = co_await interval.tick();
+    bool on_time = ticks.has_value() && FastClockTime::now() >= interval.next_deadline() - interval.period();
+    consumed.push_back(on_time ? ticks.value() : 0);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(ts)); // loop body blocks worker
+  }
+  grid_span = interval.next_deadline() - start_deadline;
+  co_return consumed;
+}
+
+BOOST_AUTO_TEST_SUITE(test_timer)
+
+BOOST_FIXTURE_TEST_CASE(test_wheel_expire_on_exact_tick, WheelFixture) {
+  std::map<LinkedCoroutine *, uint64_t> expect;
+  for (uint64_t delta : {1ULL, 2ULL, 61ULL, 62ULL, 63ULL, 64ULL, 65ULL, 4095ULL, 4096ULL, 4097ULL,
+                         262143ULL, 262144ULL, 262145ULL, 300000ULL, 1'000'000ULL}) {
+    TimerNode *node = arm(START_TICK + delta);
+    BOOST_CHECK(wheel_.insert(node));
+    expect[node->frame_] = node->expire_tick_;
+  }
+  BOOST_CHECK(!wheel_.insert(arm(START_TICK))); // due already
+  BOOST_CHECK_EQUAL(wheel_.size(), expect.size());
+  uint64_t now = START_TICK;
+  uint64_t step = 1;
+  while (!expect.empty()) {
+    uint64_t next = now + step;
+    step = step * 3 % 997 + 1; // irregular advance steps
+    for (LinkedCoroutine *frame : advance(next)) {
+      BOOST_REQUIRE(expect.count(frame));
+      BOOST_CHECK(expect[frame] > now && expect[frame] <= next);
+      expect.erase(frame);
+    }
+    for (auto &[frame, expire_tick] : expect) {
+      BOOST_CHECK(expire_tick > next);
+    }
+    now = next;
+  }
+  BOOST_CHECK_EQUAL(wheel_.size(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_wheel_remove, WheelFixture) {
+  TimerNode *short_node = arm(START_TICK + 10);
+  TimerNode *long_node = arm(START_TICK + 100'000);
+  BOOST_CHECK(wheel_.insert(short_node));
+  BOOST_CHECK(wheel_.insert(long_node));
+  BOOST_CHECK(wheel_.remove(long_node));
+  BOOST_CHECK(!wheel_.remove(long_node));
+  BOOST_CHECK_EQUAL(advance(START_TICK + 200'000).size(), 1);
+  BOOST_CHECK(!wheel_.remove(short_node)); // expired already
+  BOOST_CHECK_EQUAL(wheel_.size(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_wheel_next_expire_tick, WheelFixture) {
+  BOOST_CHECK_EQUAL(wheel_.next_expire_tick(), UINT64_MAX);
+  std::map<uint64_t, LinkedCoroutine *> pending;
+  for (uint64_t delta : {5ULL, 100ULL, 5000ULL, 300000ULL}) {
+    TimerNode *node = arm(START_TICK + delta);
+    BOOST_CHECK(wheel_.insert(node));
+    pending[node->expire_tick_] = node->frame_;
+  }
+  uint64_t now = START_TICK;
+  uint64_t jumps = 0;
+  while (!pending.empty()) { // jump from event to event like an idle worker
+    uint64_t next = wheel_.next_expire_tick();
+    BOOST_REQUIRE(next > now && next <= pending.begin()->first);
+    for (LinkedCoroutine *frame : advance(next)) {
+      BOOST_CHECK(pending.begin()->first == next && pending.begin()->second == frame);
+      pending.erase(pending.begin());
+    }
+    now = next;
+    jumps++;
+  }
+  BOOST_CHECK(jumps <= 4 * TimingWheel::LEVEL_NUM); // expiry plus cascades, no per tick wake up
+  BOOST_CHECK_EQUAL(wheel_.next_expire_tick(), UINT64_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(test_wheel_coalesce_tick) {
+  constexpr uint64_t START_TICK = 1'000'003;
+  constexpr uint64_t SLACK_TICKS = 64;
+  std::set<uint64_t> ticks;
+  for (uint64_t expire_tick = START_TICK; expire_tick < START_TICK + 1000; ++expire_tick) {
+    BOOST_CHECK_EQUAL(TimingWheel::coalesce_tick(expire_tick, 0), expire_tick);
+    uint64_t coalesced = TimingWheel::coalesce_tick(expire_tick, SLACK_TICKS);
+    BOOST_CHECK(coalesced >= expire_tick && coalesced <= expire_tick + SLACK_TICKS);
+    ticks.insert(coalesced);
+  }
+  BOOST_CHECK(ticks.size() <= 1000 / SLACK_TICKS + 2); // overlapping windows share ticks
+}
+
+BOOST_AUTO_TEST_CASE(test_clock_sources) {
+  uint64_t fast = FastClockTime::now();
+  uint64_t steady = SteadyClockTime::now();
+  BOOST_CHECK(fast < steady + 1_ms && steady < fast + 1_ms); // same domain
+  uint64_t prev = fast;
+  for (int64_t idx = 0; idx < 1000; ++idx) {
+    uint64_t current = FastClockTime::now();
+    BOOST_CHECK(current >= prev);
+    prev = current;
+  }
+  uint64_t coarse = CoarseClockTime::update(FastClockTime::now());
+  BOOST_CHECK_EQUAL(CoarseClockTime::update(coarse - 1_ms), coarse); // never go back
+  BOOST_CHECK(CoarseClockTime::now() >= coarse);
+  uint64_t local_now = 0;
+  std::thread{[coarse, &local_now] { // worker's copy is private to it's thread
+    CoarseClockTime::update_local(coarse + 1_s);
+    local_now = CoarseClockTime::now();
+  }}.join();
+  BOOST_CHECK_EQUAL(local_now, coarse + 1_s);
+  BOOST_CHECK(CoarseClockTime::now() < coarse + 1_s);
+}
+
+BOOST_AUTO_TEST_CASE(test_timer_handle) {
+  CoroFrameWork framework{1, 18892};
+  CountingCallBack callback;
+  TimerHandle timer{framework.get_time_module(), &callback};
+  BOOST_CHECK(timer.arm_after(10_s));
+  BOOST_CHECK(!timer.arm_after(10_s)); // armed already
+  BOOST_CHECK(timer.reschedule(FastClockTime::now() + 5_ms));
+  BOOST_CHECK(wait_until([&callback] { return callback.expired_cnt_.load() == 1; }));
+  BOOST_CHECK(!timer.cancel()); // expired already
+  BOOST_CHECK(!timer.reschedule(FastClockTime::now() + 5_ms));
+  BOOST_CHECK(timer.arm_after(10_s)); // reusable
+  BOOST_CHECK(timer.cancel());
+  BOOST_CHECK(!timer.cancel());
+  BOOST_CHECK_EQUAL(callback.cancelled_cnt_.load(), 1);
+  BOOST_CHECK(timer.arm(FastClockTime::now() - 1_ms)); // due already, fired in place
+  BOOST_CHECK_EQUAL(callback.expired_cnt_.load(), 2);
+  BOOST_CHECK(!timer.armed());
+}
+
+BOOST_AUTO_TEST_CASE(test_race_sleep_with_handle) {
+  CoroFrameWork framework{1, 18893};
+  TimerHandle handle{framework.get_time_module()};
+  {
+    uint64_t start_ts = FastClockTime::now();
+    auto task = bound_sleep(handle);
+    BOOST_CHECK(framework.commit(task));
+    BOOST_CHECK(wait_until([&handle] { return handle.armed(); }));
+    BOOST_CHECK(handle.cancel()); // other event wins
+    task.wait();
+    BOOST_CHECK(FastClockTime::now() - start_ts < 1_s);
+    BOOST_CHECK(task.get_result().error() == Error{Error::CANCELED});
+  }
+  {
+    uint64_t start_ts = FastClockTime::now();
+    auto task = bound_sleep(handle);
+    BOOST_CHECK(framework.commit(task));
+    BOOST_CHECK(wait_until([&handle] { return handle.armed(); }));
+    BOOST_CHECK(handle.reschedule(FastClockTime::now() + 20_ms)); // timer wins earlier
+    task.wait();
+    BOOST_CHECK(FastClockTime::now() - start_ts < 1_s);
+    BOOST_CHECK(task.get_result().has_value());
+  }
+  {
+    CountingCallBack callback;
+    TimerHandle owned{framework.get_time_module(), &callback};
+    {
+      auto task = bound_sleep(owned);
+      BOOST_CHECK(framework.commit(task));
+      BOOST_CHECK(wait_until([&owned] { return owned.armed(); }));
+      BOOST_CHECK(owned.cancel());
+      task.wait();
+    } // sleep frame is gone, handle must not point to it anymore
+    BOOST_CHECK(owned.arm_after(1_ms));
+    BOOST_CHECK(wait_until([&callback] { return callback.expired_cnt_.load() == 1; }));
+    BOOST_CHECK_EQUAL(callback.cancelled_cnt_.load(), 0); // bound sleep was reported to co_sleep only
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_sleep_with_slack) {
+  CoroFrameWork framework{1, 18895};
+  std::vector<CoroTask<uint64_t>> tasks;
+  for (uint64_t idx = 0; idx < 50; ++idx) {
+    tasks.push_back(sleep_with_slack(20_ms + idx * 100_us, 10_ms));
+    BOOST_CHECK(framework.commit(tasks.back()));
+  }
+  wait_all(tasks);
+  for (uint64_t idx = 0; idx < 50; ++idx) {
+    uint64_t elapsed = tasks[idx].get_result();
+    BOOST_CHECK(elapsed >= 20_ms + idx * 100_us);
+    BOOST_CHECK(elapsed < 20_ms + idx * 100_us + 10_ms + 100_ms); // slack plus scheduling noise
+  }
+  TimerLatenessStats &stats = framework.get_time_module().lateness_stats();
+  BOOST_CHECK_EQUAL(stats.fired_cnt_.load(), 50);
+  BOOST_CHECK(stats.wakeup_cnt_.load() <= 5); // 5ms of deadlines inside 10ms windows, not one wake up each
+}
+
+BOOST_AUTO_TEST_CASE(test_timer_handle_with_slack) {
+  CoroFrameWork framework{1, 18920};
+  TimerLatenessStats &stats = framework.get_time_module().lateness_stats();
+  CountingCallBack callback;
+  std::vector<std::unique_ptr<TimerHandle>> timers;
+  uint64_t start_ts = FastClockTime::now();
+  for (uint64_t idx = 0; idx < 50; ++idx) { // fired by time service thread, in one expiry pass each
+    timers.push_back(std::make_unique<TimerHandle>(framework.get_time_module(), &callback));
+    BOOST_CHECK(timers.back()->arm(start_ts + 20_ms + idx * 100_us, 10_ms));
+  }
+  BOOST_CHECK(wait_until([&callback] { return callback.expired_cnt_.load() == 50; }));
+  BOOST_CHECK(FastClockTime::now() - start_ts >= 20_ms + 49 * 100_us);
+  BOOST_CHECK_EQUAL(stats.fired_cnt_.load(), 50);
+  BOOST_CHECK(stats.wakeup_cnt_.load() <= 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_interval_missed_tick_policy) {
+  CoroFrameWork framework{1, 18896};
+  for (MissedTickPolicy policy : {MissedTickPolicy::SKIP, MissedTickPolicy::BURST}) {
+    uint64_t grid_span = 0;
+    uint64_t start_ts = FastClockTime::now();
+    auto task = interval_ticks(policy, {5_ms, 70_ms, 5_ms, 5_ms, 5_ms, 5_ms}, grid_span);
+    BOOST_CHECK(framework.commit(task));
+    task.wait();
+    std::vector<uint64_t> &consumed = task.get_result();
+    BOOST_CHECK(std::find(consumed.begin(), consumed.end(), 0) == consumed.end()); // never woken before deadline
+    uint64_t total = std::accumulate(consumed.begin(), consumed.end(), 0ULL);
+    BOOST_CHECK_EQUAL(grid_span, total * 20_ms); // deadlines stay on the grid, no drift
+    BOOST_CHECK(FastClockTime::now() - start_ts >= total * 20_ms);
+    if (policy == MissedTickPolicy::SKIP) {
+      BOOST_CHECK(consumed[2] >= 2); // deadlines missed by the 70ms body are dropped
+    } else {
+      BOOST_CHECK(std::all_of(consumed.begin(), consumed.end(), [](uint64_t ticks) { return ticks == 1; }));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_high_resolution_timer) {
+  CoroFrameWork framework{1, 18894, TimeConfig{50_us, true, 20_us}};
+  TimerLatenessStats &stats = framework.get_time_module().lateness_stats();
+  uint64_t start_ts = FastClockTime::now();
+  auto task = paced_sleeps(100, 200_us); // on worker wheel
+  BOOST_CHECK(framework.commit(task));
+  task.wait();
+  BOOST_CHECK(FastClockTime::now() - start_ts >= 100 * 200_us);
+  CountingCallBack callback;
+  TimerHandle timer{framework.get_time_module(), &callback};
+  for (int64_t idx = 1; idx <= 20; ++idx) { // on time service
+    BOOST_CHECK(timer.arm_after(300_us));
+    BOOST_CHECK(wait_until([&callback, idx] { return callback.expired_cnt_.load() == idx; }));
+  }
+  BOOST_TEST_MESSAGE("high resolution lateness mean " << stats.mean_lateness_ns() << "ns, max " << stats.max_lateness_ns_.load() << "ns");
+  BOOST_CHECK(stats.fired_cnt_.load() >= 120); // sleeps of other frames on this framework count as well
+  BOOST_CHECK(stats.mean_lateness_ns() < 5_ms); // loose for loaded ci machines, message above shows real value
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,161 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include "coroutine_framework/framework.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace ToE;
+using namespace std;
+
+// io_uring backend is instantiated in every build, these run on it no matter which one CoroFrameWork uses
+
+CoroTask<Expected<int64_t>> uring_add(EndPoint peer) {
+  auto ret = co_await co_rpc<example_add_point>().with_args(Point{1, 1}, Point{2, 2}).on(peer).timeout(10_s);
+  co_return ret.has_value() ? Expected<int64_t>{ret->x_ + ret->y_} : UnExpected{ret.error()};
+}
+
+CoroTask<Expected<std::string>> uring_repeat(EndPoint peer, char c, int64_t count) {
+  auto ret = co_await co_rpc<example_repeat>().with_args(c, count).on(peer).timeout(10_s);
+  co_return ret;
+}
+
+CoroTask<Expected<int64_t>> uring_wait(EndPoint peer, uint64_t wait_ms, uint64_t timeout) {
+  auto ret = co_await co_rpc<example_wait>().with_args(wait_ms).on(peer).timeout(timeout);
+  co_return ret;
+}
+
+bool kernel_at_least(const int major, const int minor) {
+  utsname name;
+  int kernel_major = 0;
+  int kernel_minor = 0;
+  return ::uname(&name) == 0 && std::sscanf(name.release, "%d.%d", &kernel_major, &kernel_minor) == 2 &&
+         (kernel_major > major || (kernel_major == major && kernel_minor >= minor));
+}
+
+BOOST_AUTO_TEST_SUITE(test_uring)
+
+BOOST_AUTO_TEST_CASE(test_provided_buffer_ring) {
+  IoUring ring{64, false};
+  ProvidedBufferRing buffers{ring, 1, 16, 4_KiB};
+  if (kernel_at_least(5, 19)) { // buffer ring is registered since 5.19, older ones provide buffers by sqe
+    BOOST_CHECK(!buffers.legacy());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_rpc_round_trip) {
+  UringFrameWork client{1, 18924};
+  UringFrameWork server{1, 18925};
+  EndPoint peer{{127, 0, 0, 1}, 18925};
+  std::vector<CoroTask<Expected<int64_t>>> add_tasks;
+  std::vector<CoroTask<Expected<std::string>>> repeat_tasks;
+  for (int64_t i = 0; i < 16; i++) {
+    add_tasks.push_back(uring_add(peer));
+    repeat_tasks.push_back(uring_repeat(peer, static_cast<char>('a' + i), i * 100));
+    BOOST_CHECK(client.commit(add_tasks.back()));
+    BOOST_CHECK(client.commit(repeat_tasks.back()));
+  }
+  wait_all(add_tasks);
+  wait_all(repeat_tasks);
+  for (int64_t i = 0; i < 16; i++) {
+    BOOST_CHECK_EQUAL(add_tasks[i].get_result().value_or(0), 6);
+    BOOST_CHECK(repeat_tasks[i].get_result().value_or("-") == std::string(i * 100, static_cast<char>('a' + i)));
+  }
+  BOOST_CHECK_EQUAL(client.get_net_module().get_connect_count(), 1);
+  if (kernel_at_least(5, 19)) { // received into registered ring, not legacy provided buffers
+    BOOST_CHECK(!server.get_net_module().shard(0).recv_buffers_.legacy());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_chunked_messages) {
+  UringFrameWork client{2, 18926};
+  UringFrameWork server{2, 18927, TimeConfig{}, NetConfig{.uring_recv_buffer_num_ = 8}}; // recv runs out of buffers
+  EndPoint peer{{127, 0, 0, 1}, 18927};
+  std::vector<CoroTask<Expected<std::string>>> tasks;
+  for (int64_t i = 0; i < 6; i++) { // more than FrameWriter::MAX_STREAMS, small ones interleave with chunks
+    tasks.push_back(uring_repeat(peer, static_cast<char>('a' + i), (i + 1) * 1_MiB + i));
+    tasks.push_back(uring_repeat(peer, static_cast<char>('a' + i), 10));
+  }
+  for (auto &task : tasks) {
+    BOOST_CHECK(client.commit(task));
+  }
+  wait_all(tasks);
+  for (int64_t i = 0; i < 6; i++) {
+    BOOST_REQUIRE(tasks[2 * i].get_result().has_value() && tasks[2 * i + 1].get_result().has_value());
+    BOOST_CHECK(tasks[2 * i].get_result().value() == std::string((i + 1) * 1_MiB + i, 'a' + i));
+    BOOST_CHECK(tasks[2 * i + 1].get_result().value() == std::string(10, 'a' + i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_reconnect) {
+  UringFrameWork client{1, 18928};
+  EndPoint peer{{127, 0, 0, 1}, 18929};
+  {
+    UringFrameWork server{1, 18929};
+    auto task = uring_add(peer);
+    BOOST_CHECK(client.commit(task));
+    task.wait();
+    BOOST_CHECK_EQUAL(task.get_result().value_or(0), 6);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  UringFrameWork restarted_server{1, 18929};
+  auto task = uring_add(peer);
+  BOOST_CHECK(client.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(task.get_result().value_or(0), 6);
+  BOOST_CHECK_EQUAL(client.get_net_module().get_connect_count(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_shutdown) {
+  auto client = std::make_unique<UringFrameWork>(1, 18930);
+  auto server = std::make_unique<UringFrameWork>(1, 18931);
+  EndPoint peer{{127, 0, 0, 1}, 18931};
+  auto task = uring_wait(peer, 10'000, 3_s);
+  BOOST_CHECK(client->commit(task));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint64_t start_ts = SteadyClockTime::now();
+  server.reset(); // sleeping handler is woken, every op in flight is canceled and waited
+  BOOST_CHECK(SteadyClockTime::now() - start_ts < 1_s);
+  task.wait();
+  BOOST_CHECK(!task.get_result().has_value()); // dropped with connection, caller times out
+  auto late_task = uring_wait(peer, 0, 10_s);
+  BOOST_CHECK(client->commit(late_task)); // connect is refused and backs off while client stops
+  start_ts = SteadyClockTime::now();
+  client.reset();
+  BOOST_CHECK(SteadyClockTime::now() - start_ts < 1_s);
+  late_task.wait();
+  BOOST_CHECK(!late_task.get_result().has_value());
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_accept_backoff) {
+  UringFrameWork client{1, 18932};
+  UringFrameWork server{1, 18933};
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  BOOST_REQUIRE(fd >= 0);
+  rlimit limit;
+  BOOST_REQUIRE(::getrlimit(RLIMIT_NOFILE, &limit) == 0);
+  const int lowest_free = ::dup(fd);
+  ::close(lowest_free);
+  rlimit exhausted = limit;
+  exhausted.rlim_cur = static_cast<rlim_t>(lowest_free); // no more fds for accept
+  BOOST_REQUIRE(::setrlimit(RLIMIT_NOFILE, &exhausted) == 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(18933);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  const int connected = ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)); // waits in backlog
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // accept fails with EMFILE meanwhile
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+  BOOST_CHECK_EQUAL(connected, 0);
+  ::close(fd);
+  auto task = uring_add(EndPoint{{127, 0, 0, 1}, 18933}); // accept is armed again after back off
+  BOOST_CHECK(client.commit(task));
+  task.wait();
+  BOOST_CHECK_EQUAL(task.get_result().value_or(0), 6);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -36,6 +36,15 @@ add_linkdirs(boost_prefix .. "/lib/")
 add_ldflags("-static")
 add_ldflags("-lpthread")
 
+-- net backend of CoroFrameWork, xmake f --io_uring=y switches asio to io_uring(linux 6.0+)
+option("io_uring")
+  set_default(false)
+  set_showmenu(true)
+  set_description("use io_uring net backend")
+  add_defines("TOE_NET_IO_URING")
+option_end()
+add_options("io_uring")
+
 add_files("demo/example_rpc.cpp")
 add_files("src/log/*.cpp")
 add_files("src/error_define/*.cpp")
@@ -86,6 +95,14 @@ target("demo_5_multi_rpc_call")
   set_kind("binary")
   add_files("demo/demo_5_multi_rpc_call.cpp")
 
+target("bench_timer")
+  set_kind("binary")
+  add_files("benchmark/bench_timer.cpp")
+
+target("bench_rpc")
+  set_kind("binary")
+  add_files("benchmark/bench_rpc.cpp")
+
 -- -- 创建测试项目
 target("unittests")
   add_links("boost_unit_test_framework")  -- 显式链接测试框架